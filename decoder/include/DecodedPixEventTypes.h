@@ -4,6 +4,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 enum class PixEventType
@@ -40,8 +41,43 @@ struct DecodedPixEventBlock
 };
 #pragma pack()
 
+// Interned strings are recorded once per capture, by PIX_INTERN, and events then
+// only refer to them by a shortcut. Decoding every block of a capture with the
+// same table, in the order the blocks were written, lets the shortcuts be
+// resolved. A table can only be used by one thread at a time.
+namespace PixEventDecoder
+{
+    struct DecodedInternedString
+    {
+        bool IsAnsi = false;
+        std::string AnsiString;
+        std::wstring UnicodeString;
+    };
+
+    using DecodedInternedStrings = std::unordered_map<uint64_t, DecodedInternedString>;
+}
+
 struct DecodedNameAndColor
 {
     std::string Name;
     UINT32 Color;
 };
+
+// The statistics that the runtime records periodically (see PIXGetRuntimeStatistics)
+struct DecodedRuntimeStatistics
+{
+    UINT32 ProcessId = 0;
+    UINT64 Timestamp = 0;
+    UINT64 Threads = 0;
+    UINT64 Events = 0;
+    UINT64 BlocksWritten = 0;
+    UINT64 BytesRecorded = 0;
+    UINT64 BytesWritten = 0;
+    UINT64 Writes = 0;
+    UINT64 BlockReplacements = 0;
+    UINT64 AllocationFailures = 0;
+    UINT64 QueuedBlocks = 0;
+    UINT64 MaxQueuedBlocks = 0;
+    UINT64 OverflowBlocks = 0;
+    UINT64 DroppedBlocks = 0;
+};
@@ -5,6 +5,7 @@
 
 #include <functional>
 #include <optional>
+#include <vector>
 
 #include "DecodedPixEventTypes.h"
 
@@ -12,7 +13,28 @@ namespace PixEventDecoder
 {
     using ConvertClockToNanoseconds = std::function<uint64_t(uint64_t)>;
 
-    DecodedPixEventBlock DecodeTimingBlock(bool ignoreEventContexts, bool gpuOnlyEvents, uint32_t bufferSize, uint8_t* buffer, ConvertClockToNanoseconds const& convertClockToNanoseconds);
+    // Decodes the block in a PIXRecordTimingBlock_v2 event. Pass the same
+    // internedStrings to every call for a capture, so that events can refer to
+    // strings interned in earlier blocks. Without one, only the strings
+    // interned in the buffer itself are resolved.
+    DecodedPixEventBlock DecodeTimingBlock(bool ignoreEventContexts, bool gpuOnlyEvents, uint32_t bufferSize, uint8_t* buffer, ConvertClockToNanoseconds const& convertClockToNanoseconds, DecodedInternedStrings* internedStrings = nullptr);
+
+    // Decodes every block in a buffer that holds one or more blocks back to
+    // back, as written to a PIXRecordTimingBlocks event or a capture file.
+    // These blocks may be compressed, unlike PIXRecordTimingBlock_v2 ones.
+    std::vector<DecodedPixEventBlock> DecodeTimingBlocks(bool ignoreEventContexts, bool gpuOnlyEvents, uint32_t bufferSize, uint8_t* buffer, ConvertClockToNanoseconds const& convertClockToNanoseconds, DecodedInternedStrings* internedStrings = nullptr);
+
+    // Decodes the statistics blocks in a buffer, such as a
+    // PIXRecordRuntimeStatistics event. DecodeTimingBlocks skips over them.
+    std::vector<DecodedRuntimeStatistics> DecodeRuntimeStatistics(uint32_t bufferSize, uint8_t const* buffer, ConvertClockToNanoseconds const& convertClockToNanoseconds);
+
+    // Recovers the writes committed to a capture file (see PEvtFile.h), oldest
+    // first, after the file's string table. Each one holds one or more blocks,
+    // for DecodeTimingBlocks, and they should all be decoded with the same
+    // DecodedInternedStrings. Writes that were in progress when the file was
+    // left behind are skipped, and an empty list is returned if the file isn't
+    // a capture file.
+    std::vector<std::vector<uint8_t>> ReadCaptureFile(uint64_t fileSize, uint8_t const* file);
 
     std::optional<DecodedNameAndColor> TryDecodePIXBeginEventOrPIXSetMarkerBlob(_In_reads_to_ptr_(limit) const UINT64* source, _In_ const UINT64* limit);
 }
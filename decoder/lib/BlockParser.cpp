@@ -144,14 +144,15 @@ namespace PixEventDecoder
         return true;
     }
 
-    BlockParser::BlockParser(const PEvtBlkHdr* blockHeader, UINT32 blockSize, ConvertClockToNanoseconds const& convertClockToNanoseconds) :
+    BlockParser::BlockParser(const PEvtBlkHdr* blockHeader, UINT32 blockSize, ConvertClockToNanoseconds const& convertClockToNanoseconds, DecodedInternedStrings& internedStrings) :
         m_blockStartTime(blockHeader->cpuHeader.beginTimestamp),
         m_blockEndTime(blockHeader->cpuHeader.endTimestamp),
         m_blockDataStart(reinterpret_cast<const UINT64*>(reinterpret_cast<const BYTE*>(blockHeader) + sizeof(PEvtBlkHdr))),
         m_blockDataEnd(reinterpret_cast<const UINT64*>(reinterpret_cast<const BYTE*>(blockHeader) + blockSize)),
         m_processId(blockHeader->cpuHeader.processId),
         m_threadId(blockHeader->cpuHeader.threadId),
-        m_convertClockToNanoseconds(convertClockToNanoseconds)
+        m_convertClockToNanoseconds(convertClockToNanoseconds),
+        m_internedStrings(internedStrings)
     {
         assert(blockHeader->BlockType == PIXEVT_CPU_BLOCK);
         assert(blockSize > 0);
@@ -185,6 +186,15 @@ namespace PixEventDecoder
             PixOp legacyOpcode = PixOp_Invalid;
             PIXDecodeEventInfo(eventInfo, &time, &opcode, &eventSize, &eventMetadata, &legacyOpcode);
 
+            if (opcode == PixOp_InternString && eventSize > 0)
+            {
+                //interned strings are not events, they are only recorded so that later events can refer to them
+                const UINT64* eventEnd = std::min(currentPosition + eventSize - 1, m_blockDataEnd);
+                ReadInternStringEvent(m_internedStrings, currentPosition, eventEnd);
+                currentPosition = eventEnd;
+                continue;
+            }
+
             if (!IsKnownOpcode(opcode))
             {
                 if (eventSize > 0)
@@ -252,7 +262,7 @@ namespace PixEventDecoder
                     legacyOpcode == PixOp_BeginEvent_OnContext_NoVarArgs ||
                     legacyOpcode == PixOp_SetMarker_OnContext_NoVarArgs)
                 {
-                    eventData = ReadEventWithNoFormatParameters(eventInfo, currentPosition, m_blockDataEnd, m_unicodeBuffer.data(), m_bufferLength);
+                    eventData = ReadEventWithNoFormatParameters(eventInfo, currentPosition, m_blockDataEnd, m_unicodeBuffer.data(), m_bufferLength, &m_internedStrings);
                     if (eventSize > 0 && eventSize < c_eventSizeMax)
                     {
                         currentPosition += eventSize - 1;
@@ -268,7 +278,7 @@ namespace PixEventDecoder
                 }
                 else
                 {
-                    eventData = ReadEventWithFormatParameters(eventInfo, currentPosition, m_blockDataEnd, m_unicodeBuffer.data(), m_ansiBuffer.data(), m_bufferLength);
+                    eventData = ReadEventWithFormatParameters(eventInfo, currentPosition, m_blockDataEnd, m_unicodeBuffer.data(), m_ansiBuffer.data(), m_bufferLength, nullptr, nullptr, &m_internedStrings);
 
                     if (eventSize > 0 && eventSize < c_eventSizeMax)
                     {
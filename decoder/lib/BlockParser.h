@@ -30,7 +30,7 @@ namespace PixEventDecoder
     class BlockParser
     {
     public:
-        BlockParser(const PEvtBlkHdr* blockHeader, UINT32 blockSize, ConvertClockToNanoseconds const& convertClockToNanoseconds);
+        BlockParser(const PEvtBlkHdr* blockHeader, UINT32 blockSize, ConvertClockToNanoseconds const& convertClockToNanoseconds, DecodedInternedStrings& internedStrings);
 
         void ProcessEvents(PixEventCallback callback);
 
@@ -43,6 +43,7 @@ namespace PixEventDecoder
         UINT32 const m_threadId;
 
         ConvertClockToNanoseconds m_convertClockToNanoseconds;
+        DecodedInternedStrings& m_internedStrings;
 
         static const UINT32 m_bufferLength = 16 * 1024;
         std::vector<wchar_t> m_unicodeBuffer;
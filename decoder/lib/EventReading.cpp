@@ -8,6 +8,9 @@
 // We show this string in the PIX UI if we encounter an invalid UTF8 string in a PIX marker
 static std::wstring_view InvalidUtf8String = L"<invalid UTF8 string>";
 
+// We show this string in the PIX UI if an event refers to an interned string that was never recorded
+static std::wstring_view UnknownInternedString = L"<unknown interned string>";
+
 namespace PixEventDecoder
 {
     //
@@ -110,6 +113,86 @@ namespace PixEventDecoder
     };
 
 
+    //
+    // Interned strings are recorded once per capture by PixOp_InternString
+    // events, other events then only refer to them by their shortcut. The
+    // caller owns the table, so that each capture resolves shortcuts against
+    // its own strings.
+    //
+    static uint64_t GetInternedStringKey(uint64_t shortcut)
+    {
+        return shortcut & (PIXEventsStringShortcutIdReadMask | PIXEventsStringIsANSIReadMask);
+    }
+
+    _Use_decl_annotations_
+    void ReadInternStringEvent(
+        DecodedInternedStrings& internedStrings,
+        const UINT64* source,
+        const UINT64* limit)
+    {
+        if (source >= limit)
+        {
+            return;
+        }
+
+        const uint64_t shortcut = *source++;
+
+        DecodedInternedString internedString;
+        internedString.IsAnsi = (shortcut & PIXEventsStringIsANSIReadMask) != 0;
+
+        // The string may have been truncated without a terminator, in which
+        // case everything up to the end of the event is used.
+        if (internedString.IsAnsi)
+        {
+            const char* begin = reinterpret_cast<const char*>(source);
+            const char* end = reinterpret_cast<const char*>(limit);
+            internedString.AnsiString.assign(begin, std::find(begin, end, '\0'));
+        }
+        else
+        {
+            const wchar_t* begin = reinterpret_cast<const wchar_t*>(source);
+            const wchar_t* end = reinterpret_cast<const wchar_t*>(limit);
+            internedString.UnicodeString.assign(begin, std::find(begin, end, L'\0'));
+        }
+
+        internedStrings.try_emplace(GetInternedStringKey(shortcut), std::move(internedString));
+    }
+
+    SavedStringInfo ResolveStringShortcut(DecodedInternedStrings const* internedStrings, uint64_t shortcut, uint64_t bytesUsed)
+    {
+        SavedStringInfo readInfo = {};
+        readInfo.BytesUsed = static_cast<UINT32>(bytesUsed);
+
+        DecodedInternedString const* internedString = nullptr;
+        if (internedStrings != nullptr)
+        {
+            auto it = internedStrings->find(GetInternedStringKey(shortcut));
+            if (it != internedStrings->end())
+            {
+                internedString = &it->second;
+            }
+        }
+
+        if (internedString == nullptr)
+        {
+            readInfo.Length = static_cast<UINT32>(UnknownInternedString.size());
+            readInfo.UnicodeString = UnknownInternedString.data();
+        }
+        else if (internedString->IsAnsi)
+        {
+            readInfo.Length = static_cast<UINT32>(internedString->AnsiString.size());
+            readInfo.AnsiString = internedString->AnsiString.c_str();
+            readInfo.IsAnsi = true;
+        }
+        else
+        {
+            readInfo.Length = static_cast<UINT32>(internedString->UnicodeString.size());
+            readInfo.UnicodeString = internedString->UnicodeString.c_str();
+        }
+
+        return readInfo;
+    }
+
     template<class T> 
     uint8_t const* FindStringEnd(Reader* r)
     {
@@ -125,7 +208,8 @@ namespace PixEventDecoder
     SavedStringInfo ReadString(
         _In_reads_to_ptr_(theLimit) const UINT64* theSource,
         _In_ const UINT64* theLimit,
-        _In_opt_ const UINT8* pStringMetadata)
+        _In_opt_ const UINT8* pStringMetadata,
+        _In_opt_ DecodedInternedStrings const* internedStrings)
     {
         SavedStringInfo readInfo = {};
         readInfo.UnicodeString = const_cast<wchar_t*>(EmptyString); //set string pointer to EmptyString constant in case nothing will be read
@@ -139,12 +223,25 @@ namespace PixEventDecoder
 
         uint64_t alignment = 0; //typically stays 0
         uint64_t copyChunkSize = 0;
-        bool isShortcut = false; //currently unused
+        bool isShortcut = false;
         bool isAnsi = false;
         if (pStringMetadata != nullptr)
         {
             isAnsi = ((*pStringMetadata & PIX_EVENT_METADATA_STRING_IS_ANSI) != 0);
+            isShortcut = ((*pStringMetadata & PIX_EVENT_METADATA_STRING_IS_SHORTCUT) != 0);
             copyChunkSize = 8;
+
+            if (isShortcut)
+            {
+                if (r.IsAtEnd())
+                {
+                    // the shortcut was truncated
+                    return readInfo;
+                }
+
+                uint64_t shortcut = r.Read<uint64_t>();
+                return ResolveStringShortcut(internedStrings, shortcut, r.BytesUsed());
+            }
         }
         else
         {
@@ -155,6 +252,13 @@ namespace PixEventDecoder
                 return readInfo;
             }
 
+            if ((stringInfo & PIXEventsStringIsShortcutReadMask) != 0)
+            {
+                // the id of the interned string is stored in the bits that
+                // are otherwise empty, so this is checked before validating
+                return ResolveStringShortcut(internedStrings, stringInfo, r.BytesUsed());
+            }
+
             if (!PIXDecodeStringInfo(stringInfo, alignment, copyChunkSize, isAnsi, isShortcut) //valid string info when unused bits are 0
                 || (copyChunkSize != 8 && copyChunkSize != 16) //string is expected to be written in 8 or 16 byte chunks
                 || (alignment >= copyChunkSize)) //alignment must be always less than chunk size
@@ -304,7 +408,8 @@ namespace PixEventDecoder
         UINT32 argumentsCount,
         _In_z_ T* formatString,
         const UINT64* source,
-        const UINT64* limit)
+        const UINT64* limit,
+        DecodedInternedStrings const* internedStrings)
     {
         UINT32 bytesUsed = 0;
         UINT32 argumentIndex = 0;
@@ -353,7 +458,7 @@ namespace PixEventDecoder
                             }
                         }
 
-                        SavedStringInfo argumentStringInfo = ReadString(source, limit, nullptr);
+                        SavedStringInfo argumentStringInfo = ReadString(source, limit, nullptr, internedStrings);
                         source += argumentStringInfo.BytesUsed / sizeof(UINT64);
                         bytesUsed += argumentStringInfo.BytesUsed;
                         arguments[argumentIndex++] = reinterpret_cast<UINT64>(argumentStringInfo.RawData);
@@ -387,7 +492,8 @@ namespace PixEventDecoder
         const UINT64* source,
         const UINT64* limit,
         wchar_t* buffer,
-        UINT32 bufferLength)
+        UINT32 bufferLength,
+        DecodedInternedStrings const* internedStrings)
     {
         EventData eventData;
 
@@ -426,7 +532,7 @@ namespace PixEventDecoder
             eventData.TotalBytesUsed += sizeof(UINT64);
         }
 
-        SavedStringInfo savedStringInfo = ReadString(source, limit, pStringMetadata);
+        SavedStringInfo savedStringInfo = ReadString(source, limit, pStringMetadata, internedStrings);
         UINT32 eventLength = std::min(savedStringInfo.Length, bufferLength);
 
         if (savedStringInfo.IsAnsi)
@@ -471,7 +577,8 @@ namespace PixEventDecoder
         char* ansiBuffer,
         UINT32 bufferLength,
         UINT64* arguments,
-        UINT32* pArgumentsCount)
+        UINT32* pArgumentsCount,
+        DecodedInternedStrings const* internedStrings)
     {
         static auto utf8Locale = _create_locale(LC_ALL, ".UTF8"); // We treat all ANSI strings as UTF8
 
@@ -520,7 +627,7 @@ namespace PixEventDecoder
         UINT64* pArguments = (arguments == nullptr) ? localArguments : arguments;
         memset(pArguments, 0, sizeof(UINT64) * PIX_MAX_ARGUMENTS);
 
-        SavedStringInfo formatStringInfo = ReadString(source, limit, pStringMetadata);
+        SavedStringInfo formatStringInfo = ReadString(source, limit, pStringMetadata, internedStrings);
         source += formatStringInfo.BytesUsed / sizeof(UINT64);
         eventData.FormatStringBytesUsed = formatStringInfo.BytesUsed;
         eventData.TotalBytesUsed += formatStringInfo.BytesUsed;
@@ -570,7 +677,7 @@ namespace PixEventDecoder
         {
             if (formatStringInfo.IsAnsi)
             {
-                const UINT32 totalBytesUsed = PopulateFormatArguments(pArguments, PIX_MAX_ARGUMENTS, formatStringInfo.AnsiString, source, limit);
+                const UINT32 totalBytesUsed = PopulateFormatArguments(pArguments, PIX_MAX_ARGUMENTS, formatStringInfo.AnsiString, source, limit, internedStrings);
                 if (pArgumentsCount != nullptr)
                 {
                     *pArgumentsCount = totalBytesUsed / sizeof(UINT64);
@@ -602,7 +709,7 @@ namespace PixEventDecoder
             }
             else
             {
-                const UINT32 totalBytesUsed = PopulateFormatArguments(pArguments, PIX_MAX_ARGUMENTS, formatStringInfo.UnicodeString, source, limit);
+                const UINT32 totalBytesUsed = PopulateFormatArguments(pArguments, PIX_MAX_ARGUMENTS, formatStringInfo.UnicodeString, source, limit, internedStrings);
                 if (pArgumentsCount != nullptr)
                 {
                     *pArgumentsCount = totalBytesUsed / sizeof(UINT64);
@@ -30,12 +30,21 @@ namespace PixEventDecoder
         _In_reads_to_ptr_(limit) const UINT64* source
     );
 
+    // Adds the interned string carried by a PixOp_InternString event to the
+    // table used to resolve string shortcuts. Starts reading at the first
+    // qword after the event info.
+    void ReadInternStringEvent(
+        DecodedInternedStrings& internedStrings,
+        _In_reads_to_ptr_(limit) const UINT64* source,
+        _In_ const UINT64* limit);
+
     EventData ReadEventWithNoFormatParameters(
         UINT64 eventInfo,
         _In_reads_to_ptr_(limit) const UINT64* source,
         _In_ const UINT64* limit,
         _Out_writes_(bufferLength) wchar_t* buffer,
-        UINT32 bufferLength);
+        UINT32 bufferLength,
+        _In_opt_ DecodedInternedStrings const* internedStrings = nullptr);
 
     EventData ReadEventWithFormatParameters(
         UINT64 eventInfo,
@@ -45,5 +54,6 @@ namespace PixEventDecoder
         _Out_writes_(bufferLength) char* ansiBuffer, //only used when event is an ANSI event for conversion to UNICODE
         UINT32 bufferLength,
         _Out_writes_opt_(PIX_MAX_ARGUMENTS) UINT64* arguments = nullptr,
-        _Out_opt_ UINT32* pArgumentsCount = nullptr);
+        _Out_opt_ UINT32* pArgumentsCount = nullptr,
+        _In_opt_ DecodedInternedStrings const* internedStrings = nullptr);
 }
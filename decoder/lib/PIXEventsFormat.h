@@ -44,10 +44,13 @@ enum PixOp
     PixOp_EndEvent = 0x000,
     PixOp_BeginEvent = 0x001,
     PixOp_SetMarker = 0x002,
+    PixOp_InternString = 0x003,
     
     PixOp_Invalid = 0x400,    // Valid PixOp values must be less than this
 };
 
+static_assert(PixOp_InternString == PIXEvent_InternString, "PixOp_InternString must mirror PIXEvent_InternString");
+
 //-------------------------------------------------------------------------------------------------
 // PIXEvt CPU-side event encoding/decoding
 // 6666555555555544444444443333333333222222222211111111110000000000
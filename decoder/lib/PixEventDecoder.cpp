@@ -8,12 +8,70 @@
 #include "EventReading.h"
 #include "BlockParser.h"
 
+#include <shared/PEvtCompression.h>
+#include <shared/PEvtFile.h>
+
 namespace PixEventDecoder
 {
-    DecodedPixEventBlock DecodeTimingBlock(bool ignoreEventContexts, bool gpuOnlyEvents, uint32_t bufferSize, uint8_t* buffer, ConvertClockToNanoseconds const& convertClockToNanoseconds)
+    // Turns a PIXEVT_CPU_BLOCK_COMPRESSED block back into a PIXEVT_CPU_BLOCK.
+    static bool DecompressBlock(uint32_t blockSize, uint8_t const* block, std::vector<uint8_t>& decompressed)
+    {
+        constexpr uint32_t HeaderSize = sizeof(PEvtBlkHdr) + sizeof(PEvtCmpBlkHdr);
+
+        if (blockSize < HeaderSize)
+            return false;
+
+        auto compressedHeader = reinterpret_cast<PEvtCmpBlkHdr const*>(block + sizeof(PEvtBlkHdr));
+        if (compressedHeader->DataSize > PEVT_COMPRESSION_MAX_INPUT)
+            return false;
+
+        decompressed.resize(sizeof(PEvtBlkHdr) + compressedHeader->DataSize);
+
+        if (!PEvtDecompress(block + HeaderSize, blockSize - HeaderSize, decompressed.data() + sizeof(PEvtBlkHdr), compressedHeader->DataSize))
+            return false;
+
+        auto header = reinterpret_cast<PEvtBlkHdr*>(decompressed.data());
+        memcpy(header, block, sizeof(PEvtBlkHdr));
+        header->BlockType = PIXEVT_CPU_BLOCK;
+        header->BlockSize = static_cast<UINT32>(decompressed.size());
+
+        return true;
+    }
+
+
+    DecodedPixEventBlock DecodeTimingBlock(bool ignoreEventContexts, bool gpuOnlyEvents, uint32_t bufferSize, uint8_t* buffer, ConvertClockToNanoseconds const& convertClockToNanoseconds, DecodedInternedStrings* internedStrings)
     {
         DecodedPixEventBlock decodedData;
 
+        if (!buffer || !convertClockToNanoseconds)
+            return decodedData;
+
+        // A buffer may hold several blocks back to back; only the first one is
+        // decoded here (see DecodeTimingBlocks)
+        if (bufferSize >= sizeof(PEvtBlkHdr))
+        {
+            UINT32 blockSize = reinterpret_cast<PEvtBlkHdr const*>(buffer)->BlockSize;
+            if (blockSize >= sizeof(PEvtBlkHdr) && blockSize < bufferSize)
+            {
+                bufferSize = blockSize;
+            }
+        }
+
+        // Statistics blocks don't have any events (see DecodeRuntimeStatistics)
+        if (bufferSize >= sizeof(PEvtBlkHdr) && reinterpret_cast<PEvtBlkHdr const*>(buffer)->BlockType == PIXEVT_STATS_BLOCK)
+            return decodedData;
+
+        // Compressed blocks are decoded from a decompressed copy
+        std::vector<uint8_t> decompressed;
+        if (bufferSize >= sizeof(PEvtBlkHdr) && reinterpret_cast<PEvtBlkHdr const*>(buffer)->BlockType == PIXEVT_CPU_BLOCK_COMPRESSED)
+        {
+            if (!DecompressBlock(bufferSize, buffer, decompressed))
+                return decodedData;
+
+            buffer = decompressed.data();
+            bufferSize = static_cast<uint32_t>(decompressed.size());
+        }
+
         // Predict max number of events possible based on buffer size and smallest PIX event possible
         uint32_t maxEventsInBuffer = bufferSize / sizeof(uint64_t);
 
@@ -22,12 +80,15 @@ namespace PixEventDecoder
         decodedData.Names.reserve(maxEventsInBuffer);
         decodedData.D3D12Contexts.reserve(maxEventsInBuffer);
 
-        if (!buffer || !convertClockToNanoseconds)
-            return decodedData;
-
         bool isFirstEventInBlock = true;
 
-        auto parser = std::make_unique<BlockParser>(reinterpret_cast<PEvtBlkHdr const*>(buffer), bufferSize, convertClockToNanoseconds);
+        DecodedInternedStrings localInternedStrings;
+        if (internedStrings == nullptr)
+        {
+            internedStrings = &localInternedStrings;
+        }
+
+        auto parser = std::make_unique<BlockParser>(reinterpret_cast<PEvtBlkHdr const*>(buffer), bufferSize, convertClockToNanoseconds, *internedStrings);
         parser->ProcessEvents([&](const TimingMarkerEvent& timingEvt, PCWSTR name)
         {
             if (isFirstEventInBlock)
@@ -83,6 +144,176 @@ namespace PixEventDecoder
         return decodedData;
     }
 
+    std::vector<DecodedPixEventBlock> DecodeTimingBlocks(bool ignoreEventContexts, bool gpuOnlyEvents, uint32_t bufferSize, uint8_t* buffer, ConvertClockToNanoseconds const& convertClockToNanoseconds, DecodedInternedStrings* internedStrings)
+    {
+        std::vector<DecodedPixEventBlock> decodedBlocks;
+
+        if (!buffer || !convertClockToNanoseconds)
+            return decodedBlocks;
+
+        // Blocks in the same buffer share their interned strings
+        DecodedInternedStrings localInternedStrings;
+        if (internedStrings == nullptr)
+        {
+            internedStrings = &localInternedStrings;
+        }
+
+        while (bufferSize >= sizeof(PEvtBlkHdr))
+        {
+            auto header = reinterpret_cast<PEvtBlkHdr const*>(buffer);
+
+            // A block size of 0 means that the block takes up the rest of the buffer
+            uint32_t blockSize = header->BlockSize;
+            if (blockSize == 0 || blockSize > bufferSize)
+            {
+                blockSize = bufferSize;
+            }
+            else if (blockSize < sizeof(PEvtBlkHdr))
+            {
+                break;
+            }
+
+            if (header->BlockType == PIXEVT_STATS_BLOCK)
+            {
+                buffer += blockSize;
+                bufferSize -= blockSize;
+                continue;
+            }
+
+            if (header->BlockType != PIXEVT_CPU_BLOCK && header->BlockType != PIXEVT_CPU_BLOCK_COMPRESSED)
+            {
+                break;
+            }
+
+            auto decodedData = DecodeTimingBlock(ignoreEventContexts, gpuOnlyEvents, blockSize, buffer, convertClockToNanoseconds, internedStrings);
+
+            // Blocks without any events still say which thread they came from
+            if (decodedData.Events.empty())
+            {
+                decodedData.ProcessId = header->cpuHeader.processId;
+                decodedData.ThreadId = header->cpuHeader.threadId;
+            }
+            decodedBlocks.push_back(std::move(decodedData));
+
+            buffer += blockSize;
+            bufferSize -= blockSize;
+        }
+
+        return decodedBlocks;
+    }
+
+    std::vector<DecodedRuntimeStatistics> DecodeRuntimeStatistics(uint32_t bufferSize, uint8_t const* buffer, ConvertClockToNanoseconds const& convertClockToNanoseconds)
+    {
+        std::vector<DecodedRuntimeStatistics> decodedStatistics;
+
+        if (!buffer || !convertClockToNanoseconds)
+            return decodedStatistics;
+
+        while (bufferSize >= sizeof(PEvtBlkHdr))
+        {
+            auto header = reinterpret_cast<PEvtBlkHdr const*>(buffer);
+
+            uint32_t blockSize = header->BlockSize;
+            if (blockSize == 0 || blockSize > bufferSize)
+            {
+                blockSize = bufferSize;
+            }
+            else if (blockSize < sizeof(PEvtBlkHdr))
+            {
+                break;
+            }
+
+            if (header->BlockType == PIXEVT_STATS_BLOCK && blockSize >= sizeof(PEvtBlkHdr) + sizeof(PEvtStatsBlk))
+            {
+                PEvtStatsBlk statistics;
+                memcpy(&statistics, buffer + sizeof(PEvtBlkHdr), sizeof(statistics));
+
+                DecodedRuntimeStatistics decoded;
+                decoded.ProcessId = header->cpuHeader.processId;
+                decoded.Timestamp = convertClockToNanoseconds(header->cpuHeader.beginTimestamp);
+                decoded.Threads = statistics.Threads;
+                decoded.Events = statistics.Events;
+                decoded.BlocksWritten = statistics.BlocksWritten;
+                decoded.BytesRecorded = statistics.BytesRecorded;
+                decoded.BytesWritten = statistics.BytesWritten;
+                decoded.Writes = statistics.Writes;
+                decoded.BlockReplacements = statistics.BlockReplacements;
+                decoded.AllocationFailures = statistics.AllocationFailures;
+                decoded.QueuedBlocks = statistics.QueuedBlocks;
+                decoded.MaxQueuedBlocks = statistics.MaxQueuedBlocks;
+                decoded.OverflowBlocks = statistics.OverflowBlocks;
+                decoded.DroppedBlocks = statistics.DroppedBlocks;
+                decodedStatistics.push_back(decoded);
+            }
+
+            buffer += blockSize;
+            bufferSize -= blockSize;
+        }
+
+        return decodedStatistics;
+    }
+
+    std::vector<std::vector<uint8_t>> ReadCaptureFile(uint64_t fileSize, uint8_t const* file)
+    {
+        std::vector<std::vector<uint8_t>> writes;
+
+        if (!file || fileSize < sizeof(PEvtFileHdr))
+            return writes;
+
+        auto header = reinterpret_cast<PEvtFileHdr const*>(file);
+        if (header->Magic != PIXEVT_FILE_MAGIC || header->Version != PIXEVT_FILE_VERSION)
+            return writes;
+
+        const uint64_t slotCount = header->SlotCount;
+        const uint64_t slotSize = header->SlotSize;
+        if (slotSize < sizeof(PEvtFileSlotHdr) ||
+            header->SlotsOffset < sizeof(PEvtFileHdr) + slotCount * sizeof(UINT64) ||
+            header->SlotsOffset + slotCount * slotSize > fileSize)
+        {
+            return writes;
+        }
+
+        // The interned strings come first, so that the events after them that
+        // refer to them can be decoded
+        const uint64_t stringTableUsed = header->StringTableUsed;
+        if (stringTableUsed != 0 &&
+            stringTableUsed <= header->StringTableSize &&
+            header->StringTableOffset + stringTableUsed <= fileSize)
+        {
+            auto stringTable = file + header->StringTableOffset;
+            writes.emplace_back(stringTable, stringTable + stringTableUsed);
+        }
+
+        auto commitSequences = reinterpret_cast<UINT64 const*>(file + sizeof(PEvtFileHdr));
+
+        std::vector<std::pair<uint64_t, uint64_t>> committedSlots; // sequence, slot
+        for (uint64_t slot = 0; slot < slotCount; ++slot)
+        {
+            const uint64_t sequence = commitSequences[slot];
+            if (sequence != 0 && (sequence - 1) % slotCount == slot)
+            {
+                committedSlots.emplace_back(sequence, slot);
+            }
+        }
+
+        std::sort(committedSlots.begin(), committedSlots.end());
+
+        writes.reserve(writes.size() + committedSlots.size());
+        for (auto const& committedSlot : committedSlots)
+        {
+            const uint64_t slot = committedSlot.second;
+            auto slotStart = file + header->SlotsOffset + slot * slotSize;
+            auto slotHeader = reinterpret_cast<PEvtFileSlotHdr const*>(slotStart);
+            if (slotHeader->Size > slotSize - sizeof(PEvtFileSlotHdr))
+                continue;
+
+            auto data = slotStart + sizeof(PEvtFileSlotHdr);
+            writes.emplace_back(data, data + slotHeader->Size);
+        }
+
+        return writes;
+    }
+
     std::optional<DecodedNameAndColor> TryDecodePIXBeginEventOrPIXSetMarkerBlob(const UINT64* source, const UINT64* limit)
     {
         DecodedNameAndColor output;
@@ -9,6 +9,7 @@
 #include <locale.h>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
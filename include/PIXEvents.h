@@ -89,6 +89,20 @@ namespace PIXEventsDetail
         return PIX_EVENT_METADATA_STRING_IS_ANSI;
     }
 
+#if PIX_ENABLE_STRING_INTERNING
+    template<>
+    inline UINT8 PIXEncodeStringIsAnsi<PIXInternedString<char>>()
+    {
+        return PIX_EVENT_METADATA_STRING_IS_ANSI | PIX_EVENT_METADATA_STRING_IS_SHORTCUT;
+    }
+
+    template<>
+    inline UINT8 PIXEncodeStringIsAnsi<PIXInternedString<wchar_t>>()
+    {
+        return PIX_EVENT_METADATA_STRING_IS_SHORTCUT;
+    }
+#endif // PIX_ENABLE_STRING_INTERNING
+
     template<typename STR, typename... ARGS>
     __declspec(noinline) void PIXBeginEventAllocate(PIXEventsThreadInfo* threadInfo, UINT64 color, STR formatString, ARGS... args)
     {
@@ -114,13 +128,14 @@ namespace PIXEventsDetail
             PIXEncodeStringIsAnsi<STR>();
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_BeginEvent, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     template<typename STR, typename... ARGS>
     void PIXBeginEvent(UINT64 color, STR formatString, ARGS... args)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit != nullptr)
         {
@@ -141,6 +156,7 @@ namespace PIXEventsDetail
                     PIXEncodeStringIsAnsi<STR>();
                 *eventDestination = PIXEncodeEventInfo(time, PIXEvent_BeginEvent, eventSize, eventMetadata);
 
+                PIXEventsPublishBarrier();
                 threadInfo->destination = destination;
             }
             else
@@ -174,13 +190,14 @@ namespace PIXEventsDetail
             PIXEncodeIndexColor(color);
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_BeginEvent, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     template<typename STR, typename... ARGS>
     void PIXBeginEvent(UINT8 color, STR formatString, ARGS... args)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit != nullptr)
         {
@@ -200,6 +217,7 @@ namespace PIXEventsDetail
                     PIXEncodeIndexColor(color);
                 *eventDestination = PIXEncodeEventInfo(time, PIXEvent_BeginEvent, eventSize, eventMetadata);
 
+                PIXEventsPublishBarrier();
                 threadInfo->destination = destination;
             }
             else
@@ -235,13 +253,14 @@ namespace PIXEventsDetail
             PIX_EVENT_METADATA_HAS_COLOR;
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_SetMarker, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     template<typename STR, typename... ARGS>
     void PIXSetMarker(UINT64 color, STR formatString, ARGS... args)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit != nullptr)
         {
@@ -262,6 +281,7 @@ namespace PIXEventsDetail
                     PIX_EVENT_METADATA_HAS_COLOR;
                 *eventDestination = PIXEncodeEventInfo(time, PIXEvent_SetMarker, eventSize, eventMetadata);
 
+                PIXEventsPublishBarrier();
                 threadInfo->destination = destination;
             }
             else
@@ -296,13 +316,14 @@ namespace PIXEventsDetail
             PIXEncodeIndexColor(color);
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_SetMarker, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     template<typename STR, typename... ARGS>
     void PIXSetMarker(UINT8 color, STR formatString, ARGS... args)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit != nullptr)
         {
@@ -322,6 +343,7 @@ namespace PIXEventsDetail
                     PIXEncodeIndexColor(color);
                 *eventDestination = PIXEncodeEventInfo(time, PIXEvent_SetMarker, eventSize, eventMetadata);
 
+                PIXEventsPublishBarrier();
                 threadInfo->destination = destination;
             }
             else
@@ -331,6 +353,180 @@ namespace PIXEventsDetail
         }
     }
 
+#if PIX_ENABLE_ENCODED_LITERALS
+    //events with a literal format string and no arguments (see PIX_LITERAL) are
+    //fully encoded at compile time apart from the timestamp and index color.
+    //literals too long for the fast copy space are written like any other string
+
+    template<typename T, size_t N>
+    void PIXBeginEvent(UINT64 color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        constexpr size_t qwords = 2 + PIXEncodedLiteral<T, N>::QwordCount;
+        if constexpr (qwords > PIXEventsSafeFastCopySpaceQwords)
+        {
+            PIXBeginEvent(color, literal.string);
+        }
+        else
+        {
+            static_assert(qwords <= PIXEventsSizeMax, "encoded literal does not fit in the event size field");
+            constexpr UINT8 eventSize = static_cast<UINT8>(qwords);
+            constexpr UINT64 eventInfo = PIXEncodeEventInfo(0, PIXEvent_BeginEvent, eventSize, PIXEncodedLiteral<T, N>::Metadata | PIX_EVENT_METADATA_HAS_COLOR);
+
+            PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
+            UINT64* limit = threadInfo->biasedLimit;
+            if (limit != nullptr)
+            {
+                UINT64* destination = threadInfo->destination;
+                if (destination < limit)
+                {
+                    UINT64 time = PIXGetTimestampCounter();
+                    *destination++ = eventInfo | ((time & PIXEventsTimestampWriteMask) << PIXEventsTimestampBitShift);
+                    *destination++ = color;
+
+                    for (UINT i = 0; i < PIXEncodedLiteral<T, N>::QwordCount; ++i)
+                    {
+                        *destination++ = literal.qwords[i];
+                    }
+                    *destination = PIXEventsBlockEndMarker;
+
+                    PIXEventsPublishBarrier();
+                    threadInfo->destination = destination;
+                }
+                else
+                {
+                    PIXBeginEventAllocate(threadInfo, color, literal.string);
+                }
+            }
+        }
+    }
+
+    template<typename T, size_t N>
+    void PIXBeginEvent(UINT8 color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        constexpr size_t qwords = 1 + PIXEncodedLiteral<T, N>::QwordCount;
+        if constexpr (qwords > PIXEventsSafeFastCopySpaceQwords)
+        {
+            PIXBeginEvent(color, literal.string);
+        }
+        else
+        {
+            static_assert(qwords <= PIXEventsSizeMax, "encoded literal does not fit in the event size field");
+            constexpr UINT8 eventSize = static_cast<UINT8>(qwords);
+            constexpr UINT64 eventInfo = PIXEncodeEventInfo(0, PIXEvent_BeginEvent, eventSize, PIXEncodedLiteral<T, N>::Metadata);
+
+            PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
+            UINT64* limit = threadInfo->biasedLimit;
+            if (limit != nullptr)
+            {
+                UINT64* destination = threadInfo->destination;
+                if (destination < limit)
+                {
+                    UINT64 time = PIXGetTimestampCounter();
+                    *destination++ = eventInfo | ((time & PIXEventsTimestampWriteMask) << PIXEventsTimestampBitShift) |
+                        (static_cast<UINT64>(PIXEncodeIndexColor(color)) << PIXEventsMetadataBitShift);
+
+                    for (UINT i = 0; i < PIXEncodedLiteral<T, N>::QwordCount; ++i)
+                    {
+                        *destination++ = literal.qwords[i];
+                    }
+                    *destination = PIXEventsBlockEndMarker;
+
+                    PIXEventsPublishBarrier();
+                    threadInfo->destination = destination;
+                }
+                else
+                {
+                    PIXBeginEventAllocate(threadInfo, color, literal.string);
+                }
+            }
+        }
+    }
+
+    template<typename T, size_t N>
+    void PIXSetMarker(UINT64 color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        constexpr size_t qwords = 2 + PIXEncodedLiteral<T, N>::QwordCount;
+        if constexpr (qwords > PIXEventsSafeFastCopySpaceQwords)
+        {
+            PIXSetMarker(color, literal.string);
+        }
+        else
+        {
+            static_assert(qwords <= PIXEventsSizeMax, "encoded literal does not fit in the event size field");
+            constexpr UINT8 eventSize = static_cast<UINT8>(qwords);
+            constexpr UINT64 eventInfo = PIXEncodeEventInfo(0, PIXEvent_SetMarker, eventSize, PIXEncodedLiteral<T, N>::Metadata | PIX_EVENT_METADATA_HAS_COLOR);
+
+            PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
+            UINT64* limit = threadInfo->biasedLimit;
+            if (limit != nullptr)
+            {
+                UINT64* destination = threadInfo->destination;
+                if (destination < limit)
+                {
+                    UINT64 time = PIXGetTimestampCounter();
+                    *destination++ = eventInfo | ((time & PIXEventsTimestampWriteMask) << PIXEventsTimestampBitShift);
+                    *destination++ = color;
+
+                    for (UINT i = 0; i < PIXEncodedLiteral<T, N>::QwordCount; ++i)
+                    {
+                        *destination++ = literal.qwords[i];
+                    }
+                    *destination = PIXEventsBlockEndMarker;
+
+                    PIXEventsPublishBarrier();
+                    threadInfo->destination = destination;
+                }
+                else
+                {
+                    PIXSetMarkerAllocate(threadInfo, color, literal.string);
+                }
+            }
+        }
+    }
+
+    template<typename T, size_t N>
+    void PIXSetMarker(UINT8 color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        constexpr size_t qwords = 1 + PIXEncodedLiteral<T, N>::QwordCount;
+        if constexpr (qwords > PIXEventsSafeFastCopySpaceQwords)
+        {
+            PIXSetMarker(color, literal.string);
+        }
+        else
+        {
+            static_assert(qwords <= PIXEventsSizeMax, "encoded literal does not fit in the event size field");
+            constexpr UINT8 eventSize = static_cast<UINT8>(qwords);
+            constexpr UINT64 eventInfo = PIXEncodeEventInfo(0, PIXEvent_SetMarker, eventSize, PIXEncodedLiteral<T, N>::Metadata);
+
+            PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
+            UINT64* limit = threadInfo->biasedLimit;
+            if (limit != nullptr)
+            {
+                UINT64* destination = threadInfo->destination;
+                if (destination < limit)
+                {
+                    UINT64 time = PIXGetTimestampCounter();
+                    *destination++ = eventInfo | ((time & PIXEventsTimestampWriteMask) << PIXEventsTimestampBitShift) |
+                        (static_cast<UINT64>(PIXEncodeIndexColor(color)) << PIXEventsMetadataBitShift);
+
+                    for (UINT i = 0; i < PIXEncodedLiteral<T, N>::QwordCount; ++i)
+                    {
+                        *destination++ = literal.qwords[i];
+                    }
+                    *destination = PIXEventsBlockEndMarker;
+
+                    PIXEventsPublishBarrier();
+                    threadInfo->destination = destination;
+                }
+                else
+                {
+                    PIXSetMarkerAllocate(threadInfo, color, literal.string);
+                }
+            }
+        }
+    }
+#endif // PIX_ENABLE_ENCODED_LITERALS
+
     template<typename STR, typename... ARGS>
     __declspec(noinline) void PIXBeginEventOnContextCpuAllocate(UINT64*& eventDestination, UINT8& eventSize, PIXEventsThreadInfo* threadInfo, void* context, UINT64 color, STR formatString, ARGS... args)
     {
@@ -364,13 +560,14 @@ namespace PIXEventsDetail
             PIX_EVENT_METADATA_HAS_COLOR;
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_BeginEvent, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     template<typename STR, typename... ARGS>
     void PIXBeginEventOnContextCpu(UINT64*& eventDestination, UINT8& eventSize, void* context, UINT64 color, STR formatString, ARGS... args)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit == nullptr)
         {
@@ -396,6 +593,7 @@ namespace PIXEventsDetail
                 PIX_EVENT_METADATA_HAS_COLOR;
             *eventDestination = PIXEncodeEventInfo(time, PIXEvent_BeginEvent, eventSize, eventMetadata);
 
+            PIXEventsPublishBarrier();
             threadInfo->destination = destination;
         }
         else
@@ -480,13 +678,14 @@ namespace PIXEventsDetail
             PIXEncodeIndexColor(color);
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_BeginEvent, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     template<typename STR, typename... ARGS>
     void PIXBeginEventOnContextCpu(UINT64*& eventDestination, UINT8& eventSize, void* context, UINT8 color, STR formatString, ARGS... args)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit == nullptr)
         {
@@ -511,6 +710,7 @@ namespace PIXEventsDetail
                 PIXEncodeIndexColor(color);
             *eventDestination = PIXEncodeEventInfo(time, PIXEvent_BeginEvent, eventSize, eventMetadata);
 
+            PIXEventsPublishBarrier();
             threadInfo->destination = destination;
         }
         else
@@ -596,13 +796,14 @@ namespace PIXEventsDetail
             PIX_EVENT_METADATA_HAS_COLOR;
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_SetMarker, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     template<typename STR, typename... ARGS>
     void PIXSetMarkerOnContextCpu(UINT64*& eventDestination, UINT8& eventSize, void* context, UINT64 color, STR formatString, ARGS... args)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit == nullptr)
         {
@@ -628,6 +829,7 @@ namespace PIXEventsDetail
                 PIX_EVENT_METADATA_HAS_COLOR;
             *eventDestination = PIXEncodeEventInfo(time, PIXEvent_SetMarker, eventSize, eventMetadata);
 
+            PIXEventsPublishBarrier();
             threadInfo->destination = destination;
         }
         else
@@ -712,13 +914,14 @@ namespace PIXEventsDetail
             PIXEncodeIndexColor(color);
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_SetMarker, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     template<typename STR, typename... ARGS>
     void PIXSetMarkerOnContextCpu(UINT64*& eventDestination, UINT8& eventSize, void* context, UINT8 color, STR formatString, ARGS... args)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit == nullptr)
         {
@@ -743,6 +946,7 @@ namespace PIXEventsDetail
                 PIXEncodeIndexColor(color);
             *eventDestination = PIXEncodeEventInfo(time, PIXEvent_SetMarker, eventSize, eventMetadata);
 
+            PIXEventsPublishBarrier();
             threadInfo->destination = destination;
         }
         else
@@ -812,12 +1016,13 @@ namespace PIXEventsDetail
         *destination++ = PIXEncodeEventInfo(time, PIXEvent_EndEvent, eventSize, eventMetadata);
         *destination = PIXEventsBlockEndMarker;
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
     }
 
     inline void PIXEndEvent()
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit != nullptr)
         {
@@ -831,6 +1036,7 @@ namespace PIXEventsDetail
                 *destination++ = PIXEncodeEventInfo(time, PIXEvent_EndEvent, eventSize, eventMetadata);
                 *destination = PIXEventsBlockEndMarker;
 
+                PIXEventsPublishBarrier();
                 threadInfo->destination = destination;
             }
             else
@@ -865,6 +1071,7 @@ namespace PIXEventsDetail
         const UINT8 eventMetadata = PIX_EVENT_METADATA_ON_CONTEXT;
         *eventDestination = PIXEncodeEventInfo(time, PIXEvent_EndEvent, eventSize, eventMetadata);
 
+        PIXEventsPublishBarrier();
         threadInfo->destination = destination;
 
         return eventDestination;
@@ -872,7 +1079,7 @@ namespace PIXEventsDetail
 
     inline UINT64* PIXEndEventOnContextCpu(void* context)
     {
-        PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+        PIXEventsThreadInfo* threadInfo = PIXGetCachedThreadInfo();
         UINT64* limit = threadInfo->biasedLimit;
         if (limit != nullptr)
         {
@@ -891,6 +1098,7 @@ namespace PIXEventsDetail
                 const UINT8 eventMetadata = PIX_EVENT_METADATA_ON_CONTEXT;
                 *eventDestination = PIXEncodeEventInfo(time, PIXEvent_EndEvent, eventSize, eventMetadata);
 
+                PIXEventsPublishBarrier();
                 threadInfo->destination = destination;
 
                 return eventDestination;
@@ -1058,6 +1266,137 @@ void PIXSetMarker(UINT8 color, PCSTR formatString, ARGS... args)
     PIXEventsDetail::PIXSetMarker(color, formatString, args...);
 }
 
+#if PIX_ENABLE_STRING_INTERNING
+
+// Interned strings (see PIX_INTERN) are only supported for events on the CPU
+// timeline, not for events on a D3D12 context.
+
+template<typename CHAR, typename... ARGS>
+void PIXBeginEvent(UINT64 color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXBeginEvent(color, formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXBeginEvent(UINT32 color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXBeginEvent(static_cast<UINT64>(color), formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXBeginEvent(INT32 color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXBeginEvent(static_cast<UINT64>(color), formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXBeginEvent(DWORD color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXBeginEvent(static_cast<UINT64>(color), formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXBeginEvent(UINT8 color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXBeginEvent(color, formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXSetMarker(UINT64 color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXSetMarker(color, formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXSetMarker(UINT32 color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXSetMarker(static_cast<UINT64>(color), formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXSetMarker(INT32 color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXSetMarker(static_cast<UINT64>(color), formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXSetMarker(DWORD color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXSetMarker(static_cast<UINT64>(color), formatString, args...);
+}
+
+template<typename CHAR, typename... ARGS>
+void PIXSetMarker(UINT8 color, PIXInternedString<CHAR> formatString, ARGS... args)
+{
+    PIXEventsDetail::PIXSetMarker(color, formatString, args...);
+}
+
+#endif // PIX_ENABLE_STRING_INTERNING
+
+#if PIX_ENABLE_ENCODED_LITERALS
+
+template<typename T, size_t N>
+void PIXBeginEvent(UINT64 color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXBeginEvent(color, literal);
+}
+
+template<typename T, size_t N>
+void PIXBeginEvent(UINT32 color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXBeginEvent(static_cast<UINT64>(color), literal);
+}
+
+template<typename T, size_t N>
+void PIXBeginEvent(INT32 color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXBeginEvent(static_cast<UINT64>(color), literal);
+}
+
+template<typename T, size_t N>
+void PIXBeginEvent(DWORD color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXBeginEvent(static_cast<UINT64>(color), literal);
+}
+
+template<typename T, size_t N>
+void PIXBeginEvent(UINT8 color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXBeginEvent(color, literal);
+}
+
+template<typename T, size_t N>
+void PIXSetMarker(UINT64 color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXSetMarker(color, literal);
+}
+
+template<typename T, size_t N>
+void PIXSetMarker(UINT32 color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXSetMarker(static_cast<UINT64>(color), literal);
+}
+
+template<typename T, size_t N>
+void PIXSetMarker(INT32 color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXSetMarker(static_cast<UINT64>(color), literal);
+}
+
+template<typename T, size_t N>
+void PIXSetMarker(DWORD color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXSetMarker(static_cast<UINT64>(color), literal);
+}
+
+template<typename T, size_t N>
+void PIXSetMarker(UINT8 color, PIXEncodedLiteral<T, N> const& literal)
+{
+    PIXEventsDetail::PIXSetMarker(color, literal);
+}
+
+#endif // PIX_ENABLE_ENCODED_LITERALS
+
 template<typename CONTEXT, typename... ARGS>
 void PIXBeginEvent(CONTEXT* context, UINT64 color, PCWSTR formatString, ARGS... args)
 {
@@ -1558,6 +1897,70 @@ public:
         PIXBeginEvent(color, formatString, args...);
     }
 
+#if defined(USE_PIX) && PIX_ENABLE_STRING_INTERNING
+    template<typename CHAR, typename... ARGS>
+    PIXScopedEventObject(UINT64 color, PIXInternedString<CHAR> formatString, ARGS... args)
+    {
+        PIXBeginEvent(color, formatString, args...);
+    }
+
+    template<typename CHAR, typename... ARGS>
+    PIXScopedEventObject(UINT32 color, PIXInternedString<CHAR> formatString, ARGS... args)
+    {
+        PIXBeginEvent(color, formatString, args...);
+    }
+
+    template<typename CHAR, typename... ARGS>
+    PIXScopedEventObject(INT32 color, PIXInternedString<CHAR> formatString, ARGS... args)
+    {
+        PIXBeginEvent(color, formatString, args...);
+    }
+
+    template<typename CHAR, typename... ARGS>
+    PIXScopedEventObject(DWORD color, PIXInternedString<CHAR> formatString, ARGS... args)
+    {
+        PIXBeginEvent(color, formatString, args...);
+    }
+
+    template<typename CHAR, typename... ARGS>
+    PIXScopedEventObject(UINT8 color, PIXInternedString<CHAR> formatString, ARGS... args)
+    {
+        PIXBeginEvent(color, formatString, args...);
+    }
+#endif // USE_PIX && PIX_ENABLE_STRING_INTERNING
+
+#if defined(USE_PIX) && PIX_ENABLE_ENCODED_LITERALS
+    template<typename T, size_t N>
+    PIXScopedEventObject(UINT64 color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        PIXBeginEvent(color, literal);
+    }
+
+    template<typename T, size_t N>
+    PIXScopedEventObject(UINT32 color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        PIXBeginEvent(color, literal);
+    }
+
+    template<typename T, size_t N>
+    PIXScopedEventObject(INT32 color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        PIXBeginEvent(color, literal);
+    }
+
+    template<typename T, size_t N>
+    PIXScopedEventObject(DWORD color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        PIXBeginEvent(color, literal);
+    }
+
+    template<typename T, size_t N>
+    PIXScopedEventObject(UINT8 color, PIXEncodedLiteral<T, N> const& literal)
+    {
+        PIXBeginEvent(color, literal);
+    }
+#endif // USE_PIX && PIX_ENABLE_ENCODED_LITERALS
+
     ~PIXScopedEventObject()
     {
         PIXEndEvent();
@@ -1568,6 +1971,14 @@ public:
 #define PIXGetScopedEventVariableName(a, b) PIXConcatenate(a, b)
 #define PIXScopedEvent(context, ...) PIXScopedEventObject<PIXInferScopedEventType<decltype(context)>::Type> PIXGetScopedEventVariableName(pixEvent, __LINE__)(context, __VA_ARGS__)
 
+#if defined(USE_PIX) && PIX_ENABLE_STRING_INTERNING
+#define PIX_INTERN(string) PIXMakeInternedString<PIXEncodeStringShortcut(string)>(string)
+#endif
+
+#if defined(USE_PIX) && PIX_ENABLE_ENCODED_LITERALS
+#define PIX_LITERAL(string) ([]() -> auto const& { static constexpr PIXEncodedLiteral literal(string); return literal; }())
+#endif
+
 #ifdef PIX3__DEFINED_CONSTEXPR
 #undef constexpr
 #undef PIX3__DEFINED_CONSTEXPR
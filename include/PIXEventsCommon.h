@@ -49,6 +49,102 @@
 #define PIX_ENABLE_BLOCK_ARGUMENT_COPY_SET 1
 #endif
 
+// Select how the block argument copy reads strings. x86/x64 and ARM64 copy
+// 128-bits at a time using SSE2 and NEON respectively, every other target
+// copies 64-bits at a time with plain integer operations.
+
+#if PIX_ENABLE_BLOCK_ARGUMENT_COPY
+#if defined(_M_X64) || defined(_M_IX86)
+#define PIX_BLOCK_ARGUMENT_COPY_SSE2 1
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PIX_BLOCK_ARGUMENT_COPY_NEON 1
+#if defined(_M_ARM64)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#else
+#include <string.h>
+#endif
+#endif
+
+//
+// Literal strings can be interned (see PIX_INTERN in pix3.h) so that events
+// only carry a fixed size shortcut to the string instead of its characters.
+// This relies on C++17 inline variables, so it is only enabled for C++17 and
+// later. Applications may also explicitly set PIX_ENABLE_STRING_INTERNING to 0
+// to disable it.
+//
+
+#if !defined(PIX_ENABLE_STRING_INTERNING)
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#define PIX_ENABLE_STRING_INTERNING 1
+#else
+#define PIX_ENABLE_STRING_INTERNING 0
+#endif
+#endif
+
+//
+// Literal strings passed without arguments can also be encoded at compile time
+// (see PIX_LITERAL in pix3.h), so that writing the event is a fixed size copy.
+// This relies on C++17 if constexpr and class template argument deduction, so
+// it is only enabled for C++17 and later. Applications may also explicitly set
+// PIX_ENABLE_ENCODED_LITERALS to 0 to disable it.
+//
+
+#if !defined(PIX_ENABLE_ENCODED_LITERALS)
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#define PIX_ENABLE_ENCODED_LITERALS 1
+#else
+#define PIX_ENABLE_ENCODED_LITERALS 0
+#endif
+#endif
+
+//
+// std::basic_string_view and std::basic_string arguments are copied using their
+// length instead of scanning for the terminator. This needs <string_view>, so
+// it is only enabled for C++17 and later. Applications may also explicitly set
+// PIX_ENABLE_SIZED_STRING_ARGUMENTS to 0 to avoid including the standard
+// library headers.
+//
+
+#if !defined(PIX_ENABLE_SIZED_STRING_ARGUMENTS)
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#define PIX_ENABLE_SIZED_STRING_ARGUMENTS 1
+#else
+#define PIX_ENABLE_SIZED_STRING_ARGUMENTS 0
+#endif
+#endif
+
+#if PIX_ENABLE_SIZED_STRING_ARGUMENTS
+#include <string.h>
+#include <string>
+#include <string_view>
+#endif
+
+//
+// Each event looks up the PIXEventsThreadInfo of the calling thread. Applications
+// may set PIX_ENABLE_THREAD_INFO_CACHE to 1 to cache the pointer in a
+// thread_local in the calling module, together with the capture generation it
+// was fetched at, so that the common case doesn't need to call into the
+// runtime. The runtime bumps the generation whenever the thread infos need to
+// be refreshed (eg when capture is enabled, disabled or flushed), and sets a
+// per-thread flag once a thread's thread info has been destroyed, so that
+// events written later in the thread's exit never use the cached pointer. The
+// cache imports PIXEventsGetCaptureGeneration and PIXEventsGetThreadExitedFlag,
+// which older versions of WinPixEventRuntime.dll don't export, so it is off by
+// default. It relies on C++17 inline variables.
+//
+
+#if !defined(PIX_ENABLE_THREAD_INFO_CACHE)
+#define PIX_ENABLE_THREAD_INFO_CACHE 0
+#endif
+
+#if PIX_ENABLE_THREAD_INFO_CACHE && !((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+#error PIX_ENABLE_THREAD_INFO_CACHE needs C++17 or later
+#endif
+
 struct PIXEventsBlockInfo;
 
 struct PIXEventsThreadInfo
@@ -59,12 +155,152 @@ struct PIXEventsThreadInfo
 };
 
 extern "C" UINT64 WINAPI PIXEventsReplaceBlock(PIXEventsThreadInfo * threadInfo, bool getEarliestTime) noexcept;
+extern "C" void WINAPI PIXEventsRegisterInternedString(UINT64 shortcut, _In_ const void* string) noexcept;
+
+#if PIX_ENABLE_THREAD_INFO_CACHE
+
+extern "C" const volatile UINT64* WINAPI PIXEventsGetCaptureGeneration() noexcept;
+extern "C" const volatile UINT32* WINAPI PIXEventsGetThreadExitedFlag() noexcept;
+
+//the thread info of the calling thread and the capture generation it was fetched at
+//exitedThreadInfo has no limit, so events written after the thread's exited flag is set are dropped
+struct PIXEventsThreadInfoCache
+{
+    static inline thread_local PIXEventsThreadInfo* threadInfo;
+    static inline thread_local UINT64 generation;
+    static inline thread_local const volatile UINT32* threadExited;
+    static inline const volatile UINT64* captureGeneration;
+    static inline PIXEventsThreadInfo exitedThreadInfo;
+};
+
+__declspec(noinline) inline PIXEventsThreadInfo* PIXRefreshThreadInfoCache()
+{
+    const volatile UINT64* captureGeneration = PIXEventsThreadInfoCache::captureGeneration;
+    if (!captureGeneration)
+    {
+        captureGeneration = PIXEventsGetCaptureGeneration();
+        PIXEventsThreadInfoCache::captureGeneration = captureGeneration;
+    }
+
+    const volatile UINT32* threadExited = PIXEventsThreadInfoCache::threadExited;
+    if (!threadExited)
+    {
+        threadExited = PIXEventsGetThreadExitedFlag();
+        PIXEventsThreadInfoCache::threadExited = threadExited;
+    }
+
+    //nothing is cached for an exited thread, so a new thread info for it is picked up
+    if (*threadExited)
+    {
+        PIXEventsThreadInfoCache::threadInfo = nullptr;
+        return &PIXEventsThreadInfoCache::exitedThreadInfo;
+    }
+
+    //the generation is read before the thread info, so a change that races with this
+    //refresh is picked up by the next event
+    const UINT64 generation = *captureGeneration;
+    PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+
+    PIXEventsThreadInfoCache::generation = generation;
+    PIXEventsThreadInfoCache::threadInfo = threadInfo;
+    return threadInfo;
+}
+
+inline PIXEventsThreadInfo* PIXGetCachedThreadInfo()
+{
+    PIXEventsThreadInfo* threadInfo = PIXEventsThreadInfoCache::threadInfo;
+    const volatile UINT64* captureGeneration = PIXEventsThreadInfoCache::captureGeneration;
+    if (threadInfo && *captureGeneration == PIXEventsThreadInfoCache::generation && !*PIXEventsThreadInfoCache::threadExited)
+    {
+        return threadInfo;
+    }
+    return PIXRefreshThreadInfoCache();
+}
+
+#else
+
+inline PIXEventsThreadInfo* PIXGetCachedThreadInfo()
+{
+    return PIXGetThreadInfo();
+}
+
+#endif // PIX_ENABLE_THREAD_INFO_CACHE
 
 #define PIX_EVENT_METADATA_NONE                     0x0
 #define PIX_EVENT_METADATA_ON_CONTEXT               0x1
 #define PIX_EVENT_METADATA_STRING_IS_ANSI           0x2
+#define PIX_EVENT_METADATA_STRING_IS_SHORTCUT       0x4
 #define PIX_EVENT_METADATA_HAS_COLOR                0xF0
 
+#include <type_traits>
+
+//
+// Scalar event arguments are widened to a qword the same way they would be
+// when passed to a varargs function, so that the decoder can hand them to
+// the printf family as they are: signed integers are sign extended, unsigned
+// integers, bool and pointers are zero extended and floating point values are
+// promoted to double. Enums are written as their underlying type. The choice
+// is made at compile time and every scalar is written with a single store.
+//
+
+template<class T, class Enable = void>
+struct PIXEventArgumentWriter
+{
+    //not a scalar, the bytes are copied into a cleared qword
+    static void Write(_Out_writes_(1) UINT64* destination, T const& argument)
+    {
+        *destination = 0ull;
+        *reinterpret_cast<T*>(destination) = argument;
+    }
+};
+
+template<class T>
+struct PIXEventArgumentWriter<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type>
+{
+    static void Write(_Out_writes_(1) UINT64* destination, T argument)
+    {
+        *reinterpret_cast<INT64*>(destination) = static_cast<INT64>(argument);
+    }
+};
+
+template<class T>
+struct PIXEventArgumentWriter<T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type>
+{
+    static void Write(_Out_writes_(1) UINT64* destination, T argument)
+    {
+        *destination = static_cast<UINT64>(argument);
+    }
+};
+
+template<class T>
+struct PIXEventArgumentWriter<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+    static void Write(_Out_writes_(1) UINT64* destination, T argument)
+    {
+        *reinterpret_cast<double*>(destination) = static_cast<double>(argument);
+    }
+};
+
+template<class T>
+struct PIXEventArgumentWriter<T, typename std::enable_if<std::is_enum<T>::value>::type>
+{
+    typedef typename std::underlying_type<T>::type UnderlyingType;
+
+    static void Write(_Out_writes_(1) UINT64* destination, T argument)
+    {
+        PIXEventArgumentWriter<UnderlyingType>::Write(destination, static_cast<UnderlyingType>(argument));
+    }
+};
+
+template<class T>
+struct PIXEventArgumentWriter<T, typename std::enable_if<std::is_pointer<T>::value || std::is_null_pointer<T>::value>::type>
+{
+    static void Write(_Out_writes_(1) UINT64* destination, T argument)
+    {
+        *destination = static_cast<UINT64>(reinterpret_cast<UINT_PTR>(argument));
+    }
+};
+
 #ifndef PIX_GAMING_XBOX
 #include "PIXEventsLegacy.h"
 #endif
@@ -74,13 +310,14 @@ enum PIXEventType : UINT8
     PIXEvent_EndEvent       = 0x00,
     PIXEvent_BeginEvent     = 0x01,
     PIXEvent_SetMarker      = 0x02,
+    PIXEvent_InternString   = 0x03,
 };
 
 static const UINT64 PIXEventsReservedRecordSpaceQwords = 64;
-//this is used to make sure SSE string copy always will end 16-byte write in the current block
+//this is used to make sure SSE/NEON string copy always will end 16-byte write in the current block
 //this way only a check if destination < limit can be performed, instead of destination < limit - 1
-//since both these are UINT64* and SSE writes in 16 byte chunks, 8 bytes are kept in reserve
-//so even if SSE overwrites 8-15 extra bytes, those will still belong to the correct block
+//since both these are UINT64* and SSE/NEON writes in 16 byte chunks, 8 bytes are kept in reserve
+//so even if SSE/NEON overwrites 8-15 extra bytes, those will still belong to the correct block
 //on next iteration check destination will be greater than limit
 //this is used as well for fixed size UMD events and PIXEndEvent since these require less space
 //than other variable length user events and do not need big reserved space
@@ -91,6 +328,24 @@ static const UINT64 PIXEventsGraphicsRecordSpaceQwords = 64;
 //Bits 7-19 (13 bits)
 static const UINT64 PIXEventsBlockEndMarker     = 0x00000000000FFF80;
 
+// An event is published by storing the new destination in the thread info
+// once the event, and the end marker after it, have been written. The runtime
+// can copy the published events out of a block while the thread is still
+// writing to it, so the compiler mustn't move an event's stores after the
+// store that publishes it. This doesn't emit any instructions.
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+inline void PIXEventsPublishBarrier()
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
 
 // V2 events
 
@@ -115,7 +370,7 @@ static const UINT64 PIXEventsTimestampWriteMask = 0x00000FFFFFFFFFFF;
 static const UINT64 PIXEventsTimestampBitShift  = 20;
 static const UINT64 PIXEventsTimestampReadMask  = PIXEventsTimestampWriteMask << PIXEventsTimestampBitShift;
 
-inline UINT64 PIXEncodeEventInfo(UINT64 timestamp, PIXEventType eventType, UINT8 eventSize, UINT8 eventMetadata)
+constexpr UINT64 PIXEncodeEventInfo(UINT64 timestamp, PIXEventType eventType, UINT8 eventSize, UINT8 eventMetadata)
 {
     return
         ((timestamp & PIXEventsTimestampWriteMask) << PIXEventsTimestampBitShift) |
@@ -150,6 +405,11 @@ static const UINT64 PIXEventsStringIsShortcutWriteMask    = 0x0000000000000001;
 static const UINT64 PIXEventsStringIsShortcutReadMask     = 0x0020000000000000;
 static const UINT64 PIXEventsStringIsShortcutBitShift     = 53;
 
+//Bits 0-52 (53) - only used when the shortcut bit is set, the id of an interned string
+static const UINT64 PIXEventsStringShortcutIdWriteMask    = 0x001FFFFFFFFFFFFF;
+static const UINT64 PIXEventsStringShortcutIdReadMask     = 0x001FFFFFFFFFFFFF;
+static const UINT64 PIXEventsStringShortcutIdBitShift     = 0;
+
 inline void PIXEncodeStringInfo(UINT64*& destination, BOOL isANSI)
 {
     const UINT64 encodedStringInfo = 
@@ -165,106 +425,13 @@ inline bool PIXIsPointerAligned(T* pointer)
     return !(((UINT64)pointer) & (alignment - 1));
 }
 
-// Generic template version slower because of the additional clear write
+//arguments are written as a single qword, see PIXEventArgumentWriter
 template<class T>
 inline void PIXCopyEventArgument(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, T argument)
 {
     if (destination < limit)
     {
-        *destination = 0ull;
-        *((T*)destination) = argument;
-        ++destination;
-    }
-}
-
-// int32 specialization to avoid slower double memory writes
-template<>
-inline void PIXCopyEventArgument<INT32>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, INT32 argument)
-{
-    if (destination < limit)
-    {
-        *reinterpret_cast<INT64*>(destination) = static_cast<INT64>(argument);
-        ++destination;
-    }
-}
-
-// unsigned int32 specialization to avoid slower double memory writes
-template<>
-inline void PIXCopyEventArgument<UINT32>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, UINT32 argument)
-{
-    if (destination < limit)
-    {
-        *destination = static_cast<UINT64>(argument);
-        ++destination;
-    }
-}
-
-// int64 specialization to avoid slower double memory writes
-template<>
-inline void PIXCopyEventArgument<INT64>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, INT64 argument)
-{
-    if (destination < limit)
-    {
-        *reinterpret_cast<INT64*>(destination) = argument;
-        ++destination;
-    }
-}
-
-// unsigned int64 specialization to avoid slower double memory writes
-template<>
-inline void PIXCopyEventArgument<UINT64>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, UINT64 argument)
-{
-    if (destination < limit)
-    {
-        *destination = argument;
-        ++destination;
-    }
-}
-
-//floats must be cast to double during writing the data to be properly printed later when reading the data
-//this is needed because when float is passed to varargs function it's cast to double
-template<>
-inline void PIXCopyEventArgument<float>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, float argument)
-{
-    if (destination < limit)
-    {
-        *reinterpret_cast<double*>(destination) = static_cast<double>(argument);
-        ++destination;
-    }
-}
-
-//char has to be cast to a longer signed integer type
-//this is due to printf not ignoring correctly the upper bits of unsigned long long for a char format specifier
-template<>
-inline void PIXCopyEventArgument<char>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, char argument)
-{
-    if (destination < limit)
-    {
-        *reinterpret_cast<INT64*>(destination) = static_cast<INT64>(argument);
-        ++destination;
-    }
-}
-
-//UINT8 has to be cast to a longer unsigned integer type
-//this is due to printf not ignoring correctly the upper bits of unsigned long long for a char format specifier
-template<>
-inline void PIXCopyEventArgument<UINT8>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, UINT8 argument)
-{
-    if (destination < limit)
-    {
-        *destination = static_cast<UINT64>(argument);
-        ++destination;
-    }
-}
-
-//bool has to be cast to an integer since it's not explicitly supported by string format routines
-//there's no format specifier for bool type, but it should work with integer format specifiers
-template<>
-inline void PIXCopyEventArgument<bool>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, bool argument)
-{
-    if (destination < limit)
-    {
-        *destination = static_cast<UINT64>(argument);
+        PIXEventArgumentWriter<T>::Write(destination, argument);
         ++destination;
     }
 }
@@ -347,25 +514,107 @@ inline void PIXCopyEventArgumentSlow<false>(_Out_writes_to_ptr_(limit) UINT64*&
     PIXCopyEventStringArgumentSlow(destination, limit, argument);
 }
 
-#if (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
+#if PIX_ENABLE_BLOCK_ARGUMENT_COPY
 
-inline void PIXCopyEventStringArgumentFast(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, _In_ PCSTR argument)
+//the fast copy reads the source a block (16 or 8 bytes) at a time regardless of its alignment
+//a block read is only issued if it stays within the page holding the first byte
+//so the copy never touches a page the string doesn't occupy (eg. a guard page)
+//near the end of a page the next 8 bytes are copied one character at a time instead
+static const UINT64 PIXEventsPageSize = 0x1000;
+
+#if defined(PIX_BLOCK_ARGUMENT_COPY_SSE2) || defined(PIX_BLOCK_ARGUMENT_COPY_NEON)
+static const UINT PIXEventsStringBlockCopyBytes = 16;
+#else
+static const UINT PIXEventsStringBlockCopyBytes = sizeof(UINT64);
+#endif
+
+template<UINT size, class T>
+inline bool PIXIsReadWithinPage(T* pointer)
+{
+    return (((UINT64)pointer) & (PIXEventsPageSize - 1)) <= (PIXEventsPageSize - size);
+}
+
+//copies up to one qword of characters, returns true if the terminating zero was copied
+inline bool PIXCopyEventStringQwordSlow(_Out_writes_(1) UINT64*& destination, _In_ PCSTR argument)
 {
+    UINT64 x = 0;
+    for (UINT i = 0; i < sizeof(UINT64); ++i)
+    {
+        const UINT64 c = static_cast<UINT8>(argument[i]);
+        if (!c)
+        {
+            *destination++ = x;
+            return true;
+        }
+        x |= c << (i * 8);
+    }
+    *destination++ = x;
+    return false;
+}
+
+//copies PIXEventsStringBlockCopyBytes of characters, returns true if the terminating zero was copied
+//destination is only advanced past the qword holding the terminating zero
+//destination is only 8-byte aligned, a 16 byte write is covered by PIXEventsReservedTailSpaceQwords
+inline bool PIXCopyEventStringBlock(_Out_writes_(2) UINT64*& destination, _In_ PCSTR argument)
+{
+#if defined(PIX_BLOCK_ARGUMENT_COPY_SSE2)
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(argument));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), chunk);
+
+    const unsigned long terminators = static_cast<unsigned long>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_setzero_si128())));
+    if (terminators)
+    {
+        unsigned long index;
+        _BitScanForward(&index, terminators);
+        destination += index / sizeof(UINT64) + 1;
+        return true;
+    }
+    destination += 2;
+    return false;
+#elif defined(PIX_BLOCK_ARGUMENT_COPY_NEON)
+    const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(argument));
+    vst1q_u8(reinterpret_cast<uint8_t*>(destination), chunk);
+
+    const uint64x2_t terminators = vreinterpretq_u64_u8(vceqq_u8(chunk, vdupq_n_u8(0)));
+    if (vgetq_lane_u64(terminators, 0))
+    {
+        destination += 1;
+        return true;
+    }
+    destination += 2;
+    return vgetq_lane_u64(terminators, 1) != 0;
+#else
+    //memcpy keeps the unaligned read well defined, it compiles down to a single load
+    UINT64 qword;
+    memcpy(&qword, argument, sizeof(qword));
+    *destination++ = qword;
+
+    //check if any of the characters is a terminating zero
     constexpr UINT64 mask1 = 0x0101010101010101ULL;
     constexpr UINT64 mask2 = 0x8080808080808080ULL;
-    UINT64* source = (UINT64*)argument;
+    return ((qword - mask1) & (~qword & mask2)) != 0;
+#endif
+}
 
+inline void PIXCopyEventStringArgumentFast(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, _In_ PCSTR argument)
+{
     while (destination < limit)
     {
-        UINT64 qword = *source++;
-        *destination++ = qword;
-
-        //check if any of the characters is a terminating zero
-        UINT64 isTerminated = (qword - mask1) & (~qword & mask2);
-
-        if (isTerminated)
+        if (PIXIsReadWithinPage<PIXEventsStringBlockCopyBytes>(argument))
+        {
+            if (PIXCopyEventStringBlock(destination, argument))
+            {
+                return;
+            }
+            argument += PIXEventsStringBlockCopyBytes;
+        }
+        else
         {
-            break;
+            if (PIXCopyEventStringQwordSlow(destination, argument))
+            {
+                return;
+            }
+            argument += sizeof(UINT64);
         }
     }
 }
@@ -378,17 +627,12 @@ inline void PIXCopyEventArgument<PCSTR>(_Out_writes_to_ptr_(limit) UINT64*& dest
     {
         if (argument != nullptr)
         {
-#if (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
-            if (PIXIsPointerAligned<8>(argument))
-            {
-                PIXEncodeStringInfo(destination, TRUE);
-                PIXCopyEventStringArgumentFast(destination, limit, argument);
-            }
-            else
-#endif // (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
-            {
-                PIXCopyEventArgumentSlow<true>(destination, limit, argument);
-            }
+#if PIX_ENABLE_BLOCK_ARGUMENT_COPY
+            PIXEncodeStringInfo(destination, TRUE);
+            PIXCopyEventStringArgumentFast(destination, limit, argument);
+#else
+            PIXCopyEventArgumentSlow<true>(destination, limit, argument);
+#endif // PIX_ENABLE_BLOCK_ARGUMENT_COPY
         }
         else
         {
@@ -401,16 +645,11 @@ inline void PIXCopyStringArgument(_Out_writes_to_ptr_(limit) UINT64*& destinatio
 {
     if (argument != nullptr)
     {
-#if (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
-        if (PIXIsPointerAligned<8>(argument))
-        {
-            PIXCopyEventStringArgumentFast(destination, limit, argument);
-        }
-        else
-#endif // (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
-        {
-            PIXCopyEventArgumentSlow<false>(destination, limit, argument);
-        }
+#if PIX_ENABLE_BLOCK_ARGUMENT_COPY
+        PIXCopyEventStringArgumentFast(destination, limit, argument);
+#else
+        PIXCopyEventArgumentSlow<false>(destination, limit, argument);
+#endif // PIX_ENABLE_BLOCK_ARGUMENT_COPY
     }
     else
     {
@@ -479,22 +718,86 @@ inline void PIXCopyEventArgumentSlow<false>(_Out_writes_to_ptr_(limit) UINT64*&
     PIXCopyEventStringArgumentSlow(destination, limit, argument);
 }
 
-#if (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
+#if PIX_ENABLE_BLOCK_ARGUMENT_COPY
+//copies up to one qword of characters, returns true if the terminating zero was copied
+inline bool PIXCopyEventStringQwordSlow(_Out_writes_(1) UINT64*& destination, _In_ PCWSTR argument)
+{
+    UINT64 x = 0;
+    for (UINT i = 0; i < sizeof(UINT64) / sizeof(WCHAR); ++i)
+    {
+        const UINT64 c = static_cast<UINT16>(argument[i]);
+        if (!c)
+        {
+            *destination++ = x;
+            return true;
+        }
+        x |= c << (i * 16);
+    }
+    *destination++ = x;
+    return false;
+}
+
+//the 16-bit lanes line up with the characters since the read starts at the string itself,
+//even when the string isn't 2-byte aligned
+inline bool PIXCopyEventStringBlock(_Out_writes_(2) UINT64*& destination, _In_ PCWSTR argument)
+{
+#if defined(PIX_BLOCK_ARGUMENT_COPY_SSE2)
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(argument));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), chunk);
+
+    const unsigned long terminators = static_cast<unsigned long>(_mm_movemask_epi8(_mm_cmpeq_epi16(chunk, _mm_setzero_si128())));
+    if (terminators)
+    {
+        unsigned long index;
+        _BitScanForward(&index, terminators);
+        destination += index / sizeof(UINT64) + 1;
+        return true;
+    }
+    destination += 2;
+    return false;
+#elif defined(PIX_BLOCK_ARGUMENT_COPY_NEON)
+    const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(argument));
+    vst1q_u8(reinterpret_cast<uint8_t*>(destination), chunk);
+
+    const uint64x2_t terminators = vreinterpretq_u64_u16(vceqq_u16(vreinterpretq_u16_u8(chunk), vdupq_n_u16(0)));
+    if (vgetq_lane_u64(terminators, 0))
+    {
+        destination += 1;
+        return true;
+    }
+    destination += 2;
+    return vgetq_lane_u64(terminators, 1) != 0;
+#else
+    UINT64 qword;
+    memcpy(&qword, argument, sizeof(qword));
+    *destination++ = qword;
+
+    //check if any of the characters is a terminating zero
+    constexpr UINT64 mask1 = 0x0001000100010001ULL;
+    constexpr UINT64 mask2 = 0x8000800080008000ULL;
+    return ((qword - mask1) & (~qword & mask2)) != 0;
+#endif
+}
+
 inline void PIXCopyEventStringArgumentFast(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, _In_ PCWSTR argument)
 {
-    UINT64* source = (UINT64*)argument;
     while (destination < limit)
     {
-        UINT64 qword = *source++;
-        *destination++ = qword;
-        //check if any of the characters is a terminating zero
-        //TODO: check if reversed condition is faster
-        if (!((qword & 0xFFFF000000000000) &&
-            (qword & 0xFFFF00000000) &&
-            (qword & 0xFFFF0000) &&
-            (qword & 0xFFFF)))
+        if (PIXIsReadWithinPage<PIXEventsStringBlockCopyBytes>(argument))
         {
-            break;
+            if (PIXCopyEventStringBlock(destination, argument))
+            {
+                return;
+            }
+            argument += PIXEventsStringBlockCopyBytes / sizeof(WCHAR);
+        }
+        else
+        {
+            if (PIXCopyEventStringQwordSlow(destination, argument))
+            {
+                return;
+            }
+            argument += sizeof(UINT64) / sizeof(WCHAR);
         }
     }
 }
@@ -507,17 +810,12 @@ inline void PIXCopyEventArgument<PCWSTR>(_Out_writes_to_ptr_(limit) UINT64*& des
     {
         if (argument != nullptr)
         {
-#if (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
-            if (PIXIsPointerAligned<8>(argument))
-            {
-                PIXEncodeStringInfo(destination, FALSE);
-                PIXCopyEventStringArgumentFast(destination, limit, argument);
-            }
-            else
-#endif // (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
-            {
-                PIXCopyEventArgumentSlow<true>(destination, limit, argument);
-            }
+#if PIX_ENABLE_BLOCK_ARGUMENT_COPY
+            PIXEncodeStringInfo(destination, FALSE);
+            PIXCopyEventStringArgumentFast(destination, limit, argument);
+#else
+            PIXCopyEventArgumentSlow<true>(destination, limit, argument);
+#endif // PIX_ENABLE_BLOCK_ARGUMENT_COPY
         }
         else
         {
@@ -530,16 +828,11 @@ inline void PIXCopyStringArgument(_Out_writes_to_ptr_(limit) UINT64*& destinatio
 {
     if (argument != nullptr)
     {
-#if (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
-        if (PIXIsPointerAligned<8>(argument))
-        {
-            PIXCopyEventStringArgumentFast(destination, limit, argument);
-        }
-        else
-#endif // (defined(_M_X64) || defined(_M_IX86)) && PIX_ENABLE_BLOCK_ARGUMENT_COPY
-        {
-            PIXCopyEventArgumentSlow<false>(destination, limit, argument);
-        }
+#if PIX_ENABLE_BLOCK_ARGUMENT_COPY
+        PIXCopyEventStringArgumentFast(destination, limit, argument);
+#else
+        PIXCopyEventArgumentSlow<false>(destination, limit, argument);
+#endif // PIX_ENABLE_BLOCK_ARGUMENT_COPY
     }
     else
     {
@@ -558,6 +851,170 @@ inline void PIXCopyStringArgument(_Out_writes_to_ptr_(limit) UINT64*& destinatio
     PIXCopyStringArgument(destination, limit, (PCWSTR)argument);
 };
 
+#if PIX_ENABLE_STRING_INTERNING
+
+//an interned string is written as a single qword: a string info with the shortcut bit set and
+//the id of the string in the otherwise unused bits. The id is a hash of the characters, so the
+//same literal gets the same shortcut in every module and every run.
+//the runtime is told about each string the first time it is used, it then writes the string
+//table (PIXEvent_InternString records) into the capture so the decoder can resolve shortcuts
+template<class T>
+constexpr UINT64 PIXHashInternedString(const T* string)
+{
+    //FNV-1a over the bytes of each character
+    UINT64 hash = 0xcbf29ce484222325ull;
+    for (; *string; ++string)
+    {
+        const UINT64 c = static_cast<UINT64>(*string);
+        for (UINT i = 0; i < sizeof(T); ++i)
+        {
+            hash ^= (c >> (i * 8)) & 0xFF;
+            hash *= 0x00000100000001B3ull;
+        }
+    }
+    return hash;
+}
+
+template<class T>
+constexpr UINT64 PIXEncodeStringShortcut(const T* string)
+{
+    return
+        ((sizeof(UINT64) & PIXEventsStringCopyChunkSizeWriteMask) << PIXEventsStringCopyChunkSizeBitShift) |
+        (((UINT64)(sizeof(T) == sizeof(char)) & PIXEventsStringIsANSIWriteMask) << PIXEventsStringIsANSIBitShift) |
+        ((1ull & PIXEventsStringIsShortcutWriteMask) << PIXEventsStringIsShortcutBitShift) |
+        ((PIXHashInternedString(string) & PIXEventsStringShortcutIdWriteMask) << PIXEventsStringShortcutIdBitShift);
+}
+
+template<class T>
+struct PIXInternedString
+{
+    const T* string;
+    UINT64 shortcut;
+    volatile bool* isRegistered;
+};
+
+//one flag per distinct string, shared by every use of that string in this module
+template<UINT64 shortcut>
+struct PIXInternedStringRegistration
+{
+    static inline volatile bool isRegistered = false;
+};
+
+template<UINT64 shortcut, class T>
+inline PIXInternedString<T> PIXMakeInternedString(const T* string)
+{
+    return { string, shortcut, &PIXInternedStringRegistration<shortcut>::isRegistered };
+}
+
+template<class T>
+__declspec(noinline) void PIXRegisterInternedString(PIXInternedString<T> const& argument)
+{
+    PIXEventsRegisterInternedString(argument.shortcut, argument.string);
+    *argument.isRegistered = true;
+}
+
+template<class T>
+inline void PIXCopyEventArgument(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, PIXInternedString<T> argument)
+{
+    if (destination < limit)
+    {
+        if (!*argument.isRegistered)
+        {
+            PIXRegisterInternedString(argument);
+        }
+        *destination++ = argument.shortcut;
+    }
+}
+
+template<class T>
+inline void PIXCopyStringArgument(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, PIXInternedString<T> argument)
+{
+    UNREFERENCED_PARAMETER(limit);
+
+    if (!*argument.isRegistered)
+    {
+        PIXRegisterInternedString(argument);
+    }
+    *destination++ = argument.shortcut;
+}
+
+#endif // PIX_ENABLE_STRING_INTERNING
+
+#if PIX_ENABLE_SIZED_STRING_ARGUMENTS
+
+//copies exactly length characters and then writes the terminator and the zero padding,
+//giving the same layout as copying a null terminated string. Like the other string copies,
+//a string that doesn't fit before limit is truncated without a terminator
+template<class T>
+inline void PIXCopyEventStringArgumentSized(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, _In_reads_(length) const T* argument, size_t length)
+{
+    const size_t bytes = length * sizeof(T);
+    const size_t qwords = (bytes + sizeof(T) + sizeof(UINT64) - 1) / sizeof(UINT64);
+    const size_t available = static_cast<size_t>(limit - destination);
+
+    if (qwords <= available)
+    {
+        destination[qwords - 1] = 0ull;
+        memcpy(destination, argument, bytes);
+        destination += qwords;
+    }
+    else
+    {
+        memcpy(destination, argument, available * sizeof(UINT64));
+        destination += available;
+    }
+}
+
+template<class T, class Traits>
+inline void PIXCopyEventArgument(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, std::basic_string_view<T, Traits> argument)
+{
+    static_assert(sizeof(T) == sizeof(char) || sizeof(T) == sizeof(wchar_t), "only char and wchar_t strings can be decoded");
+
+    if (destination < limit)
+    {
+        PIXEncodeStringInfo(destination, sizeof(T) == sizeof(char));
+        PIXCopyEventStringArgumentSized(destination, limit, argument.data(), argument.size());
+    }
+}
+
+template<class T, class Traits, class Allocator>
+inline void PIXCopyEventArgument(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, std::basic_string<T, Traits, Allocator> const& argument)
+{
+    PIXCopyEventArgument(destination, limit, std::basic_string_view<T, Traits>(argument));
+}
+
+#endif // PIX_ENABLE_SIZED_STRING_ARGUMENTS
+
+#if PIX_ENABLE_ENCODED_LITERALS
+
+//a literal format string encoded at compile time exactly as PIXCopyStringArgument writes it:
+//the characters, including the terminator, packed into qwords and zero padded.
+//this assumes a little endian target, as the rest of the event encoding does
+template<class T, size_t N>
+struct PIXEncodedLiteral
+{
+    static constexpr UINT QwordCount = static_cast<UINT>((N * sizeof(T) + sizeof(UINT64) - 1) / sizeof(UINT64));
+    static constexpr UINT8 Metadata = sizeof(T) == sizeof(char) ? PIX_EVENT_METADATA_STRING_IS_ANSI : PIX_EVENT_METADATA_NONE;
+
+    const T* string;
+    UINT64 qwords[QwordCount];
+
+    constexpr PIXEncodedLiteral(const T (&literal)[N])
+        : string(literal)
+        , qwords{}
+    {
+        constexpr UINT64 characterMask = (1ull << (sizeof(T) * 8)) - 1;
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            const size_t byteOffset = i * sizeof(T);
+            qwords[byteOffset / sizeof(UINT64)] |= (static_cast<UINT64>(literal[i]) & characterMask) << ((byteOffset % sizeof(UINT64)) * 8);
+        }
+    }
+};
+
+#endif // PIX_ENABLE_ENCODED_LITERALS
+
 #if defined(__d3d12_x_h__) || defined(__d3d12_xs_h__) || defined(__d3d12_h__)
 
 inline void PIXSetGPUMarkerOnContext(_In_ ID3D12GraphicsCommandList* commandList, _In_reads_bytes_(size) void* data, UINT size)
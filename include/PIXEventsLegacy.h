@@ -88,106 +88,13 @@ namespace PixEventsLegacy
         return !(((UINT64)pointer) & (alignment - 1));
     }
 
-    // Generic template version slower because of the additional clear write
+    //arguments are written as a single qword, see PIXEventArgumentWriter
     template<class T>
     inline void PIXCopyEventArgument(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, T argument)
     {
         if (destination < limit)
         {
-            *destination = 0ull;
-            *((T*)destination) = argument;
-            ++destination;
-        }
-    }
-
-    // int32 specialization to avoid slower double memory writes
-    template<>
-    inline void PIXCopyEventArgument<INT32>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, INT32 argument)
-    {
-        if (destination < limit)
-        {
-            *reinterpret_cast<INT64*>(destination) = static_cast<INT64>(argument);
-            ++destination;
-        }
-    }
-
-    // unsigned int32 specialization to avoid slower double memory writes
-    template<>
-    inline void PIXCopyEventArgument<UINT32>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, UINT32 argument)
-    {
-        if (destination < limit)
-        {
-            *destination = static_cast<UINT64>(argument);
-            ++destination;
-        }
-    }
-
-    // int64 specialization to avoid slower double memory writes
-    template<>
-    inline void PIXCopyEventArgument<INT64>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, INT64 argument)
-    {
-        if (destination < limit)
-        {
-            *reinterpret_cast<INT64*>(destination) = argument;
-            ++destination;
-        }
-    }
-
-    // unsigned int64 specialization to avoid slower double memory writes
-    template<>
-    inline void PIXCopyEventArgument<UINT64>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, UINT64 argument)
-    {
-        if (destination < limit)
-        {
-            *destination = argument;
-            ++destination;
-        }
-    }
-
-    //floats must be cast to double during writing the data to be properly printed later when reading the data
-    //this is needed because when float is passed to varargs function it's cast to double
-    template<>
-    inline void PIXCopyEventArgument<float>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, float argument)
-    {
-        if (destination < limit)
-        {
-            *reinterpret_cast<double*>(destination) = static_cast<double>(argument);
-            ++destination;
-        }
-    }
-
-    //char has to be cast to a longer signed integer type
-    //this is due to printf not ignoring correctly the upper bits of unsigned long long for a char format specifier
-    template<>
-    inline void PIXCopyEventArgument<char>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, char argument)
-    {
-        if (destination < limit)
-        {
-            *reinterpret_cast<INT64*>(destination) = static_cast<INT64>(argument);
-            ++destination;
-        }
-    }
-
-    //unsigned char has to be cast to a longer unsigned integer type
-    //this is due to printf not ignoring correctly the upper bits of unsigned long long for a char format specifier
-    template<>
-    inline void PIXCopyEventArgument<unsigned char>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, unsigned char argument)
-    {
-        if (destination < limit)
-        {
-            *destination = static_cast<UINT64>(argument);
-            ++destination;
-        }
-    }
-
-    //bool has to be cast to an integer since it's not explicitly supported by string format routines
-    //there's no format specifier for bool type, but it should work with integer format specifiers
-    template<>
-    inline void PIXCopyEventArgument<bool>(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, bool argument)
-    {
-        if (destination < limit)
-        {
-            *destination = static_cast<UINT64>(argument);
+            PIXEventArgumentWriter<T>::Write(destination, argument);
             ++destination;
         }
     }
@@ -471,6 +378,46 @@ namespace PixEventsLegacy
         }
     }
 
+#if PIX_ENABLE_SIZED_STRING_ARGUMENTS
+    template<class T>
+    inline void PIXCopyEventStringArgumentSized(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, _In_reads_(length) const T* argument, size_t length)
+    {
+        const size_t bytes = length * sizeof(T);
+        const size_t qwords = (bytes + sizeof(T) + sizeof(UINT64) - 1) / sizeof(UINT64);
+        const size_t available = static_cast<size_t>(limit - destination);
+
+        if (qwords <= available)
+        {
+            destination[qwords - 1] = 0ull;
+            memcpy(destination, argument, bytes);
+            destination += qwords;
+        }
+        else
+        {
+            memcpy(destination, argument, available * sizeof(UINT64));
+            destination += available;
+        }
+    }
+
+    template<class T, class Traits>
+    inline void PIXCopyEventArgument(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, std::basic_string_view<T, Traits> argument)
+    {
+        static_assert(sizeof(T) == sizeof(char) || sizeof(T) == sizeof(wchar_t), "only char and wchar_t strings can be decoded");
+
+        if (destination < limit)
+        {
+            *destination++ = PIXEncodeStringInfo(0, 8, sizeof(T) == sizeof(char), FALSE);
+            PIXCopyEventStringArgumentSized(destination, limit, argument.data(), argument.size());
+        }
+    }
+
+    template<class T, class Traits, class Allocator>
+    inline void PIXCopyEventArgument(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit, std::basic_string<T, Traits, Allocator> const& argument)
+    {
+        PIXCopyEventArgument(destination, limit, std::basic_string_view<T, Traits>(argument));
+    }
+#endif // PIX_ENABLE_SIZED_STRING_ARGUMENTS
+
     inline void PIXCopyEventArguments(_Out_writes_to_ptr_(limit) UINT64*& destination, _In_ const UINT64* limit)
     {
         // nothing
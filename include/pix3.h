@@ -42,6 +42,12 @@
 #define PIX_CAPTURE_GPU_TRACE               (1 << 9)
 #define PIX_CAPTURE_RESERVED                (1 << 15)
 
+// Pass this to PIXSetEventBlockSize to let each thread's block size follow how quickly it fills blocks
+#define PIX_EVENT_BLOCK_SIZE_ADAPTIVE 0
+
+// Pass this to PIXSetWorkerNumaNode to let the runtime's worker thread run on any processor
+#define PIX_NUMA_NODE_ANY 0xFFFFFFFF
+
 union PIXCaptureParameters
 {
     enum PIXCaptureStorage
@@ -90,6 +96,44 @@ union PIXCaptureParameters
 
 typedef PIXCaptureParameters* PPIXCaptureParameters;
 
+// Filled in by PIXGetRuntimeStatistics. The counts are totals since the runtime was loaded, except
+// for Threads and QueuedBlocks which are current values.
+struct PIXRuntimeStatistics
+{
+    UINT64 Threads;             // Threads that have recorded events and not yet exited
+    UINT64 Events;              // CPU events written out
+    UINT64 BlocksWritten;
+    UINT64 BytesRecorded;       // Bytes of events that threads have recorded
+    UINT64 BytesWritten;        // Bytes written to ETW or the capture file, after compression
+    UINT64 Writes;              // Number of writes those bytes took
+    UINT64 BlockReplacements;   // Event blocks that threads have started
+    UINT64 AllocationFailures;  // Times a thread couldn't get a new block, and dropped events
+    UINT64 QueuedBlocks;        // Blocks waiting for the runtime's worker thread to write them
+    UINT64 MaxQueuedBlocks;     // The most that have been waiting at once
+    UINT64 OverflowBlocks;      // Blocks handed over while the worker thread's queue was full
+    UINT64 DroppedBlocks;       // Blocks that the flight recorder discarded to make room
+};
+
+// The operations that PIXGetRuntimeLatency reports on
+#define PIX_RUNTIME_LATENCY_REPLACE_BLOCK 0 // A thread starting a new block of events, including the ones below
+#define PIX_RUNTIME_LATENCY_HANDOFF 1       // A thread handing a full block to the runtime's worker thread
+#define PIX_RUNTIME_LATENCY_QUEUE 2         // Queueing a block for the worker thread, part of the handoff
+#define PIX_RUNTIME_LATENCY_ALLOCATE 3      // Getting a block to record events into
+#define PIX_RUNTIME_LATENCY_WRITE 4         // The worker thread writing blocks to ETW or the capture file
+
+// Filled in by PIXGetRuntimeLatency. Durations are in ticks of the processor's timestamp counter
+// (rdtsc on x64, the virtual counter on ARM64). Buckets[i] counts the calls that took from 2^i up to
+// 2^(i+1) ticks, and the percentiles are the upper bounds of the buckets that they fall in.
+struct PIXRuntimeLatency
+{
+    UINT64 Count;
+    UINT64 P50;
+    UINT64 P99;
+    UINT64 P999;
+    UINT64 Max;
+    UINT64 Buckets[64];
+};
+
 #if defined(XBOX) || defined(_XBOX_ONE) || defined(_DURANGO) || defined(_GAMING_XBOX) || defined(_GAMING_XBOX_SCARLETT)
 #include "pix3_xbox.h"
 #else
@@ -132,6 +176,66 @@ extern "C" DWORD WINAPI PIXGetCaptureState();
 
 extern "C" void WINAPI PIXReportCounter(_In_ PCWSTR name, float value);
 
+// Sets the size, in bytes, of the blocks that each thread records CPU events into. Larger blocks
+// mean fewer hand offs for busy threads, smaller blocks hold on to less memory for idle threads.
+// The size is rounded up to a power of two between 4kb and 32kb, the default is 16kb.
+// PIX_EVENT_BLOCK_SIZE_ADAPTIVE grows the blocks of threads that fill them quickly and shrinks
+// them for threads that are mostly idle. Threads pick up the new size when they start a new block.
+extern "C" void WINAPI PIXSetEventBlockSize(UINT32 blockSize);
+
+// Compresses blocks of CPU events before they are written out, trading some CPU time on the
+// runtime's worker thread for less ETW bandwidth. Off by default. Only sessions that enable the
+// PixEventBlockBatches keyword, and the capture file, get compressed blocks.
+extern "C" void WINAPI PIXSetEventBlockCompression(BOOL enable);
+
+// Records CPU events into memory made of large pages, so that many threads recording events
+// need fewer TLB entries between them. Memory is taken 2mb at a time and can't be paged out. Large
+// pages need the user to have been granted SeLockMemoryPrivilege; without it, or when the system
+// can't find enough contiguous memory, ordinary pages are used instead. Off by default.
+extern "C" void WINAPI PIXSetEventBlockLargePages(BOOL enable);
+
+// Makes sure CPU events are written out within about this many milliseconds of being recorded, for
+// tools that show them live. Threads that fill blocks slowly would otherwise hold on to their events
+// until the block fills up. The runtime's worker thread copies them out without holding the thread
+// up. Passing 0, the default, turns this off.
+extern "C" void WINAPI PIXSetMaxEventLatency(UINT32 milliseconds);
+
+// Reports what the runtime has been doing: how many events and bytes it has recorded and written,
+// how often threads needed new blocks, and how far its worker thread has fallen behind. Useful
+// for choosing block and flight recorder sizes, and for measuring the cost of recording events.
+extern "C" void WINAPI PIXGetRuntimeStatistics(_Out_ PIXRuntimeStatistics* statistics);
+
+// Records the statistics that PIXGetRuntimeStatistics reports into the capture about this often,
+// alongside the CPU events. ETW sessions get them as PIXRecordRuntimeStatistics events, under the
+// PixRuntimeStatistics keyword. Passing 0, the default, turns this off.
+extern "C" void WINAPI PIXSetStatisticsInterval(UINT32 milliseconds);
+
+// Keeps the runtime's worker thread, which writes out the blocks of CPU events, on the processors of
+// one NUMA node. Threads always record events into memory from their own node, so this helps when the
+// threads recording most of the events all run on that node. Passing PIX_NUMA_NODE_ANY, the default,
+// lets the worker thread run anywhere.
+extern "C" void WINAPI PIXSetWorkerNumaNode(UINT32 node);
+
+// Reports how long one of the PIX_RUNTIME_LATENCY_* operations has taken since the runtime was
+// loaded, which is time that the threads recording events lose to the runtime. Returns FALSE if
+// the runtime was built without latency histograms.
+extern "C" BOOL WINAPI PIXGetRuntimeLatency(UINT32 operation, _Out_ PIXRuntimeLatency* latency);
+
+// Turns on the flight recorder: CPU events are recorded even without a capture running, and the
+// most recent maxBytes worth of them are kept in memory. A capture that is running still gets
+// every event as it is recorded. Passing 0 turns it off and discards what it holds.
+extern "C" void WINAPI PIXSetFlightRecorderSize(UINT64 maxBytes);
+
+// Writes out the events held by the flight recorder, for example when a hitch is detected. An
+// ETW capture state request from a capture tool does the same.
+extern "C" void WINAPI PIXTriggerFlightRecorder();
+
+// Writes CPU events into fileName, as well as sending them through ETW, whether or not a capture is
+// running. The file is created with a size of fileSize bytes and used as a ring, so it holds the most
+// recent events. Writes go through a file mapping, so events that have been written survive the
+// process crashing. Passing nullptr closes the file.
+extern "C" HRESULT WINAPI PIXSetCaptureFile(_In_opt_ PCWSTR fileName, UINT64 fileSize);
+
 #endif // USE_PIX
 
 #endif // (USE_PIX_SUPPORTED_ARCHITECTURE) && (USE_PIX || USE_PIX_RETAIL)
@@ -152,6 +256,17 @@ inline HMODULE PIXLoadLatestWinPixGpuCapturerLibrary() { return nullptr; }
 inline HMODULE PIXLoadLatestWinPixTimingCapturerLibrary() { return nullptr; }
 inline DWORD PIXGetCaptureState() { return 0; }
 inline void PIXReportCounter(_In_ PCWSTR, float) {}
+inline void PIXSetEventBlockSize(UINT32) {}
+inline void PIXSetEventBlockCompression(BOOL) {}
+inline void PIXSetEventBlockLargePages(BOOL) {}
+inline void PIXSetMaxEventLatency(UINT32) {}
+inline void PIXGetRuntimeStatistics(_Out_ PIXRuntimeStatistics* statistics) { *statistics = {}; }
+inline void PIXSetStatisticsInterval(UINT32) {}
+inline void PIXSetWorkerNumaNode(UINT32) {}
+inline BOOL PIXGetRuntimeLatency(UINT32, _Out_ PIXRuntimeLatency* latency) { *latency = {}; return FALSE; }
+inline void PIXSetFlightRecorderSize(UINT64) {}
+inline void PIXTriggerFlightRecorder() {}
+inline HRESULT PIXSetCaptureFile(_In_opt_ PCWSTR, UINT64) { return S_OK; }
 inline void PIXNotifyWakeFromFenceSignal(_In_ HANDLE) {}
 
 #if !defined(USE_PIX_RETAIL)
@@ -192,4 +307,16 @@ inline UINT32 PIX_COLOR(UINT8 r, UINT8 g, UINT8 b) { return 0xff000000u | ((UINT
 inline UINT8 PIX_COLOR_INDEX(UINT8 i) { return i; }
 const UINT8 PIX_COLOR_DEFAULT = PIX_COLOR_INDEX(0);
 
+// Use PIX_INTERN() around a string literal passed to a PIX event/marker API to record it once per
+// capture and refer to it by an 8-byte id from then on. Without PIX, it is just the literal.
+#if !defined(PIX_INTERN)
+#define PIX_INTERN(string) string
+#endif
+
+// Use PIX_LITERAL() around a string literal passed to a PIX event/marker API without any other
+// arguments to have the event encoded at compile time. Without PIX, it is just the literal.
+#if !defined(PIX_LITERAL)
+#define PIX_LITERAL(string) string
+#endif
+
 #endif // _PIX3_H_
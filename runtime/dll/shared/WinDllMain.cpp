@@ -56,7 +56,13 @@ VOID NTAPI EtwEnableCallback(
         WinPixEventRuntime::DisableCapture();
         break;
     case EVENT_CONTROL_CODE_CAPTURE_STATE:  
-        WinPixEventRuntime::FlushCapture();
+        // With the flight recorder on this is what writes out its events
+        if (!WinPixEventRuntime::TriggerFlightRecorder())
+        {
+            // The worker writes the blocks out, so this doesn't hold up the
+            // ETW callback thread
+            WinPixEventRuntime::FlushCapture();
+        }
         break;
     }
 }
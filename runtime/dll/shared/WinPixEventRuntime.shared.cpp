@@ -9,6 +9,11 @@
 #include <lib/ThreadedWorker.h>
 #include <lib/WinPixEventRuntime.h>
 
+#include <shared/PEvtCompression.h>
+
+#include <memory>
+#include <new>
+
 //
 // These are in 'shared' rather than lib' because we want to be able to replace
 // them in the unit tests.
@@ -28,9 +33,138 @@ std::unique_ptr<WinPixEventRuntime::Worker> WinPixEventRuntime::CreateWorker() n
 }
 
 
+static std::atomic<uint32_t> g_eventId = 0u;
+
+
 void WinPixEventRuntime::WriteBlock(uint32_t numBytes, void* block) noexcept
 {
-    static std::atomic<uint32_t> eventId = 0u;
+    // The capture file, if there is one, and ETW both get the block
+    WinPixEventRuntime::WriteBlockToCaptureFile(numBytes, block);
+
+    EventWritePIXRecordTimingBlock_v2(g_eventId.fetch_add(1), numBytes, static_cast<BYTE*>(block));
+}
+
+
+void WinPixEventRuntime::WriteStatisticsBlock(uint32_t numBytes, void* block) noexcept
+{
+    WinPixEventRuntime::WriteBlockToCaptureFile(numBytes, block);
+
+    EventWritePIXRecordRuntimeStatistics(g_eventId.fetch_add(1), numBytes, static_cast<BYTE*>(block));
+}
+
+
+bool WinPixEventRuntime::AreBlockBatchesEnabled() noexcept
+{
+    // Sessions that ask for PIXRecordTimingBlocks get batches, and so does
+    // the capture file. Any session listening for PIXRecordTimingBlock_v2 at
+    // the same time still gets each block of the batches (see WriteBlocks).
+    return !EventEnabledPIXRecordTimingBlock_v2() || EventEnabledPIXRecordTimingBlocks();
+}
+
+
+// Writes a block as a PIXRecordTimingBlock_v2 event. Only PIXRecordTimingBlocks
+// carries compressed blocks, so they're decompressed first.
+static void WriteBlockV2(uint32_t numBytes, BYTE* block) noexcept
+{
+    auto header = reinterpret_cast<PEvtBlkHdr const*>(block);
+    if (header->BlockType != PIXEVT_CPU_BLOCK_COMPRESSED)
+    {
+        EventWritePIXRecordTimingBlock_v2(g_eventId.fetch_add(1), numBytes, block);
+        return;
+    }
+
+    constexpr uint32_t HeaderSize = sizeof(PEvtBlkHdr) + sizeof(PEvtCmpBlkHdr);
+    if (numBytes < HeaderSize)
+        return;
+
+    const uint32_t dataSize = reinterpret_cast<PEvtCmpBlkHdr const*>(header + 1)->DataSize;
+    const uint32_t blockSize = sizeof(PEvtBlkHdr) + dataSize;
+
+    std::unique_ptr<BYTE[]> decompressed(new (std::nothrow) BYTE[blockSize]);
+    if (!decompressed || !PEvtDecompress(block + HeaderSize, numBytes - HeaderSize, decompressed.get() + sizeof(PEvtBlkHdr), dataSize))
+        return;
+
+    auto decompressedHeader = reinterpret_cast<PEvtBlkHdr*>(decompressed.get());
+    memcpy(decompressedHeader, header, sizeof(PEvtBlkHdr));
+    decompressedHeader->BlockType = PIXEVT_CPU_BLOCK;
+    decompressedHeader->BlockSize = blockSize;
+
+    EventWritePIXRecordTimingBlock_v2(g_eventId.fetch_add(1), blockSize, decompressed.get());
+}
+
+
+// Calls write(numBytes, block) for each block in the spans.
+template<class Write>
+static void ForEachBlock(uint32_t count, WinPixEventRuntime::BlockSpan const* spans, Write&& write) noexcept
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto bytes = static_cast<BYTE*>(spans[i].Data);
+        uint32_t remaining = spans[i].NumBytes;
+        while (remaining >= sizeof(PEvtBlkHdr))
+        {
+            uint32_t blockSize = reinterpret_cast<PEvtBlkHdr const*>(bytes)->BlockSize;
+            if (blockSize < sizeof(PEvtBlkHdr) || blockSize > remaining)
+            {
+                blockSize = remaining;
+            }
+
+            write(blockSize, bytes);
+
+            bytes += blockSize;
+            remaining -= blockSize;
+        }
+    }
+}
+
+
+// PIXRecordTimingBlocks has the same layout as PIXRecordTimingBlock_v2, except
+// that the buffer holds one or more blocks back to back. It's described by one
+// data descriptor per span, so ETW gathers them into a single event and a
+// single kernel transition.
+static ULONG WriteTimingBlocksEvent(uint32_t count, WinPixEventRuntime::BlockSpan const* spans) noexcept
+{
+    EVENT_DATA_DESCRIPTOR descriptors[2 + WinPixEventRuntime::BlockAllocator::MaxSpansPerWrite];
+
+    const uint32_t eventId = g_eventId.fetch_add(1);
+    uint32_t numBytes = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        numBytes += spans[i].NumBytes;
+        EventDataDescCreate(&descriptors[2 + i], spans[i].Data, spans[i].NumBytes);
+    }
+
+    EventDataDescCreate(&descriptors[0], &eventId, sizeof(eventId));
+    EventDataDescCreate(&descriptors[1], &numBytes, sizeof(numBytes));
+
+    return EventWrite(PIX_ETW_PROVIDER_WINDOWSHandle, &PIXRecordTimingBlocks, 2 + count, descriptors);
+}
+
+
+void WinPixEventRuntime::WriteBlocks(uint32_t count, BlockSpan const* spans) noexcept
+{
+    WinPixEventRuntime::WriteBlocksToCaptureFile(count, spans);
+
+    // ETW can't tell sessions apart, so when one session is listening for
+    // batches and another only for PIXRecordTimingBlock_v2, both events are
+    // written. This is also how blocks batched before a session changed get
+    // to it.
+    if (EventEnabledPIXRecordTimingBlock_v2())
+    {
+        ForEachBlock(count, spans, WriteBlockV2);
+    }
+
+    if (!EventEnabledPIXRecordTimingBlocks())
+        return;
 
-    EventWritePIXRecordTimingBlock_v2(eventId.fetch_add(1), numBytes, static_cast<BYTE*>(block));
+    // A batch can be too big for the session's buffers, or the buffers can be
+    // full. Writing the blocks one per event gives each of them a chance.
+    if (WriteTimingBlocksEvent(count, spans) != ERROR_SUCCESS)
+    {
+        ForEachBlock(count, spans, [](uint32_t numBytes, BYTE* block)
+        {
+            BlockSpan span = { numBytes, block };
+            WriteTimingBlocksEvent(1, &span);
+        });
+    }
 }
@@ -3,35 +3,253 @@
 
 #include "BlockAllocator.h"
 
+#include "LatencyHistogram.h"
 #include "WinPixEventRuntime.h"
 
 #include <pix3.h>
 
+#include <shared/PEvtCompression.h>
+
 #include <wil/resource.h>
 
+#include <algorithm>
+#include <atomic>
 #include <optional>
 
 #include <assert.h>
 
 namespace WinPixEventRuntime::BlockAllocator
 {
-    static constexpr size_t BLOCK_SIZE = 16 * 1024; // 16kb block size
+    // Blocks come in power of two sizes from MinBlockSize to MaxBlockSize, and
+    // each size has its own magazines and depot.
+    static constexpr size_t SIZE_CLASS_COUNT = 4;
+    static_assert((MinBlockSize << (SIZE_CLASS_COUNT - 1)) == MaxBlockSize);
+    static_assert(DefaultBlockSize >= MinBlockSize && DefaultBlockSize <= MaxBlockSize);
+
+    // Blocks move between threads and the depot a magazine at a time, and new
+    // blocks are carved out of a chunk a magazine at a time.
+    static constexpr size_t MAGAZINE_SIZE = 8;
+
+    // Number of magazines that Replenish keeps in the depot for each size
+    // that's in use.
+    static constexpr USHORT DEPOT_RESERVE = 2;
+
+    // Number of retired blocks kept for new threads to adopt. Any more are
+    // freed as usual.
+    static constexpr USHORT RETIRED_BLOCK_LIMIT = 32;
+
+    // On machines with more than one NUMA node, each node has its own arena
+    // of blocks, so that threads write events into memory that's local to
+    // them. Nodes beyond MAX_ARENAS share arenas.
+    static constexpr size_t MAX_ARENAS = 8;
+
+    // Arenas get their memory a chunk at a time. Chunks are aligned to their
+    // size and start with a ChunkHeader, so the arena that a block belongs to
+    // can be found from its address alone.
+    static constexpr size_t CHUNK_SIZE = 2 * 1024 * 1024;
+    static constexpr size_t CHUNK_HEADER_SIZE = MinBlockSize;
+    static_assert(MaxBlockSize * MAGAZINE_SIZE <= CHUNK_SIZE - CHUNK_HEADER_SIZE);
+
+    struct ChunkHeader
+    {
+        ChunkHeader* Next;
+        void* Reservation;          // What to pass to VirtualFree
+        size_t Arena;
+        bool IsLargePage;           // Large page chunks are committed up front
+    };
+
+    static_assert(sizeof(ChunkHeader) <= CHUNK_HEADER_SIZE);
+
+    // While a block is free its memory is used to link it into a magazine. The
+    // first block of a magazine also links the magazine into the depot.
+    // Retired blocks are linked through DepotEntry too, and Count holds their
+    // size.
+    struct FreeBlock
+    {
+        SLIST_ENTRY DepotEntry;
+        FreeBlock* Next;
+        size_t Count;
+    };
+
+    static_assert(MinBlockSize % MEMORY_ALLOCATION_ALIGNMENT == 0);
+    static_assert(sizeof(FreeBlock) <= MinBlockSize);
+
+    static size_t GetSizeClass(uint32_t blockSize)
+    {
+        size_t sizeClass = 0;
+        while ((MinBlockSize << sizeClass) < blockSize)
+        {
+            ++sizeClass;
+        }
+        assert((MinBlockSize << sizeClass) == blockSize);
+        return sizeClass;
+    }
+
+    static uint32_t GetSizeClassBlockSize(size_t sizeClass)
+    {
+        return MinBlockSize << sizeClass;
+    }
+
+    static size_t GetArena(void const* block)
+    {
+        auto chunk = reinterpret_cast<ChunkHeader const*>(reinterpret_cast<uintptr_t>(block) & ~(CHUNK_SIZE - 1));
+        return chunk->Arena;
+    }
+
+    // Each thread keeps a magazine of free blocks of each size, from each
+    // arena, that it allocates from and frees to without any synchronization.
+    // The magazines are tagged with the generation of the allocator that the
+    // blocks came from, so that blocks belonging to an allocator that has
+    // since been shut down are never used.
+    struct Magazine
+    {
+        FreeBlock* Blocks;
+        size_t Count;
+    };
+
+    struct ThreadCache
+    {
+        Magazine Magazines[MAX_ARENAS][SIZE_CLASS_COUNT];
+        size_t Arena;               // The arena this thread allocates from
+        uint64_t Generation;
+    };
+
+    static thread_local ThreadCache t_cache;
+
+    static std::atomic<uint64_t> g_generation = 0;
+
+    // See SetLargePages.
+    static std::atomic<bool> g_useLargePages = false;
+
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP | WINAPI_PARTITION_SYSTEM)
+    // Large pages need SeLockMemoryPrivilege, which the user has to have been
+    // granted, to be enabled in the process's token.
+    static bool EnableLockMemoryPrivilege()
+    {
+        wil::unique_handle token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, token.put()))
+            return false;
+
+        TOKEN_PRIVILEGES privileges = {};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        if (!LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid))
+            return false;
+
+        // This succeeds without enabling anything when the privilege hasn't
+        // been granted, and says so through GetLastError.
+        if (!AdjustTokenPrivileges(token.get(), FALSE, &privileges, 0, nullptr, nullptr))
+            return false;
+
+        return GetLastError() == ERROR_SUCCESS;
+    }
+#endif
+
+    // Returns a committed, CHUNK_SIZE aligned chunk made of large pages, or
+    // null if large pages can't be had.
+    static void* AllocateLargePageChunk(ULONG node)
+    {
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP | WINAPI_PARTITION_SYSTEM)
+        static const bool canUseLargePages = [] {
+            const SIZE_T largePageSize = GetLargePageMinimum();
+            return largePageSize != 0 && CHUNK_SIZE % largePageSize == 0 && EnableLockMemoryPrivilege();
+        }();
+
+        if (!canUseLargePages)
+            return nullptr;
+
+        const DWORD type = MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES;
+        void* memory = (node != NUMA_NO_PREFERRED_NODE)
+            ? VirtualAllocExNuma(GetCurrentProcess(), nullptr, CHUNK_SIZE, type, PAGE_READWRITE, node)
+            : VirtualAlloc(nullptr, CHUNK_SIZE, type, PAGE_READWRITE);
+
+        // Large pages smaller than a chunk only guarantee their own alignment
+        if (memory && (reinterpret_cast<uintptr_t>(memory) & (CHUNK_SIZE - 1)) != 0)
+        {
+            VirtualFree(memory, 0, MEM_RELEASE);
+            return nullptr;
+        }
+
+        return memory;
+#else
+        // Apps can't lock memory, so they never get large pages.
+        (void)node;
+        return nullptr;
+#endif
+    }
 
     class BlockAllocator
     {
+        struct Arena
+        {
+            // Full (or, when a thread has exited, partial) magazines waiting to
+            // be picked up by threads that have run out of blocks.
+            SLIST_HEADER Depots[SIZE_CLASS_COUNT];
+
+            // Set once a size has been allocated, so that Replenish knows
+            // which sizes are worth keeping in stock.
+            std::atomic<bool> IsSizeClassUsed[SIZE_CLASS_COUNT] = {};
+
+            // The NUMA node that the arena's memory comes from.
+            ULONG Node = NUMA_NO_PREFERRED_NODE;
+
+            // Protected by m_srwlock. New magazines come from the unused
+            // part of the newest chunk.
+            ChunkHeader* Chunks = nullptr;
+            uint8_t* ChunkUnused = nullptr;
+            uint8_t* ChunkEnd = nullptr;
+        };
+
+        // Only protects the arenas' chunks, which are only used to allocate
+        // new magazines.
         wil::srwlock m_srwlock;
-        HANDLE m_heap;
-        DWORD m_createHeapStatus;
+
+        Arena m_arenas[MAX_ARENAS];
+        size_t m_arenaCount = 1;
+
+        // Blocks, of any size, waiting to be adopted (see Retire).
+        SLIST_HEADER m_retiredBlocks;
+
+        // Protected by m_srwlock. Once a large page chunk can't be had, the
+        // allocator stops asking, since failing can take a while when the
+        // system's memory is fragmented.
+        bool m_areLargePagesUnavailable = false;
+        std::atomic<size_t> m_largePageChunkCount = 0;
+
+        uint64_t m_generation;
 
     public:
         BlockAllocator()
-            : m_heap(nullptr)
-            , m_createHeapStatus(ERROR_SUCCESS)
+            : m_generation(++g_generation)
         {
+            for (auto& arena : m_arenas)
+            {
+                for (auto& depot : arena.Depots)
+                {
+                    InitializeSListHead(&depot);
+                }
+            }
+            InitializeSListHead(&m_retiredBlocks);
+
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP | WINAPI_PARTITION_SYSTEM)
+            ULONG highestNode = 0;
+            if (GetNumaHighestNodeNumber(&highestNode) && highestNode > 0)
+            {
+                m_arenaCount = std::min<size_t>(highestNode + 1, MAX_ARENAS);
+                for (size_t i = 0; i < m_arenaCount; ++i)
+                {
+                    m_arenas[i].Node = static_cast<ULONG>(i);
+                }
+            }
+#endif
         }
 
         ~BlockAllocator()
         {
+            // Any blocks still in a thread's magazine now belong to a stale
+            // generation.
+            ++g_generation;
+
             // We don't expect there to be contention for this lock, but assert
             // if there is to give us a chance to detect it. We also take the
             // lock out anyway so if there is a bug here we can mask it in
@@ -40,58 +258,284 @@ namespace WinPixEventRuntime::BlockAllocator
             assert(tryLock);
             auto lock = tryLock ? std::move(tryLock) : m_srwlock.lock_exclusive();
             
-            if (m_heap)
+            for (auto& arena : m_arenas)
             {
-                HeapDestroy(m_heap);
+                while (auto chunk = arena.Chunks)
+                {
+                    arena.Chunks = chunk->Next;
+                    VirtualFree(chunk->Reservation, 0, MEM_RELEASE);
+                }
             }
         }
 
-        void* Allocate()
+        void* Allocate(size_t sizeClass)
         {
-            auto lock = m_srwlock.lock_exclusive();
+            ThreadCache& cache = GetThreadCache();
+            Magazine* magazine = &cache.Magazines[cache.Arena][sizeClass];
 
-            // If we failed to create the heap before then it's not going to succeed later
-            if (m_createHeapStatus != ERROR_SUCCESS)
-                return nullptr;
+            if (!magazine->Blocks)
+            {
+                // Threads move between processors, so pick the arena again
+                // each time the magazine runs out.
+                cache.Arena = GetCurrentArena();
+                magazine = &cache.Magazines[cache.Arena][sizeClass];
+            }
 
-            // We lazy create the heap on first allocate
-            if (!m_heap)
+            if (!magazine->Blocks)
             {
-                // We have our own lock
-                auto options = HEAP_NO_SERIALIZE;
+                Arena& arena = m_arenas[cache.Arena];
+                if (auto entry = InterlockedPopEntrySList(&arena.Depots[sizeClass]))
+                {
+                    auto first = reinterpret_cast<FreeBlock*>(entry);
+                    magazine->Blocks = first;
+                    magazine->Count = first->Count;
+                }
+                else if (!AllocateMagazine(cache.Arena, sizeClass, *magazine))
+                {
+                    return nullptr;
+                }
+            }
 
-                // Initial size is for some arbitrary number of blocks
-                auto initialSize = BLOCK_SIZE * 16;
+            FreeBlock* block = magazine->Blocks;
+            magazine->Blocks = block->Next;
+            --magazine->Count;
+            return block;
+        }
 
-                // The heap can grow if necessary
-                auto maximumSize = 0;
+        void Free(void* p, size_t sizeClass)
+        {
+            if (!p)
+                return;
 
-                m_heap = HeapCreate(options, initialSize, maximumSize);
+            // Blocks go back to the arena they came from, whichever thread
+            // frees them.
+            const size_t arena = GetArena(p);
+            Magazine& magazine = GetThreadCache().Magazines[arena][sizeClass];
 
-                if (!m_heap)
+            auto block = static_cast<FreeBlock*>(p);
+            block->Next = magazine.Blocks;
+            magazine.Blocks = block;
+            ++magazine.Count;
+
+            // A full magazine goes back to the depot in one go so that the
+            // threads allocating blocks can pick it up. This is how blocks
+            // freed by the worker find their way back to the producers.
+            if (magazine.Count == MAGAZINE_SIZE)
+            {
+                ReturnMagazine(arena, sizeClass, magazine);
+            }
+        }
+
+        void Retire(void* p, size_t sizeClass)
+        {
+            // Another thread may be retiring a block at the same time, so
+            // there can occasionally be one or two more than the limit.
+            if (QueryDepthSList(&m_retiredBlocks) >= RETIRED_BLOCK_LIMIT)
+            {
+                Free(p, sizeClass);
+                return;
+            }
+
+            auto block = static_cast<FreeBlock*>(p);
+            block->Count = GetSizeClassBlockSize(sizeClass);
+            InterlockedPushEntrySList(&m_retiredBlocks, &block->DepotEntry);
+        }
+
+        void* Adopt(uint32_t& blockSize)
+        {
+            auto block = reinterpret_cast<FreeBlock*>(InterlockedPopEntrySList(&m_retiredBlocks));
+            if (block)
+            {
+                blockSize = static_cast<uint32_t>(block->Count);
+            }
+            return block;
+        }
+
+        void ReleaseThreadCache()
+        {
+            if (t_cache.Generation == m_generation)
+            {
+                for (size_t arena = 0; arena < m_arenaCount; ++arena)
                 {
-                    m_createHeapStatus = GetLastError();
-                    return nullptr;
+                    for (size_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; ++sizeClass)
+                    {
+                        if (t_cache.Magazines[arena][sizeClass].Blocks)
+                        {
+                            ReturnMagazine(arena, sizeClass, t_cache.Magazines[arena][sizeClass]);
+                        }
+                    }
                 }
             }
+        }
 
-            return HeapAlloc(m_heap, HEAP_NO_SERIALIZE, BLOCK_SIZE);
+        bool IsUsingLargePages() const
+        {
+            return m_largePageChunkCount.load(std::memory_order_relaxed) != 0;
         }
 
-        void Free(void* p)
+        void Replenish()
         {
-            if (!p)
-                return;
+            for (size_t arena = 0; arena < m_arenaCount; ++arena)
+            {
+                for (size_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; ++sizeClass)
+                {
+                    if (!m_arenas[arena].IsSizeClassUsed[sizeClass])
+                        continue;
+
+                    while (QueryDepthSList(&m_arenas[arena].Depots[sizeClass]) < DEPOT_RESERVE)
+                    {
+                        Magazine magazine = {};
+                        if (!AllocateMagazine(arena, sizeClass, magazine))
+                            return;
+
+                        ReturnMagazine(arena, sizeClass, magazine);
+                    }
+                }
+            }
+        }
+
+    private:
+        ThreadCache& GetThreadCache()
+        {
+            ThreadCache& cache = t_cache;
+            if (cache.Generation != m_generation)
+            {
+                // The blocks, if any, were freed along with an old allocator
+                cache = {};
+                cache.Generation = m_generation;
+                cache.Arena = GetCurrentArena();
+            }
+            return cache;
+        }
+
+        size_t GetCurrentArena() const
+        {
+            if (m_arenaCount == 1)
+                return 0;
+
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP | WINAPI_PARTITION_SYSTEM)
+            PROCESSOR_NUMBER processor;
+            GetCurrentProcessorNumberEx(&processor);
+
+            USHORT node = 0;
+            if (GetNumaProcessorNodeEx(&processor, &node))
+                return node % m_arenaCount;
+#endif
+
+            return 0;
+        }
 
+        void ReturnMagazine(size_t arena, size_t sizeClass, Magazine& magazine)
+        {
+            FreeBlock* first = magazine.Blocks;
+            first->Count = magazine.Count;
+            InterlockedPushEntrySList(&m_arenas[arena].Depots[sizeClass], &first->DepotEntry);
+
+            magazine.Blocks = nullptr;
+            magazine.Count = 0;
+        }
+
+        // Commits memory on the arena's node, if it has one. If the node
+        // can't provide it, the memory comes from anywhere.
+        static void* Commit(Arena const& arena, void* address, size_t size)
+        {
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP | WINAPI_PARTITION_SYSTEM)
+            if (arena.Node != NUMA_NO_PREFERRED_NODE)
+            {
+                if (auto memory = VirtualAllocExNuma(GetCurrentProcess(), address, size, MEM_COMMIT, PAGE_READWRITE, arena.Node))
+                    return memory;
+            }
+#else
+            (void)arena;
+#endif
+            return VirtualAllocFromApp(address, size, MEM_COMMIT, PAGE_READWRITE);
+        }
+
+        bool AllocateChunk(size_t arenaIndex)
+        {
+            Arena& arena = m_arenas[arenaIndex];
+
+            void* reservation = nullptr;
+            ChunkHeader* chunk = nullptr;
+
+            // A whole chunk of large pages takes one TLB entry rather than
+            // hundreds, but needs the memory to be committed up front.
+            if (g_useLargePages && !m_areLargePagesUnavailable)
+            {
+                reservation = AllocateLargePageChunk(arena.Node);
+                chunk = static_cast<ChunkHeader*>(reservation);
+                m_areLargePagesUnavailable = !chunk;
+            }
+
+            if (!chunk)
+            {
+                // Reserving twice the size guarantees an aligned chunk inside it
+                reservation = VirtualAllocFromApp(nullptr, CHUNK_SIZE * 2, MEM_RESERVE, PAGE_READWRITE);
+                if (!reservation)
+                    return false;
+
+                auto aligned = reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(reservation) + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1));
+
+                chunk = static_cast<ChunkHeader*>(Commit(arena, aligned, CHUNK_HEADER_SIZE));
+                if (!chunk)
+                {
+                    VirtualFree(reservation, 0, MEM_RELEASE);
+                    return false;
+                }
+                chunk->IsLargePage = false;
+            }
+            else
+            {
+                chunk->IsLargePage = true;
+                ++m_largePageChunkCount;
+            }
+
+            chunk->Next = arena.Chunks;
+            chunk->Reservation = reservation;
+            chunk->Arena = arenaIndex;
+
+            auto base = reinterpret_cast<uint8_t*>(chunk);
+            arena.Chunks = chunk;
+            arena.ChunkUnused = base + CHUNK_HEADER_SIZE;
+            arena.ChunkEnd = base + CHUNK_SIZE;
+            return true;
+        }
+
+        bool AllocateMagazine(size_t arenaIndex, size_t sizeClass, Magazine& magazine)
+        {
             auto lock = m_srwlock.lock_exclusive();
-            auto result = HeapFree(m_heap, HEAP_NO_SERIALIZE, p);
-            if (!result)
+
+            Arena& arena = m_arenas[arenaIndex];
+
+            // Blocks are never given back, they are recycled through the
+            // magazines until the allocator is destroyed. What's left of a
+            // chunk that a magazine doesn't fit in is never committed.
+            const size_t blockSize = GetSizeClassBlockSize(sizeClass);
+            const size_t magazineSize = blockSize * MAGAZINE_SIZE;
+            if (static_cast<size_t>(arena.ChunkEnd - arena.ChunkUnused) < magazineSize)
             {
-                auto gle = GetLastError();
-                (void)gle;
-                assert(result && !gle);
+                if (!AllocateChunk(arenaIndex))
+                    return false;
             }
-            (void)result;
+
+            auto memory = arena.ChunkUnused;
+            if (!arena.Chunks->IsLargePage && !Commit(arena, memory, magazineSize))
+                return false;
+
+            arena.ChunkUnused += magazineSize;
+            arena.IsSizeClassUsed[sizeClass] = true;
+
+            FreeBlock* blocks = nullptr;
+            for (size_t i = MAGAZINE_SIZE; i > 0; --i)
+            {
+                auto block = reinterpret_cast<FreeBlock*>(memory + (i - 1) * blockSize);
+                block->Next = blocks;
+                blocks = block;
+            }
+
+            magazine.Blocks = blocks;
+            magazine.Count = MAGAZINE_SIZE;
+            return true;
         }
     };
 
@@ -110,14 +554,48 @@ namespace WinPixEventRuntime::BlockAllocator
     }
 
 
-    Block Allocate(std::optional<uint64_t> const& eventTime)
+    void SetLargePages(bool isEnabled)
     {
-        PEvtBlkHdr* block = static_cast<PEvtBlkHdr*>(g_blockAllocator->Allocate());
-        if (!block)
-            return nullptr;
+        g_useLargePages = isEnabled;
+    }
+
+
+    bool IsUsingLargePages()
+    {
+        return g_blockAllocator && g_blockAllocator->IsUsingLargePages();
+    }
+
+
+    void ReleaseThreadCache()
+    {
+        if (g_blockAllocator)
+            g_blockAllocator->ReleaseThreadCache();
+    }
+
+
+    void Replenish()
+    {
+        if (g_blockAllocator)
+            g_blockAllocator->Replenish();
+    }
+
+
+    uint32_t ClampBlockSize(uint32_t blockSize)
+    {
+        uint32_t clamped = MinBlockSize;
+        while (clamped < blockSize && clamped < MaxBlockSize)
+        {
+            clamped *= 2;
+        }
+        return clamped;
+    }
+
 
+    // Sets up the header of a block that's been allocated or adopted.
+    static Block InitializeBlock(PEvtBlkHdr* block, std::optional<uint64_t> const& eventTime, uint32_t blockSize)
+    {
         *block = {};
-        block->pPIXLimit = reinterpret_cast<uint8_t*>(block) + BLOCK_SIZE;
+        block->pPIXLimit = reinterpret_cast<uint8_t*>(block) + blockSize;
         block->pPIXCurrent = reinterpret_cast<uint8_t*>(block + 1);
 
         block->BlockType = PIXEVT_CPU_BLOCK;
@@ -125,23 +603,279 @@ namespace WinPixEventRuntime::BlockAllocator
         block->cpuHeader.threadId = GetCurrentThreadId();
         block->cpuHeader.beginTimestamp = eventTime ? *eventTime : PIXGetTimestampCounter();
         block->cpuHeader.endTimestamp = ~0ull;
+
+        // An empty block, so that nothing left over from a previous use of
+        // this memory gets written out.
+        *reinterpret_cast<uint64_t*>(block->pPIXCurrent) = PIXEventsBlockEndMarker;
         
         return Block(block);
     }
 
 
+    Block Allocate(std::optional<uint64_t> const& eventTime, uint32_t blockSize)
+    {
+        LatencyTimer timer(LatencyOperation::Allocate);
+
+        blockSize = ClampBlockSize(blockSize);
+
+        PEvtBlkHdr* block = static_cast<PEvtBlkHdr*>(g_blockAllocator->Allocate(GetSizeClass(blockSize)));
+        if (!block)
+            return nullptr;
+
+        return InitializeBlock(block, eventTime, blockSize);
+    }
+
+
+    void Retire(Block block)
+    {
+        if (block)
+        {
+            auto p = block.release();
+            g_blockAllocator->Retire(p, GetSizeClass(GetBlockSize(p)));
+        }
+    }
+
+
+    Block Adopt(std::optional<uint64_t> const& eventTime)
+    {
+        uint32_t blockSize = 0;
+        PEvtBlkHdr* block = static_cast<PEvtBlkHdr*>(g_blockAllocator->Adopt(blockSize));
+        if (!block)
+            return nullptr;
+
+        return InitializeBlock(block, eventTime, blockSize);
+    }
+
+
+    uint32_t GetBlockSize(PEvtBlkHdr const* block)
+    {
+        return static_cast<uint32_t>(block->pPIXLimit - reinterpret_cast<BYTE const*>(block));
+    }
+
+
+    uint32_t GetUsedSize(PEvtBlkHdr const* block)
+    {
+        // pPIXCurrent points at the end marker that follows the last event
+        auto end = std::min(block->pPIXCurrent + sizeof(uint64_t), block->pPIXLimit);
+        return static_cast<uint32_t>(end - reinterpret_cast<BYTE const*>(block));
+    }
+
+
     void Free(PEvtBlkHdr* block)
     {
         if (block)
-            g_blockAllocator->Free(block);
+            g_blockAllocator->Free(block, GetSizeClass(GetBlockSize(block)));
+    }
+
+
+    // Counts the events in a block that's about to be written out. Only the
+    // worker does this, so the threads recording events don't have to.
+    static uint64_t CountEvents(PEvtBlkHdr const* block)
+    {
+        if (block->BlockType != PIXEVT_CPU_BLOCK)
+            return 0;
+
+        uint64_t count = 0;
+
+        auto event = reinterpret_cast<uint64_t const*>(block + 1);
+        auto end = reinterpret_cast<uint64_t const*>(block->pPIXCurrent);
+        while (event < end)
+        {
+            const uint64_t size = (*event & PIXEventsSizeReadMask) >> PIXEventsSizeBitShift;
+            if (size == 0)
+                break;
+
+            ++count;
+            event += size;
+        }
+
+        return count;
     }
 
 
     void WriteBlock(Block block)
+    {
+        WriteBlock(block.get());
+    }
+
+
+    void WriteBlock(PEvtBlkHdr* block)
+    {
+        if (block)
+        {
+            const uint32_t usedSize = GetUsedSize(block);
+            block->BlockSize = usedSize;
+            {
+                LatencyTimer timer(LatencyOperation::Write);
+                if (block->BlockType == PIXEVT_STATS_BLOCK)
+                {
+                    WinPixEventRuntime::WriteStatisticsBlock(usedSize, block);
+                }
+                else
+                {
+                    WinPixEventRuntime::WriteBlock(usedSize, block);
+                }
+            }
+            RecordBlockWrite(1, CountEvents(block), usedSize);
+        }
+    }
+
+
+    BlockPacker::BlockPacker()
+    {
+        m_buffer.reserve(MaxWriteSize);
+        m_spans.reserve(MaxSpansPerWrite);
+    }
+
+    BlockPacker::~BlockPacker()
+    {
+        Flush();
+    }
+
+
+    void BlockPacker::Write(Block block)
+    {
+        if (block)
+        {
+            Write(block.get(), &block);
+        }
+    }
+
+
+    void BlockPacker::WriteCopy(PEvtBlkHdr* block)
     {
         if (block)
         {
-            WinPixEventRuntime::WriteBlock(static_cast<uint32_t>(block->pPIXLimit - (BYTE*)block.get()), block.get());
+            Write(block, nullptr);
+        }
+    }
+
+
+    void BlockPacker::Write(PEvtBlkHdr* block, Block* ownedBlock)
+    {
+        // Statistics blocks are never batched, since they have an event of
+        // their own (see WriteStatisticsBlock)
+        if (!AreBlockBatchesEnabled() || block->BlockType == PIXEVT_STATS_BLOCK)
+        {
+            // Anything already batched goes first, to keep the blocks in order
+            Flush();
+            WriteBlock(block);
+            return;
         }
+
+        const uint32_t usedSize = GetUsedSize(block);
+        block->BlockSize = usedSize;
+
+        const uint64_t events = CountEvents(block);
+
+        if (block->BlockType == PIXEVT_CPU_BLOCK && IsBlockCompressionEnabled() && Compress(reinterpret_cast<uint8_t const*>(block), usedSize))
+        {
+            Copy(m_compressed.data(), static_cast<uint32_t>(m_compressed.size()));
+        }
+        else if (usedSize <= PackedBlockSizeLimit || !ownedBlock)
+        {
+            Copy(reinterpret_cast<uint8_t const*>(block), usedSize);
+        }
+        else
+        {
+            MakeRoom(usedSize);
+            m_spans.push_back({ std::move(*ownedBlock), 0, usedSize });
+            m_batchSize += usedSize;
+        }
+
+        ++m_batchBlocks;
+        m_batchEvents += events;
+    }
+
+
+    void BlockPacker::Copy(uint8_t const* bytes, uint32_t size)
+    {
+        MakeRoom(size);
+
+        // Extend the last run of copied bytes if there is one
+        if (m_spans.empty() || m_spans.back().OwnedBlock)
+        {
+            m_spans.push_back({ nullptr, static_cast<uint32_t>(m_buffer.size()), 0 });
+        }
+        m_spans.back().Size += size;
+
+        m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+        m_batchSize += size;
+    }
+
+
+    void BlockPacker::MakeRoom(uint32_t size)
+    {
+        if (m_batchSize + size > MaxWriteSize || m_spans.size() == MaxSpansPerWrite)
+        {
+            Flush();
+        }
+    }
+
+
+    void BlockPacker::Flush()
+    {
+        if (m_spans.empty())
+            return;
+
+        BlockSpan spans[MaxSpansPerWrite];
+        uint32_t count = 0;
+        for (auto& span : m_spans)
+        {
+            void* data = span.OwnedBlock ? static_cast<void*>(span.OwnedBlock.get()) : static_cast<void*>(m_buffer.data() + span.Offset);
+            spans[count++] = { span.Size, data };
+        }
+
+        {
+            LatencyTimer timer(LatencyOperation::Write);
+            WinPixEventRuntime::WriteBlocks(count, spans);
+        }
+        RecordBlockWrite(m_batchBlocks, m_batchEvents, m_batchSize);
+
+        // Freeing the blocks returns them to this thread's cache
+        m_spans.clear();
+        m_buffer.clear();
+        m_batchSize = 0;
+        m_batchBlocks = 0;
+        m_batchEvents = 0;
+    }
+
+
+    bool BlockPacker::Compress(uint8_t const* block, uint32_t size)
+    {
+        constexpr uint32_t HeaderSize = sizeof(PEvtBlkHdr) + sizeof(PEvtCmpBlkHdr);
+
+        if (size <= HeaderSize)
+            return false;
+
+        // Anything that doesn't come out smaller is written uncompressed
+        m_compressed.resize(size);
+
+        LARGE_INTEGER start;
+        QueryPerformanceCounter(&start);
+
+        const size_t compressedDataSize = PEvtCompress(block + sizeof(PEvtBlkHdr), size - sizeof(PEvtBlkHdr), m_compressed.data() + HeaderSize, size - HeaderSize);
+
+        LARGE_INTEGER end;
+        QueryPerformanceCounter(&end);
+
+        const uint32_t compressedSize = compressedDataSize ? HeaderSize + static_cast<uint32_t>(compressedDataSize) : size;
+        RecordBlockCompression(size, compressedSize, static_cast<uint64_t>(end.QuadPart - start.QuadPart));
+
+        if (!compressedDataSize)
+            return false;
+
+        m_compressed.resize(compressedSize);
+
+        auto header = reinterpret_cast<PEvtBlkHdr*>(m_compressed.data());
+        memcpy(header, block, sizeof(PEvtBlkHdr));
+        header->BlockType = PIXEVT_CPU_BLOCK_COMPRESSED;
+        header->BlockSize = compressedSize;
+
+        auto compressedHeader = reinterpret_cast<PEvtCmpBlkHdr*>(header + 1);
+        compressedHeader->DataSize = size - sizeof(PEvtBlkHdr);
+        compressedHeader->Reserved = 0;
+
+        return true;
     }
 }
@@ -3,23 +3,140 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <vector>
 
 struct PEvtBlkHdr;
 
 namespace WinPixEventRuntime::BlockAllocator
 {
+    // Blocks are a power of two in size. The largest keeps a block, with the
+    // ETW event header, well within the 64kb limit on ETW event size.
+    constexpr uint32_t MinBlockSize = 4 * 1024;
+    constexpr uint32_t MaxBlockSize = 32 * 1024;
+    constexpr uint32_t DefaultBlockSize = 16 * 1024;
+
+    // Several blocks can be written out together, as long as they add up to
+    // no more than this, which still leaves room in the 64kb for the ETW
+    // event header.
+    constexpr uint32_t MaxWriteSize = 60 * 1024;
+    constexpr uint32_t MaxSpansPerWrite = 64;
+
     void Initialize();
     void Shutdown();
 
+    // Blocks are carved out of 2mb chunks. While large pages are turned on,
+    // new chunks are made of large pages where possible, so that threads
+    // filling blocks need far fewer TLB entries. Where they aren't possible
+    // (SeLockMemoryPrivilege hasn't been granted, there isn't enough
+    // contiguous memory, or in apps) chunks are made of ordinary pages
+    // instead. Chunks that have already been allocated are kept until
+    // Shutdown. Off by default.
+    void SetLargePages(bool isEnabled);
+
+    // True if any of the allocator's chunks are made of large pages.
+    bool IsUsingLargePages();
+
     void Free(PEvtBlkHdr* block);
 
+    // Free blocks are cached per thread. Threads that allocate or free blocks
+    // call this before they exit to hand their cached blocks to other threads.
+    void ReleaseThreadCache();
+
+    // Makes sure there are some free blocks ready for threads that run out,
+    // so that they don't need to allocate more from the heap themselves. This
+    // is called by the worker, away from the threads writing events.
+    void Replenish();
+
     struct Deleter { void operator ()(PEvtBlkHdr* block) { Free(block); } };
 
     using Block = std::unique_ptr<PEvtBlkHdr, Deleter>;
 
-    Block Allocate(std::optional<uint64_t> const& eventTime);
+    // Rounds blockSize up to a size that Allocate supports.
+    uint32_t ClampBlockSize(uint32_t blockSize);
 
+    Block Allocate(std::optional<uint64_t> const& eventTime, uint32_t blockSize = DefaultBlockSize);
+
+    // Threads that exit hand the blocks they had ready, but hadn't written
+    // any events to, to Retire. New threads Adopt them for their first
+    // block, which also gives them the size that the last thread had settled
+    // on. Adopt returns a null block if there aren't any.
+    void Retire(Block block);
+    Block Adopt(std::optional<uint64_t> const& eventTime);
+
+    uint32_t GetBlockSize(PEvtBlkHdr const* block);
+
+    // The number of bytes of the block that have been written to, up to and
+    // including the end marker.
+    uint32_t GetUsedSize(PEvtBlkHdr const* block);
+
+    // Writes out the used part of the block.
     void WriteBlock(BlockAllocator::Block block);
+
+    // Likewise, but the block stays with the caller.
+    void WriteBlock(PEvtBlkHdr* block);
+
+    // Writes out blocks like WriteBlock, except that blocks with little in them
+    // (typically the last block of a short-lived thread, or one flushed at the
+    // end of a capture) are packed together so several of them share a write.
+    //
+    // When block compression is turned on (see SetBlockCompression) each block
+    // is compressed first, which usually makes it small enough to be packed.
+    //
+    // Blocks are gathered into batches of up to MaxWriteSize bytes, and each
+    // batch is handed to WriteBlocks in one go. Bigger blocks stay where they
+    // are rather than being copied into the batch.
+    //
+    // Nothing is batched unless AreBlockBatchesEnabled says that the blocks'
+    // readers can take batches; each block is then written on its own, like
+    // WriteBlock does.
+    class BlockPacker
+    {
+        // A run of bytes in m_buffer, or a block of its own.
+        struct Span
+        {
+            Block OwnedBlock;
+            uint32_t Offset;
+            uint32_t Size;
+        };
+
+        std::vector<uint8_t> m_buffer;
+        std::vector<Span> m_spans;
+        uint32_t m_batchSize = 0;
+        uint32_t m_batchBlocks = 0;
+        uint64_t m_batchEvents = 0;
+        std::vector<uint8_t> m_compressed;
+
+    public:
+        // Blocks that use more than this aren't copied.
+        static constexpr uint32_t PackedBlockSizeLimit = MinBlockSize / 2;
+
+        BlockPacker();
+        ~BlockPacker();
+
+        BlockPacker(BlockPacker const&) = delete;
+        BlockPacker& operator=(BlockPacker const&) = delete;
+
+        void Write(Block block);
+
+        // Like Write, but the block stays with the caller, so it's always
+        // copied if it's batched.
+        void WriteCopy(PEvtBlkHdr* block);
+
+        // Writes out the current batch.
+        void Flush();
+
+    private:
+        // ownedBlock is null when the block can't be kept.
+        void Write(PEvtBlkHdr* block, Block* ownedBlock);
+
+        void Copy(uint8_t const* bytes, uint32_t size);
+        void MakeRoom(uint32_t size);
+
+        // Compresses the block into m_compressed, returns false if it didn't
+        // get any smaller.
+        bool Compress(uint8_t const* block, uint32_t size);
+    };
 }
@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "BlockQueue.h"
+
+#include <assert.h>
+
+namespace WinPixEventRuntime
+{
+    BlockQueue::BlockQueue()
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+        {
+            m_slots[i].Sequence.store(i, std::memory_order_relaxed);
+            m_slots[i].Block = nullptr;
+        }
+    }
+
+
+    bool BlockQueue::TryPush(BlockAllocator::Block& block)
+    {
+        assert(block);
+
+        size_t position = m_pushPosition.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            Slot& slot = m_slots[position & (Capacity - 1)];
+            size_t sequence = slot.Sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+            if (difference == 0)
+            {
+                // The slot is free for this position, try to claim it
+                if (m_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.Block = block.release();
+                    slot.Sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                // The slot still holds the block from a lap ago, so we're full
+                return false;
+            }
+            else
+            {
+                // Another producer claimed this position first
+                position = m_pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    BlockAllocator::Block BlockQueue::TryPop()
+    {
+        Slot& slot = m_slots[m_popPosition & (Capacity - 1)];
+        size_t sequence = slot.Sequence.load(std::memory_order_acquire);
+
+        if (sequence != m_popPosition + 1)
+        {
+            // Nothing has been pushed here yet
+            return nullptr;
+        }
+
+        BlockAllocator::Block block(slot.Block);
+        slot.Block = nullptr;
+
+        // Hand the slot back to the producers for the next lap
+        slot.Sequence.store(m_popPosition + Capacity, std::memory_order_release);
+        ++m_popPosition;
+
+        return block;
+    }
+}
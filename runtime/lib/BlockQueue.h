@@ -0,0 +1,48 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "BlockAllocator.h"
+
+#include <atomic>
+
+namespace WinPixEventRuntime
+{
+    // A bounded lock-free queue of blocks that any number of threads can push
+    // to, but only one thread at a time can pop from.
+    //
+    // Each slot carries a sequence number that says whether it is ready to be
+    // pushed to or popped from for a given position, so pushing is a single
+    // compare-exchange on the push position and popping doesn't need any.
+    class BlockQueue
+    {
+    public:
+        static constexpr size_t Capacity = 1024;
+
+    private:
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        struct Slot
+        {
+            std::atomic<size_t> Sequence;
+            PEvtBlkHdr* Block;
+        };
+
+        Slot m_slots[Capacity];
+
+        // The producers and the consumer update these independently, so keep
+        // them on separate cache lines.
+        alignas(64) std::atomic<size_t> m_pushPosition = 0;
+        alignas(64) size_t m_popPosition = 0;
+
+    public:
+        BlockQueue();
+
+        // Returns false, leaving block with the caller, if the queue is full.
+        bool TryPush(BlockAllocator::Block& block);
+
+        // Returns a null block if the queue is empty.
+        BlockAllocator::Block TryPop();
+    };
+}
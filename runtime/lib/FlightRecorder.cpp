@@ -0,0 +1,61 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "FlightRecorder.h"
+
+#include <utility>
+
+namespace WinPixEventRuntime
+{
+    FlightRecorder::FlightRecorder() = default;
+    FlightRecorder::~FlightRecorder() = default;
+
+
+    void FlightRecorder::SetSize(size_t maxBytes)
+    {
+        m_maxBytes = maxBytes;
+
+        if (m_maxBytes == 0)
+        {
+            m_droppedBlocks += m_blocks.size();
+            m_blocks.clear();
+            m_bytes = 0;
+        }
+        else
+        {
+            DropOldBlocks();
+        }
+    }
+
+
+    void FlightRecorder::Add(BlockAllocator::Block block)
+    {
+        if (!block)
+            return;
+
+        m_bytes += BlockAllocator::GetUsedSize(block.get());
+        m_blocks.push_back(std::move(block));
+
+        DropOldBlocks();
+    }
+
+
+    std::deque<BlockAllocator::Block> FlightRecorder::TakeBlocks()
+    {
+        m_bytes = 0;
+        return std::exchange(m_blocks, {});
+    }
+
+
+    void FlightRecorder::DropOldBlocks()
+    {
+        // Always keep the newest block, even if it's bigger than the whole
+        // recorder.
+        while (m_bytes > m_maxBytes && m_blocks.size() > 1)
+        {
+            m_bytes -= BlockAllocator::GetUsedSize(m_blocks.front().get());
+            m_blocks.pop_front();
+            ++m_droppedBlocks;
+        }
+    }
+}
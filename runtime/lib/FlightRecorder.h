@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "BlockAllocator.h"
+
+#include <deque>
+
+namespace WinPixEventRuntime
+{
+    // Keeps the most recently filled blocks in memory, until they are asked
+    // for. Once the used parts of the blocks it holds add up to more than its
+    // size the oldest ones are freed, which returns them to the allocator for
+    // the threads writing events to reuse. Blocks that are handed over part
+    // way through (eg by a flush) only count for what's in them.
+    //
+    // This isn't thread safe, it belongs to whoever is writing out blocks.
+    class FlightRecorder
+    {
+        std::deque<BlockAllocator::Block> m_blocks;
+        size_t m_maxBytes = 0;
+        size_t m_bytes = 0;
+        uint64_t m_droppedBlocks = 0;
+
+    public:
+        FlightRecorder();
+        ~FlightRecorder();
+
+        FlightRecorder(FlightRecorder const&) = delete;
+        FlightRecorder& operator=(FlightRecorder const&) = delete;
+
+        bool IsEnabled() const { return m_maxBytes != 0; }
+
+        // A size of 0 turns the recorder off and frees what it holds.
+        void SetSize(size_t maxBytes);
+
+        void Add(BlockAllocator::Block block);
+
+        // Hands over the blocks held so far, oldest first.
+        std::deque<BlockAllocator::Block> TakeBlocks();
+
+        size_t GetBlockCount() const { return m_blocks.size(); }
+        uint64_t GetDroppedBlockCount() const { return m_droppedBlocks; }
+
+    private:
+        void DropOldBlocks();
+    };
+}
@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "InternedStrings.h"
+
+#include "BlockAllocator.h"
+#include "Worker.h"
+
+#include <shared/PEvtBlk.h>
+
+namespace WinPixEventRuntime
+{
+    InternedStrings::InternedStrings() = default;
+    InternedStrings::~InternedStrings() = default;
+
+    bool InternedStrings::Add(uint64_t shortcut, void const* string)
+    {
+        if (!m_shortcuts.insert(shortcut).second)
+        {
+            return false;
+        }
+
+        // The record has to fit in a single event, along with the event info,
+        // so long strings are truncated. The copy may write up to the reserved
+        // tail space past the limit.
+        std::vector<uint64_t> record(PIXEventsSizeMax + PIXEventsReservedTailSpaceQwords);
+        uint64_t* destination = record.data();
+        uint64_t const* limit = record.data() + PIXEventsSizeMax - 1;
+
+        *destination++ = shortcut;
+        if (shortcut & PIXEventsStringIsANSIReadMask)
+        {
+            PIXCopyStringArgument(destination, limit, static_cast<PCSTR>(string));
+        }
+        else
+        {
+            PIXCopyStringArgument(destination, limit, static_cast<PCWSTR>(string));
+        }
+
+        record.resize(std::min<size_t>(destination - record.data(), PIXEventsSizeMax - 1));
+        m_records.push_back(std::move(record));
+
+        return true;
+    }
+
+
+    void InternedStrings::Write(Worker& worker, size_t first) const
+    {
+        BlockAllocator::Block block;
+        uint64_t* destination = nullptr;
+        uint64_t* limit = nullptr;
+
+        for (size_t i = first; i < m_records.size(); ++i)
+        {
+            auto const& record = m_records[i];
+            auto const eventSize = record.size() + 1;
+
+            // Leave room for the end marker
+            if (!block || static_cast<size_t>(limit - destination) < eventSize + 1)
+            {
+                if (block)
+                {
+                    *destination = PIXEventsBlockEndMarker;
+                    block->pPIXCurrent = reinterpret_cast<BYTE*>(destination);
+                    block->cpuHeader.endTimestamp = PIXGetTimestampCounter();
+                    worker.Add(std::move(block));
+                }
+
+                block = BlockAllocator::Allocate(std::nullopt);
+                if (!block)
+                {
+                    return;
+                }
+
+                destination = reinterpret_cast<uint64_t*>(block->pPIXCurrent);
+                limit = reinterpret_cast<uint64_t*>(block->pPIXLimit);
+            }
+
+            *destination++ = PIXEncodeEventInfo(block->cpuHeader.beginTimestamp, PIXEvent_InternString, static_cast<UINT8>(eventSize), PIX_EVENT_METADATA_NONE);
+            destination = std::copy(record.begin(), record.end(), destination);
+        }
+
+        if (block)
+        {
+            *destination = PIXEventsBlockEndMarker;
+            block->pPIXCurrent = reinterpret_cast<BYTE*>(destination);
+            block->cpuHeader.endTimestamp = PIXGetTimestampCounter();
+            worker.Add(std::move(block));
+        }
+    }
+}
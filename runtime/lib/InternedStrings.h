@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+
+namespace WinPixEventRuntime
+{
+    class Worker;
+
+    // The strings that have been interned with PIX_INTERN. Each one is written
+    // once per capture as a PIXEvent_InternString record so that the decoder
+    // can resolve the shortcuts that events carry instead of the characters.
+    class InternedStrings
+    {
+        // Each record is the shortcut followed by the characters of the string,
+        // exactly as it is written after the event info.
+        std::vector<std::vector<uint64_t>> m_records;
+        std::unordered_set<uint64_t> m_shortcuts;
+
+    public:
+        InternedStrings();
+        ~InternedStrings();
+
+        // Returns false if the string was already interned.
+        bool Add(uint64_t shortcut, void const* string);
+
+        // Writes the records starting at index first.
+        void Write(Worker& worker, size_t first = 0) const;
+
+        size_t Size() const { return m_records.size(); }
+    };
+}
@@ -0,0 +1,99 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+
+namespace WinPixEventRuntime
+{
+    static LatencyHistogram g_latencyHistograms[static_cast<size_t>(LatencyOperation::Count)];
+
+
+    LatencyHistogram& GetLatencyHistogram(LatencyOperation operation)
+    {
+        return g_latencyHistograms[static_cast<size_t>(operation)];
+    }
+
+
+    /*static*/ uint32_t LatencyHistogram::GetBucket(uint64_t cycles)
+    {
+        unsigned long highestBit;
+        if (!_BitScanReverse64(&highestBit, cycles))
+            return 0;
+
+        return static_cast<uint32_t>(highestBit);
+    }
+
+
+    void LatencyHistogram::Record(uint64_t cycles)
+    {
+        // Thread ids are multiples of 4
+        auto& shard = m_shards[(GetCurrentThreadId() >> 2) % ShardCount];
+
+        shard.Buckets[GetBucket(cycles)].fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t max = shard.Max.load(std::memory_order_relaxed);
+        while (cycles > max && !shard.Max.compare_exchange_weak(max, cycles, std::memory_order_relaxed)) {}
+    }
+
+
+    LatencyHistogram::Summary LatencyHistogram::GetSummary() const
+    {
+        Summary summary = {};
+
+        // Threads may be recording while we read, so the buckets we copy
+        // don't necessarily add up to a single moment. The percentiles are
+        // worked out from the copy so that at least they agree with it.
+        for (auto const& shard : m_shards)
+        {
+            for (uint32_t i = 0; i < BucketCount; ++i)
+            {
+                const uint64_t count = shard.Buckets[i].load(std::memory_order_relaxed);
+                summary.Buckets[i] += count;
+                summary.Count += count;
+            }
+            summary.Max = std::max(summary.Max, shard.Max.load(std::memory_order_relaxed));
+        }
+
+        auto percentile = [&](uint64_t perThousand)
+        {
+            // The rank of the duration that the percentile falls on, from 1
+            const uint64_t rank = std::max<uint64_t>((summary.Count * perThousand + 999) / 1000, 1);
+
+            uint64_t seen = 0;
+            for (uint32_t i = 0; i < BucketCount; ++i)
+            {
+                seen += summary.Buckets[i];
+                if (seen >= rank)
+                {
+                    const uint64_t upperBound = (i == BucketCount - 1) ? ~0ull : (2ull << i) - 1;
+                    return std::min(upperBound, summary.Max);
+                }
+            }
+            return summary.Max;
+        };
+
+        if (summary.Count != 0)
+        {
+            summary.P50 = percentile(500);
+            summary.P99 = percentile(990);
+            summary.P999 = percentile(999);
+        }
+
+        return summary;
+    }
+
+
+    void LatencyHistogram::Reset()
+    {
+        for (auto& shard : m_shards)
+        {
+            for (auto& bucket : shard.Buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            shard.Max.store(0, std::memory_order_relaxed);
+        }
+    }
+}
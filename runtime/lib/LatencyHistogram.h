@@ -0,0 +1,117 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <windows.h>
+#include <intrin.h>
+
+#include <atomic>
+#include <cstdint>
+
+// The runtime's slow paths time themselves into latency histograms, so that
+// the time threads lose to the runtime can be measured (see
+// PIXGetRuntimeLatency). Builds that don't want this can define
+// PIX_ENABLE_LATENCY_HISTOGRAMS to 0, which compiles the timers out and
+// leaves the histograms empty.
+#if !defined(PIX_ENABLE_LATENCY_HISTOGRAMS)
+#define PIX_ENABLE_LATENCY_HISTOGRAMS 1
+#endif
+
+namespace WinPixEventRuntime
+{
+    // The values match the PIX_RUNTIME_LATENCY_* operations in pix3.h.
+    enum class LatencyOperation : uint32_t
+    {
+        ReplaceBlock,   // PIXEventsReplaceBlock
+        TakeBlock,      // A thread handing a block to the worker
+        WorkerAdd,      // Queueing a block in the worker
+        Allocate,       // BlockAllocator::Allocate
+        Write,          // Each write of one or more blocks to ETW or the capture file
+
+        Count
+    };
+
+    // Reads the processor's timestamp counter, which is much cheaper than
+    // QueryPerformanceCounter and fine grained enough to time the slow paths.
+    inline uint64_t ReadCycleCounter()
+    {
+#if defined(_M_X64) || defined(_M_IX86)
+        return __rdtsc();
+#elif defined(_M_ARM64)
+        return static_cast<uint64_t>(_ReadStatusReg(ARM64_CNTVCT));
+#else
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return static_cast<uint64_t>(counter.QuadPart);
+#endif
+    }
+
+    // Counts durations in buckets that double in size: bucket i holds those
+    // from 2^i up to 2^(i+1) cycles, except that bucket 0 also holds 0. It
+    // has a fixed size and any number of threads can record into it at once
+    // without taking a lock. Threads record into one of several shards,
+    // picked by thread id, so that threads timing the same operation don't
+    // fight over the same cache lines; GetSummary adds the shards up.
+    class alignas(64) LatencyHistogram
+    {
+    public:
+        static constexpr uint32_t BucketCount = 64;
+
+        struct Summary
+        {
+            uint64_t Count;
+            uint64_t P50;       // Upper bounds of the buckets that these percentiles fall in
+            uint64_t P99;
+            uint64_t P999;
+            uint64_t Max;
+            uint64_t Buckets[BucketCount];
+        };
+
+        void Record(uint64_t cycles);
+        Summary GetSummary() const;
+        void Reset();
+
+        static uint32_t GetBucket(uint64_t cycles);
+
+    private:
+        struct alignas(64) Shard
+        {
+            std::atomic<uint64_t> Buckets[BucketCount] = {};
+            std::atomic<uint64_t> Max = 0;
+        };
+
+        static constexpr uint32_t ShardCount = 8;
+        Shard m_shards[ShardCount];
+    };
+
+    LatencyHistogram& GetLatencyHistogram(LatencyOperation operation);
+
+    // Records the time from its construction to its destruction in the
+    // operation's histogram.
+    class LatencyTimer
+    {
+#if PIX_ENABLE_LATENCY_HISTOGRAMS
+        LatencyOperation m_operation;
+        uint64_t m_start;
+
+    public:
+        explicit LatencyTimer(LatencyOperation operation)
+            : m_operation(operation)
+            , m_start(ReadCycleCounter())
+        {
+        }
+
+        ~LatencyTimer()
+        {
+            GetLatencyHistogram(m_operation).Record(ReadCycleCounter() - m_start);
+        }
+#else
+    public:
+        explicit LatencyTimer(LatencyOperation) {}
+#endif
+
+        LatencyTimer(LatencyTimer const&) = delete;
+        LatencyTimer& operator=(LatencyTimer const&) = delete;
+    };
+}
@@ -0,0 +1,153 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "MappedFileSink.h"
+
+#include <new>
+
+namespace WinPixEventRuntime
+{
+    static uint64_t GetStringTableOffset(uint64_t slotCount)
+    {
+        // Keep the string table and the slots page aligned
+        constexpr uint64_t PageSize = 4096;
+        const uint64_t headerSize = sizeof(PEvtFileHdr) + slotCount * sizeof(UINT64);
+        return (headerSize + PageSize - 1) & ~(PageSize - 1);
+    }
+
+
+    static uint64_t GetSlotsOffset(uint64_t slotCount)
+    {
+        return GetStringTableOffset(slotCount) + MappedFileSink::StringTableSize;
+    }
+
+
+    /*static*/ std::unique_ptr<MappedFileSink> MappedFileSink::Create(wchar_t const* fileName, uint64_t fileSize) noexcept
+    {
+        // Work out how many slots fit, leaving room for their commit sequence
+        // numbers and the string table.
+        uint64_t slotCount = fileSize / (SlotSize + sizeof(UINT64));
+        while (slotCount > 0 && GetSlotsOffset(slotCount) + slotCount * SlotSize > fileSize)
+        {
+            --slotCount;
+        }
+
+        if (slotCount < MinSlotCount || slotCount > UINT32_MAX)
+        {
+            SetLastError(ERROR_INVALID_PARAMETER);
+            return nullptr;
+        }
+
+        fileSize = GetSlotsOffset(slotCount) + slotCount * SlotSize;
+
+        // The *FromApp and CreateFile2 variants are used since they are
+        // available to every flavor of the runtime.
+        std::unique_ptr<MappedFileSink> sink(new (std::nothrow) MappedFileSink());
+        if (!sink)
+        {
+            SetLastError(ERROR_OUTOFMEMORY);
+            return nullptr;
+        }
+
+        sink->m_file.reset(CreateFile2(fileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, CREATE_ALWAYS, nullptr));
+        if (!sink->m_file)
+            return nullptr;
+
+        sink->m_mapping.reset(CreateFileMappingFromApp(sink->m_file.get(), nullptr, PAGE_READWRITE, fileSize, nullptr));
+        if (!sink->m_mapping)
+            return nullptr;
+
+        sink->m_view.reset(static_cast<BYTE*>(MapViewOfFileFromApp(sink->m_mapping.get(), FILE_MAP_READ | FILE_MAP_WRITE, 0, static_cast<SIZE_T>(fileSize))));
+        if (!sink->m_view)
+            return nullptr;
+
+        // The new file is all zeros, so every slot starts off uncommitted.
+        BYTE* view = sink->m_view.get();
+        sink->m_header = reinterpret_cast<PEvtFileHdr*>(view);
+        sink->m_commitSequences = reinterpret_cast<LONG64 volatile*>(view + sizeof(PEvtFileHdr));
+        sink->m_stringTable = view + GetStringTableOffset(slotCount);
+        sink->m_slots = view + GetSlotsOffset(slotCount);
+
+        sink->m_header->Version = PIXEVT_FILE_VERSION;
+        sink->m_header->SlotCount = static_cast<UINT32>(slotCount);
+        sink->m_header->SlotSize = SlotSize;
+        sink->m_header->SlotsOffset = static_cast<UINT32>(GetSlotsOffset(slotCount));
+        sink->m_header->StringTableOffset = static_cast<UINT32>(GetStringTableOffset(slotCount));
+        sink->m_header->StringTableSize = StringTableSize;
+
+        // Readers check the magic last, so they never see a partial header.
+        MemoryBarrier();
+        sink->m_header->Magic = PIXEVT_FILE_MAGIC;
+
+        return sink;
+    }
+
+
+    MappedFileSink::~MappedFileSink()
+    {
+        if (m_view)
+        {
+            // Not needed to keep the data, but it means that the file is up to
+            // date on disk by the time the sink has gone.
+            FlushViewOfFile(m_view.get(), 0);
+        }
+    }
+
+
+    bool MappedFileSink::Write(uint32_t numBytes, void const* data) noexcept
+    {
+        BlockSpan span = { numBytes, const_cast<void*>(data) };
+        return Write(1, &span);
+    }
+
+
+    bool MappedFileSink::Write(uint32_t count, BlockSpan const* spans) noexcept
+    {
+        uint64_t numBytes = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            numBytes += spans[i].NumBytes;
+        }
+
+        if (numBytes > SlotSize - sizeof(PEvtFileSlotHdr))
+            return false;
+
+        const uint64_t sequence = m_nextSequence.fetch_add(1, std::memory_order_relaxed);
+        const uint32_t slotIndex = static_cast<uint32_t>(sequence % m_header->SlotCount);
+
+        auto slot = m_slots + static_cast<size_t>(slotIndex) * SlotSize;
+        auto slotHeader = reinterpret_cast<PEvtFileSlotHdr*>(slot);
+
+        // Uncommit the slot before overwriting it, and only commit it again
+        // once everything has been copied in.
+        InterlockedExchange64(&m_commitSequences[slotIndex], 0);
+
+        slotHeader->Size = static_cast<UINT32>(numBytes);
+
+        BYTE* destination = slot + sizeof(PEvtFileSlotHdr);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            memcpy(destination, spans[i].Data, spans[i].NumBytes);
+            destination += spans[i].NumBytes;
+        }
+
+        InterlockedExchange64(&m_commitSequences[slotIndex], static_cast<LONG64>(sequence + 1));
+
+        return true;
+    }
+
+
+    bool MappedFileSink::WriteStringTable(uint32_t numBytes, void const* data) noexcept
+    {
+        const uint64_t used = m_header->StringTableUsed;
+        if (numBytes > StringTableSize - used)
+            return false;
+
+        // Readers only look at the committed part, so the new bytes don't
+        // count until they've all been copied in.
+        memcpy(m_stringTable + used, data, numBytes);
+        InterlockedExchange64(reinterpret_cast<LONG64 volatile*>(&m_header->StringTableUsed), static_cast<LONG64>(used + numBytes));
+
+        return true;
+    }
+}
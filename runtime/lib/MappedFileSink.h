@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "WinPixEventRuntime.h"
+
+#include <shared/PEvtFile.h>
+
+#include <wil/resource.h>
+
+#include <atomic>
+#include <memory>
+
+namespace WinPixEventRuntime
+{
+    // Writes blocks into a file through a file mapping, laid out as described
+    // in PEvtFile.h. Each write is a copy into the mapped view, there's no
+    // system call per block, and the pages belong to the file rather than the
+    // process so anything that has been committed survives a crash.
+    //
+    // Writes may come from any thread, but the ring assumes that there are
+    // never more writes in progress at once than it has slots. The string
+    // table has a single writer.
+    class MappedFileSink
+    {
+        struct UnmapView
+        {
+            void operator()(void* view) const { UnmapViewOfFile(view); }
+        };
+
+        wil::unique_hfile m_file;
+        wil::unique_handle m_mapping;
+        std::unique_ptr<BYTE, UnmapView> m_view;
+
+        PEvtFileHdr* m_header = nullptr;
+        LONG64 volatile* m_commitSequences = nullptr;
+        BYTE* m_stringTable = nullptr;
+        BYTE* m_slots = nullptr;
+
+        std::atomic<uint64_t> m_nextSequence = 0;
+
+    public:
+        // Big enough for the largest set of blocks that get written together.
+        static constexpr uint32_t SlotSize = BlockAllocator::MaxWriteSize + sizeof(PEvtFileSlotHdr);
+        static constexpr uint32_t MinSlotCount = 2;
+        static constexpr uint32_t StringTableSize = 64 * 1024;
+
+        // Creates fileName, replacing any file already there, and sizes it to
+        // fileSize. Returns null on failure, with the reason in GetLastError.
+        static std::unique_ptr<MappedFileSink> Create(wchar_t const* fileName, uint64_t fileSize) noexcept;
+
+        ~MappedFileSink();
+
+        MappedFileSink(MappedFileSink const&) = delete;
+        MappedFileSink& operator=(MappedFileSink const&) = delete;
+
+        // Returns false if the write is too big for a slot.
+        bool Write(uint32_t numBytes, void const* data) noexcept;
+
+        // Gathers the spans into a single slot.
+        bool Write(uint32_t count, BlockSpan const* spans) noexcept;
+
+        // Appends blocks of interned strings to the string table, which the
+        // ring never overwrites. Returns false once the table is full.
+        bool WriteStringTable(uint32_t numBytes, void const* data) noexcept;
+
+        uint32_t GetSlotCount() const { return m_header->SlotCount; }
+
+    private:
+        MappedFileSink() = default;
+    };
+}
@@ -8,10 +8,27 @@
 
 #include <pix3.h>
 
+#include <algorithm>
 #include <assert.h>
+#include <utility>
 
 namespace WinPixEventRuntime
 {
+    // Set once the calling thread's last ThreadData has been destroyed (see
+    // PIXGetCachedThreadInfo in PIXEventsCommon.h). These are trivially
+    // destructible, so they can still be used after the thread's other
+    // thread_locals have been destroyed. The tests give some threads more
+    // than one ThreadData.
+    static thread_local volatile uint32_t t_threadExited = 0;
+    static thread_local uint32_t t_threadDataCount = 0;
+
+
+    /*static*/ const volatile uint32_t* ThreadData::GetThreadExitedFlag()
+    {
+        return &t_threadExited;
+    }
+
+
     /*static*/ ThreadData* ThreadData::GetFromThreadInfo(PIXEventsThreadInfo* threadInfo)
     {
         // We're only going to ever hand out PIXEventsThreadInfo objects that
@@ -22,6 +39,7 @@ namespace WinPixEventRuntime
     }
 
     ThreadData::ThreadData()        
+        : m_osThreadId(GetCurrentThreadId())
     {
 #if DBG
         m_threadId = std::this_thread::get_id();
@@ -29,15 +47,37 @@ namespace WinPixEventRuntime
 #endif
 
         WinPixEventRuntime::RegisterThread(this);
+        ++t_threadDataCount;
+        t_threadExited = 0;
     }
 
     ThreadData::~ThreadData()
     {
         if (auto oldBlock = Flush(PIXGetTimestampCounter()))
         {
-            WinPixEventRuntime::TakeBlock(std::move(oldBlock));
+            // A block without any events doesn't need writing out, so it's
+            // left for the next thread to start with, like the standby block.
+            if (oldBlock->pPIXCurrent == reinterpret_cast<BYTE*>(oldBlock.get() + 1))
+            {
+                BlockAllocator::Retire(std::move(oldBlock));
+            }
+            else
+            {
+                WinPixEventRuntime::TakeBlock(std::move(oldBlock));
+            }
         }
         WinPixEventRuntime::UnregisterThread(this);
+        BlockAllocator::Retire(std::move(m_standbyBlock));
+        BlockAllocator::ReleaseThreadCache();
+
+        // Only this thread can have cached a pointer to our thread info, so
+        // rather than invalidating every thread's cache we flag just this one.
+        // Events that it writes while it finishes exiting are then dropped
+        // without touching us.
+        if (--t_threadDataCount == 0)
+        {
+            t_threadExited = 1;
+        }
     }
 
     PIXEventsThreadInfo* ThreadData::GetPixEventsThreadInfo()
@@ -64,9 +104,12 @@ namespace WinPixEventRuntime
             // to send it since the ETW provider has been disabled.
             if (m_pixEventsThreadInfo.block || m_currentBlock)
             {
+                ReleaseLiveBlock();
                 m_currentBlock.reset();
                 m_pixEventsThreadInfo.block = nullptr;
             }
+            m_standbyBlock.reset();
+            m_lastReplaceTime = 0;
 
             // This indicates that capture is disabled, and so the entry points
             // (eg PIXBeginEvent) won't attempt to allocate in this state.
@@ -95,11 +138,46 @@ namespace WinPixEventRuntime
 
         assert(!m_currentBlock);
 
-        // Get and use a new one
-        m_currentBlock = BlockAllocator::Allocate(eventTime);
+        const uint64_t now = eventTime ? *eventTime : PIXGetTimestampCounter();
+
+        // For our first block, take over one that a thread which has exited
+        // had ready. Threads that come and go then don't each need new
+        // blocks, and start at the size that the last one had grown to.
+        if (m_lastReplaceTime == 0 && !m_standbyBlock)
+        {
+            m_standbyBlock = BlockAllocator::Adopt(now);
+            if (m_standbyBlock)
+            {
+                m_adaptiveBlockSize = BlockAllocator::GetBlockSize(m_standbyBlock.get());
+            }
+        }
+
+        const uint32_t blockSize = ChooseBlockSize(now);
+
+        if (m_standbyBlock && BlockAllocator::GetBlockSize(m_standbyBlock.get()) != blockSize)
+        {
+            // The block size has changed since the standby block was armed
+            m_standbyBlock.reset();
+        }
+
+        // Switch to the standby block if we have one, otherwise get a new one
+        if (m_standbyBlock)
+        {
+            m_currentBlock = std::move(m_standbyBlock);
+            m_currentBlock->cpuHeader.beginTimestamp = now;
+        }
+        else
+        {
+            m_currentBlock = BlockAllocator::Allocate(now, blockSize);
+        }
+
         if (!m_currentBlock)
         {
-            // We failed to allocate a new block
+            // We failed to allocate a new block. Flush cleared our
+            // PIXEventsThreadInfo, so callers need to come back through
+            // GetPixEventsThreadInfo to try again.
+            Increment(m_allocationFailures, 1);
+            InvalidateThreadInfoCaches();
             return 0;
         }
 
@@ -110,15 +188,79 @@ namespace WinPixEventRuntime
         m_pixEventsThreadInfo.destination = reinterpret_cast<uint64_t*>(m_currentBlock->pPIXCurrent);
         m_pixEventsThreadInfo.biasedLimit = reinterpret_cast<uint64_t*>(m_currentBlock->pPIXLimit) - PIXEventsReservedRecordSpaceQwords;
 
-        return m_currentBlock->cpuHeader.beginTimestamp;        
+        m_liveBlock.store(m_currentBlock.get(), std::memory_order_release);
+
+        // Arm the standby block for next time. This normally comes from this
+        // thread's cache of free blocks, which the worker keeps stocked, so it
+        // doesn't go to the heap or take a lock. If it fails we'll try again
+        // on the next replacement.
+        m_standbyBlock = BlockAllocator::Allocate(now, blockSize);
+
+        m_blockSize.store(blockSize, std::memory_order_relaxed);
+        Increment(m_replacementCount, 1);
+
+        return m_currentBlock->cpuHeader.beginTimestamp;
+    }
+
+
+    uint32_t ThreadData::ChooseBlockSize(uint64_t now)
+    {
+        uint32_t blockSize = GetEventBlockSize();
+
+        if (blockSize == AdaptiveBlockSize)
+        {
+            // Threads that fill blocks quickly get bigger blocks, so they hand
+            // off fewer of them. Threads that take a long time to fill a block
+            // get smaller ones, so they hold on to less memory.
+            if (m_lastReplaceTime != 0)
+            {
+                static const uint64_t frequency = []
+                {
+                    LARGE_INTEGER f = {};
+                    QueryPerformanceFrequency(&f);
+                    return static_cast<uint64_t>(f.QuadPart);
+                }();
+
+                constexpr uint64_t FastReplacementsPerSecond = 1000;
+                constexpr uint64_t SlowReplacementsPerSecond = 10;
+
+                const uint64_t elapsed = now - m_lastReplaceTime;
+
+                if (elapsed < frequency / FastReplacementsPerSecond && m_adaptiveBlockSize < BlockAllocator::MaxBlockSize)
+                {
+                    m_adaptiveBlockSize *= 2;
+                }
+                else if (elapsed > frequency / SlowReplacementsPerSecond && m_adaptiveBlockSize > BlockAllocator::MinBlockSize)
+                {
+                    m_adaptiveBlockSize /= 2;
+                }
+            }
+
+            blockSize = m_adaptiveBlockSize;
+        }
+
+        m_lastReplaceTime = now;
+        return blockSize;
+    }
+
+
+    ThreadBlockStatistics ThreadData::GetBlockStatistics() const
+    {
+        return {
+            m_osThreadId,
+            m_blockSize.load(std::memory_order_relaxed),
+            m_replacementCount.load(std::memory_order_relaxed),
+            m_bytesRecorded.load(std::memory_order_relaxed),
+            m_allocationFailures.load(std::memory_order_relaxed),
+        };
     }
 
 
     BlockAllocator::Block ThreadData::Flush(std::optional<uint64_t> const& eventTime)
     {
-        // !!! Potentially unsafe access to m_pixEventsThreadInfo
-        // !!! This function might be called from an arbitrary thread, while the
-        // !!! thread associated with this ThreadData might be in ReplaceBlock.
+        // Only this thread lets go of its block. Other threads use Harvest,
+        // which leaves it alone.
+        const uint32_t harvestedOffset = ReleaseLiveBlock();
 
         // Hand our current block off so it can be written to disk
         if (m_pixEventsThreadInfo.block)
@@ -127,7 +269,24 @@ namespace WinPixEventRuntime
 
             m_currentBlock->cpuHeader.endTimestamp = eventTime ? *eventTime : PIXGetTimestampCounter();
 
+            // Record how much of the block has been used so that only that
+            // much gets written out. Every event is followed by an end marker
+            // at destination.
+            auto destination = reinterpret_cast<BYTE*>(m_pixEventsThreadInfo.destination);
+            if (destination > m_currentBlock->pPIXCurrent && destination < m_currentBlock->pPIXLimit)
+            {
+                m_currentBlock->pPIXCurrent = destination;
+            }
+
+            // This includes any events that were harvested
+            Increment(m_bytesRecorded, static_cast<uint64_t>(m_currentBlock->pPIXCurrent - reinterpret_cast<BYTE*>(m_currentBlock.get() + 1)));
+
             m_pixEventsThreadInfo = {};
+
+            if (harvestedOffset != 0)
+            {
+                RemoveHarvestedEvents(harvestedOffset);
+            }
         }
         else
         {
@@ -138,6 +297,173 @@ namespace WinPixEventRuntime
     }
 
 
+    uint32_t ThreadData::ReleaseLiveBlock()
+    {
+        // Bumping the count makes any harvest of the block that hasn't
+        // committed yet fail
+        const uint64_t state = m_harvestState.load(std::memory_order_relaxed);
+        m_liveBlock.store(nullptr, std::memory_order_relaxed);
+        const uint64_t previous = m_harvestState.exchange(((state >> 32) + 1) << 32, std::memory_order_acq_rel);
+
+        return static_cast<uint32_t>(previous);
+    }
+
+
+    void ThreadData::RemoveHarvestedEvents(uint32_t harvestedOffset)
+    {
+        auto events = reinterpret_cast<BYTE*>(m_currentBlock.get() + 1);
+        auto harvested = reinterpret_cast<BYTE*>(m_currentBlock.get()) + harvestedOffset;
+
+        if (harvested >= m_currentBlock->pPIXCurrent)
+        {
+            // Everything in the block has already been written out
+            m_currentBlock.reset();
+            return;
+        }
+
+        // Move the rest of the events, and the end marker, up to the start
+        memmove(events, harvested, m_currentBlock->pPIXCurrent + sizeof(uint64_t) - harvested);
+        m_currentBlock->pPIXCurrent -= harvested - events;
+
+        auto& beginTimestamp = m_currentBlock->cpuHeader.beginTimestamp;
+        beginTimestamp = std::max(beginTimestamp, m_harvestedEventTime.load(std::memory_order_acquire));
+    }
+
+
+    bool ThreadData::PrepareHarvest(HarvestPoint& point) const
+    {
+        const uint64_t state = m_harvestState.load(std::memory_order_acquire);
+
+        auto block = m_liveBlock.load(std::memory_order_acquire);
+        if (!block)
+            return false;
+
+        const uint32_t harvestedOffset = static_cast<uint32_t>(state);
+        auto begin = reinterpret_cast<BYTE const*>(block) + (harvestedOffset != 0 ? harvestedOffset : sizeof(PEvtBlkHdr));
+        auto end = static_cast<BYTE const*>(ReadPointerNoFence(reinterpret_cast<PVOID volatile*>(const_cast<uint64_t**>(&m_pixEventsThreadInfo.destination))));
+        auto limit = block->pPIXLimit;
+        uint64_t beginTimestamp = block->cpuHeader.beginTimestamp;
+
+        // If the thread let go of the block while we were looking at it, the
+        // values we read may belong to another block. Block memory stays
+        // mapped until the allocator shuts down, so reading it is harmless,
+        // but nothing read from it can be trusted.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_harvestState.load(std::memory_order_relaxed) != state)
+            return false;
+
+        if (end <= begin || end >= limit)
+            return false;
+
+        if (static_cast<size_t>(end - begin) > BlockAllocator::MaxBlockSize - sizeof(PEvtBlkHdr) - sizeof(uint64_t))
+            return false;
+
+        if (harvestedOffset != 0)
+        {
+            beginTimestamp = std::max(beginTimestamp, m_harvestedEventTime.load(std::memory_order_relaxed));
+        }
+
+        point = { state, block, begin, end, beginTimestamp };
+        return true;
+    }
+
+
+    // Returns the full timestamps of the first and last events in [begin,
+    // end), or startTime if there aren't any. Events only carry the bottom 44
+    // bits of their timestamp, the rest comes from startTime as in
+    // BlockParser.
+    static std::pair<uint64_t, uint64_t> GetEventTimes(BYTE const* begin, BYTE const* end, uint64_t startTime, bool firstOnly)
+    {
+        std::optional<uint64_t> firstTime;
+        uint64_t lastTime = startTime;
+
+        auto event = reinterpret_cast<uint64_t const*>(begin);
+        while (event < reinterpret_cast<uint64_t const*>(end))
+        {
+            const uint64_t eventInfo = *event;
+            const uint64_t size = (eventInfo & PIXEventsSizeReadMask) >> PIXEventsSizeBitShift;
+            if (size == 0)
+                break;
+
+            // Interned strings aren't timed
+            if (((eventInfo & PIXEventsTypeReadMask) >> PIXEventsTypeBitShift) != PIXEvent_InternString)
+            {
+                uint64_t time = ((eventInfo & PIXEventsTimestampReadMask) >> PIXEventsTimestampBitShift) | (lastTime & ~PIXEventsTimestampWriteMask);
+                if (time < lastTime)
+                {
+                    time += PIXEventsTimestampWriteMask + 1;
+                }
+                lastTime = time;
+
+                if (!firstTime)
+                {
+                    firstTime = time;
+                    if (firstOnly)
+                        break;
+                }
+            }
+
+            event += size;
+        }
+
+        return { firstTime.value_or(startTime), lastTime };
+    }
+
+
+    BlockAllocator::Block ThreadData::Harvest(HarvestPoint const& point, uint64_t staleTime)
+    {
+        // Every event we're copying was written before this
+        const uint64_t endTimestamp = PIXGetTimestampCounter();
+
+        if (staleTime != ~0ull && GetEventTimes(point.Begin, point.End, point.BeginTimestamp, true).first >= staleTime)
+            return nullptr;
+
+        const uint32_t size = static_cast<uint32_t>(point.End - point.Begin);
+
+        auto snapshot = BlockAllocator::Allocate(point.BeginTimestamp, sizeof(PEvtBlkHdr) + size + sizeof(uint64_t));
+        if (!snapshot)
+            return nullptr;
+
+        auto events = snapshot->pPIXCurrent;
+        memcpy(events, point.Begin, size);
+        snapshot->pPIXCurrent += size;
+        *reinterpret_cast<uint64_t*>(snapshot->pPIXCurrent) = PIXEventsBlockEndMarker;
+
+        snapshot->cpuHeader.threadId = m_osThreadId;
+        snapshot->cpuHeader.endTimestamp = endTimestamp;
+
+        // Only keep the copy if the thread still had the block throughout.
+        // From now on the thread leaves these events out when it lets go of
+        // the block.
+        uint64_t expected = point.State;
+        const uint64_t harvestedState = (point.State & ~0xffffffffull) | static_cast<uint32_t>(point.End - reinterpret_cast<BYTE const*>(point.Block));
+        if (!m_harvestState.compare_exchange_strong(expected, harvestedState, std::memory_order_acq_rel))
+            return nullptr;
+
+        // If the thread lets go of the block before it sees this, it uses an
+        // earlier time, which BlockParser copes with.
+        m_harvestedEventTime.store(GetEventTimes(events, snapshot->pPIXCurrent, point.BeginTimestamp, false).second, std::memory_order_release);
+
+        return snapshot;
+    }
+
+
+    BlockAllocator::Block ThreadData::Harvest()
+    {
+        HarvestPoint point;
+        if (!PrepareHarvest(point))
+            return nullptr;
+
+        // The thread stores destination after it has written each event (see
+        // PIXEventsPublishBarrier). Once every processor has flushed its
+        // writes, the events before the destination we read are visible here
+        // too, without the thread needing a fence of its own.
+        FlushProcessWriteBuffers();
+
+        return Harvest(point);
+    }
+
+
     void ThreadData::SetEnabled(bool isEnabled)
     {
         // We take note of this here, but only really respond to it the next time
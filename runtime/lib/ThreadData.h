@@ -12,11 +12,48 @@
 
 namespace WinPixEventRuntime
 {
+    struct ThreadBlockStatistics;
+
     class ThreadData
     {
         PIXEventsThreadInfo m_pixEventsThreadInfo = {};
         BlockAllocator::Block m_currentBlock;
+
+        // The block that the next ReplaceBlock switches to, allocated ahead of
+        // time so that the switch itself doesn't need to allocate.
+        BlockAllocator::Block m_standbyBlock;
+
+        // Block size and replacement tracking. These are only written by this
+        // thread, the atomics are also read by GetBlockStatistics. They're
+        // only updated when the thread changes blocks, never per event, and
+        // with plain loads and stores rather than interlocked operations.
+        uint32_t m_adaptiveBlockSize = BlockAllocator::MinBlockSize;
+        uint64_t m_lastReplaceTime = 0;
+        std::atomic<uint32_t> m_blockSize = 0;
+        std::atomic<uint64_t> m_replacementCount = 0;
+        std::atomic<uint64_t> m_bytesRecorded = 0;
+        std::atomic<uint64_t> m_allocationFailures = 0;
+        uint32_t m_osThreadId = 0;
         std::atomic<bool> m_isEnabled = false;
+
+        // Where this thread is in Threads, so that it can be removed without
+        // searching for it. Only Threads uses this, under its owner's lock.
+        size_t m_registryIndex = 0;
+
+        // Other threads can copy the events out of the current block while
+        // this thread carries on writing to it (see Harvest). The top 32 bits
+        // of m_harvestState count the blocks this thread has let go of, and
+        // the bottom 32 are the offset into the current block that it has been
+        // harvested up to, or 0 if it hasn't been. Only this thread touches
+        // m_currentBlock and m_pixEventsThreadInfo, and nothing on the path
+        // that writes events is atomic.
+        std::atomic<PEvtBlkHdr*> m_liveBlock = nullptr;
+        std::atomic<uint64_t> m_harvestState = 0;
+
+        // The time of the last event that was harvested. It becomes the
+        // beginTimestamp of whatever is left of the block, since BlockParser
+        // needs that to be no later than the first event.
+        std::atomic<uint64_t> m_harvestedEventTime = 0;
         
         static_assert(std::atomic<bool>::is_always_lock_free);
 #if DBG
@@ -29,13 +66,56 @@ namespace WinPixEventRuntime
 
         PIXEventsThreadInfo* GetPixEventsThreadInfo();
 
+        // Points at a flag that's set once the calling thread's ThreadData
+        // has been destroyed, and cleared when it gets a new one.
+        static const volatile uint32_t* GetThreadExitedFlag();
+
         static uint64_t ReplaceBlock(PIXEventsThreadInfo* threadInfo, std::optional<uint64_t> const& eventTime);
 
         void SetEnabled(bool isEnabled);
         BlockAllocator::Block Flush(std::optional<uint64_t> const& eventTime);
+        ThreadBlockStatistics GetBlockStatistics() const;
+
+        size_t GetRegistryIndex() const { return m_registryIndex; }
+        void SetRegistryIndex(size_t index) { m_registryIndex = index; }
+
+        // Harvesting returns a block holding a copy of the events this thread
+        // has written to its current block since it was last harvested,
+        // without stopping the thread. It returns a null block if there aren't
+        // any, or if the thread let go of the block while it was being copied,
+        // in which case the events get written out with the block. It can be
+        // done from any thread while this one is registered, but only one
+        // thread at a time.
+        //
+        // It's done in two steps so that harvesting several threads only
+        // needs one FlushProcessWriteBuffers (see Threads::Harvest), which
+        // must be called between them.
+        struct HarvestPoint
+        {
+            uint64_t State;
+            PEvtBlkHdr const* Block;
+            BYTE const* Begin;
+            BYTE const* End;
+            uint64_t BeginTimestamp;
+        };
+
+        // PrepareHarvest returns false if there's nothing to harvest. With a
+        // staleTime, Harvest leaves the events alone unless the first of them
+        // is older than that.
+        bool PrepareHarvest(HarvestPoint& point) const;
+        BlockAllocator::Block Harvest(HarvestPoint const& point, uint64_t staleTime = ~0ull);
+        BlockAllocator::Block Harvest();
 
     private:
         static ThreadData* GetFromThreadInfo(PIXEventsThreadInfo* threadInfo);
         uint64_t ReplaceBlock(std::optional<uint64_t> const& eventTime);
+        uint32_t ChooseBlockSize(uint64_t now);
+        uint32_t ReleaseLiveBlock();
+        void RemoveHarvestedEvents(uint32_t harvestedOffset);
+
+        static void Increment(std::atomic<uint64_t>& counter, uint64_t amount)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
     };
 }
@@ -3,6 +3,12 @@
 
 #include "ThreadedWorker.h"
 
+#include "LatencyHistogram.h"
+#include "WinPixEventRuntime.h"
+
+#include <algorithm>
+#include <utility>
+
 namespace WinPixEventRuntime
 {    
     ThreadedWorker::ThreadedWorker() = default;
@@ -53,7 +59,8 @@ namespace WinPixEventRuntime
         m_worker = std::thread(
             [=] {
                 (void)SetThreadDescription(GetCurrentThread(), L"PixEvent worker");
-                Worker(); 
+                Worker();
+                BlockAllocator::ReleaseThreadCache();
             }
         );
     }
@@ -71,60 +78,455 @@ namespace WinPixEventRuntime
 
             m_worker.join();
 
-            // Write out any other blocks that managed to get added
+            // Write out any other blocks that managed to get added. This pairs
+            // with the fence in Add.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
             lock = m_srwlock.lock_exclusive();
 
-            for (auto& block : m_pendingBlocks)
+            // The queue only supports one consumer at a time, so leave it to
+            // the new worker if Add restarted one while we were joining.
+            if (!m_worker.joinable())
             {
-                WriteBlock(std::move(block));
+                WriteQueuedBlocks();
+                m_cv.notify_all();
             }
-            m_pendingBlocks.clear();
         }
     }
 
 
     void ThreadedWorker::Add(BlockAllocator::Block block)
+    {
+        LatencyTimer timer(LatencyOperation::WorkerAdd);
+
+        if (block)
+        {
+            // Once blocks have overflowed, the rest follow them until the
+            // worker has picked them up, so that each thread's blocks stay in
+            // order.
+            if (!m_hasOverflowBlocks.load() && m_queue.TryPush(block))
+            {
+                auto previous = m_queuedBlocks.fetch_add(1);
+                if (previous == 0 || previous + 1 == WakeHighWaterMark)
+                {
+                    Wake();
+                }
+
+                // Racing threads can leave this short of the true maximum,
+                // which is good enough for statistics and keeps Add from
+                // looping.
+                if (previous + 1 > m_maxQueuedBlocks.load(std::memory_order_relaxed))
+                {
+                    m_maxQueuedBlocks.store(previous + 1, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                // The worker has fallen a long way behind.
+                {
+                    auto overflowLock = m_overflowLock.lock_exclusive();
+                    m_overflowBlocks.push_back(std::move(block));
+                    m_hasOverflowBlocks = true;
+                    m_overflowBlockCount.fetch_add(1, std::memory_order_relaxed);
+                }
+                Wake();
+            }
+        }
+
+        // This pairs with Stop setting m_requestStop before it writes out the
+        // queued blocks: either Stop sees our block, or we see m_requestStop.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (m_requestStop)
+        {
+            auto lock = m_srwlock.lock_exclusive();
+
+            // If the worker has been stopped and fully joined, restart it so
+            // the block we just added gets processed. Only restart when the
+            // thread is not joinable (i.e. already joined by Stop/Start) to
+            // avoid racing with another thread that is mid-join.
+            if (m_requestStop && !m_worker.joinable())
+            {
+                DoStart();
+            }
+        }
+    }
+
+
+    void ThreadedWorker::SetFlightRecorderSize(size_t maxBytes)
+    {
+        {
+            auto lock = m_flightRecorderLock.lock_exclusive();
+            m_flightRecorderSize = maxBytes;
+        }
+        m_hasFlightRecorderRequest = true;
+        Wake();
+    }
+
+
+    void ThreadedWorker::SetLiveCapture(bool isLive)
+    {
+        m_isLiveCapture = isLive;
+    }
+
+
+    void ThreadedWorker::TriggerFlightRecorder(std::vector<BlockAllocator::Block> headerBlocks)
+    {
+        {
+            auto lock = m_flightRecorderLock.lock_exclusive();
+            m_isFlightRecorderTriggered = true;
+            for (auto& block : headerBlocks)
+            {
+                m_triggerHeaderBlocks.push_back(std::move(block));
+            }
+        }
+        m_hasFlightRecorderRequest = true;
+        Wake();
+    }
+
+
+    uint64_t ThreadedWorker::AddFence()
+    {
+        // This pairs with WriteQueuedBlocks reading m_requestedFence before
+        // it looks at the queue, so the blocks already added are seen.
+        const uint64_t fence = m_requestedFence.fetch_add(1) + 1;
+        Wake();
+        return fence;
+    }
+
+
+    void ThreadedWorker::WaitForFence(uint64_t fence)
     {
         auto lock = m_srwlock.lock_exclusive();
 
-        m_pendingBlocks.push_back(std::move(block));
+        while (m_completedFence < fence)
+        {
+            // With no worker running, write the blocks out here instead, as
+            // Stop does.
+            if (!m_worker.joinable())
+            {
+                WriteQueuedBlocks();
+                break;
+            }
+
+            m_cv.wait(lock);
+        }
+    }
+
+
+    void ThreadedWorker::SetHarvestInterval(uint32_t milliseconds)
+    {
+        m_harvestInterval = milliseconds;
+        Wake();
+    }
+
+
+    void ThreadedWorker::SetStatisticsInterval(uint32_t milliseconds)
+    {
+        m_statisticsInterval = milliseconds;
+        Wake();
+    }
+
+
+    void ThreadedWorker::GetStatistics(PEvtStatsBlk& statistics)
+    {
+        statistics.QueuedBlocks = static_cast<uint64_t>(std::max(m_queuedBlocks.load(std::memory_order_relaxed), 0));
+        statistics.MaxQueuedBlocks = static_cast<uint64_t>(m_maxQueuedBlocks.load(std::memory_order_relaxed));
+        statistics.OverflowBlocks = m_overflowBlockCount.load(std::memory_order_relaxed);
+        statistics.DroppedBlocks = m_droppedBlocks.load(std::memory_order_relaxed);
+    }
+
+
+    void ThreadedWorker::SetNumaNode(uint32_t node)
+    {
+        m_numaNode = node;
+        Wake();
+    }
+
+
+    // Calls task if interval has passed since it was last called, and returns
+    // how long until it's next due.
+    static DWORD RunIfDue(uint32_t interval, uint64_t& nextTime, uint64_t now, void (*task)() noexcept)
+    {
+        if (interval == 0)
+            return INFINITE;
+
+        if (now >= nextTime)
+        {
+            task();
+            nextTime = now + interval;
+        }
+
+        return static_cast<DWORD>(std::min<uint64_t>(nextTime - now, interval));
+    }
+
+
+    DWORD ThreadedWorker::RunPeriodicTasks()
+    {
+        const uint64_t now = GetTickCount64();
+
+        // These hand their blocks to Add, so they get written out along with
+        // the rest of the queue.
+        const DWORD harvestTimeout = RunIfDue(m_harvestInterval.load(), m_nextHarvestTime, now, HarvestStaleBlocks);
+        const DWORD statisticsTimeout = RunIfDue(m_statisticsInterval.load(), m_nextStatisticsTime, now, WriteStatistics);
+
+        return std::min(harvestTimeout, statisticsTimeout);
+    }
+
+
+    void ThreadedWorker::Wake()
+    {
+        auto lock = m_srwlock.lock_exclusive();
+        m_wakeRequested = true;
         m_cv.notify_all();
+    }
+
 
-        // If the worker has been stopped and fully joined, restart it so
-        // the block we just added gets processed. Only restart when the
-        // thread is not joinable (i.e. already joined by Stop/Start) to
-        // avoid racing with another thread that is mid-join.
-        if (m_requestStop && !m_worker.joinable())
+    bool ThreadedWorker::WriteQueuedBlocks()
+    {
+        const uint64_t fence = m_requestedFence.load();
+
+        // Pick up flight recorder requests before looking at the queue, so
+        // that a trigger covers every block that was added before it.
+        bool isTriggered = false;
+        std::vector<BlockAllocator::Block> headerBlocks;
+        if (m_hasFlightRecorderRequest.exchange(false))
         {
-            DoStart();
+            auto lock = m_flightRecorderLock.lock_exclusive();
+            m_flightRecorder.SetSize(m_flightRecorderSize);
+            isTriggered = std::exchange(m_isFlightRecorderTriggered, false);
+            std::swap(headerBlocks, m_triggerHeaderBlocks);
         }
+
+        int32_t written = 0;
+        while (auto block = m_queue.TryPop())
+        {
+            m_pendingBlocks.push_back(std::move(block));
+            ++written;
+        }
+
+        if (m_hasOverflowBlocks)
+        {
+            std::vector<BlockAllocator::Block> overflowBlocks;
+            {
+                auto overflowLock = m_overflowLock.lock_exclusive();
+                std::swap(overflowBlocks, m_overflowBlocks);
+                m_hasOverflowBlocks = false;
+            }
+
+            for (auto& block : overflowBlocks)
+            {
+                m_pendingBlocks.push_back(std::move(block));
+            }
+        }
+
+        if (m_flightRecorder.IsEnabled())
+        {
+            // A live capture gets the blocks too. They're copied as they're
+            // written, since the recorder hangs on to them.
+            const bool isLiveCapture = m_isLiveCapture.load();
+            for (auto& block : m_pendingBlocks)
+            {
+                if (isLiveCapture)
+                {
+                    m_packer.WriteCopy(block.get());
+                }
+                m_flightRecorder.Add(std::move(block));
+            }
+        }
+        else if (m_pendingBlocks.size() >= ParallelWriteThreshold)
+        {
+            WriteInParallel();
+        }
+        else
+        {
+            for (auto& block : m_pendingBlocks)
+            {
+                m_packer.Write(std::move(block));
+            }
+        }
+        m_pendingBlocks.clear();
+        m_droppedBlocks.store(m_flightRecorder.GetDroppedBlockCount(), std::memory_order_relaxed);
+
+        if (isTriggered)
+        {
+            for (auto& block : headerBlocks)
+            {
+                m_packer.Write(std::move(block));
+            }
+
+            for (auto& block : m_flightRecorder.TakeBlocks())
+            {
+                m_packer.Write(std::move(block));
+            }
+        }
+
+        m_packer.Flush();
+
+        m_queuedBlocks.fetch_sub(written);
+
+        if (fence <= m_completedFence)
+            return false;
+
+        m_completedFence = fence;
+        return true;
+    }
+
+
+    // Interned string blocks are the only ones that start with an
+    // InternString event (see InternedStrings::Write).
+    static bool IsInternedStringBlock(PEvtBlkHdr const* block)
+    {
+        if (block->BlockType != PIXEVT_CPU_BLOCK || block->pPIXCurrent == reinterpret_cast<BYTE const*>(block + 1))
+            return false;
+
+        const uint64_t eventInfo = *reinterpret_cast<uint64_t const*>(block + 1);
+        return ((eventInfo & PIXEventsTypeReadMask) >> PIXEventsTypeBitShift) == PIXEvent_InternString;
+    }
+
+
+    void ThreadedWorker::WriteInParallel()
+    {
+        if (!m_parallelWork)
+        {
+            m_parallelWork.reset(CreateThreadpoolWork(ParallelWriteCallback, this, nullptr));
+        }
+
+        // If the thread pool isn't available this thread writes everything
+        m_partitionCount = m_parallelWork ? std::min(m_pendingBlocks.size() / ParallelWriteThreshold + 1, MaxParallelWriters) : 1;
+
+        // Events can use any string that was interned before them, so the
+        // strings are written out before the parts are handed out.
+        for (auto& block : m_pendingBlocks)
+        {
+            if (IsInternedStringBlock(block.get()))
+            {
+                m_packer.Write(std::move(block));
+            }
+            else
+            {
+                // Thread ids are multiples of 4
+                const size_t partition = (block->cpuHeader.threadId >> 2) % m_partitionCount;
+                m_partitions[partition].push_back(std::move(block));
+            }
+        }
+        m_packer.Flush();
+
+        m_nextPartition = 0;
+        for (size_t i = 1; i < m_partitionCount; ++i)
+        {
+            SubmitThreadpoolWork(m_parallelWork.get());
+        }
+
+        WritePartitions(m_packer);
+
+        if (m_partitionCount > 1)
+        {
+            WaitForThreadpoolWorkCallbacks(m_parallelWork.get(), FALSE);
+        }
+    }
+
+
+    void ThreadedWorker::WritePartitions(BlockAllocator::BlockPacker& packer)
+    {
+        for (;;)
+        {
+            const size_t partition = m_nextPartition.fetch_add(1);
+            if (partition >= m_partitionCount)
+                break;
+
+            for (auto& block : m_partitions[partition])
+            {
+                packer.Write(std::move(block));
+            }
+            m_partitions[partition].clear();
+        }
+    }
+
+
+    void CALLBACK ThreadedWorker::ParallelWriteCallback(PTP_CALLBACK_INSTANCE, void* context, PTP_WORK)
+    {
+        auto worker = static_cast<ThreadedWorker*>(context);
+
+        {
+            BlockAllocator::BlockPacker packer;
+            worker->WritePartitions(packer);
+            packer.Flush();
+        }
+
+        // Thread pool threads come and go, so don't leave blocks cached here
+        BlockAllocator::ReleaseThreadCache();
+    }
+
+
+    void ThreadedWorker::MoveToNumaNode(uint32_t node, GROUP_AFFINITY const& originalAffinity)
+    {
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP | WINAPI_PARTITION_SYSTEM)
+        GROUP_AFFINITY affinity = originalAffinity;
+        if (node != AnyNumaNode)
+        {
+            // If the node doesn't exist, or has no processors, the worker
+            // stays where it is.
+            affinity = {};
+            if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) || affinity.Mask == 0)
+                return;
+        }
+
+        (void)SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#else
+        // Apps can't see the machine's NUMA topology.
+        (void)node;
+        (void)originalAffinity;
+#endif
     }
 
 
     void ThreadedWorker::Worker()
     {
-        auto lock = m_srwlock.lock_exclusive();
+        GROUP_AFFINITY originalAffinity = {};
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP | WINAPI_PARTITION_SYSTEM)
+        (void)GetThreadGroupAffinity(GetCurrentThread(), &originalAffinity);
+#endif
+        uint32_t numaNode = AnyNumaNode;
 
-        do
+        for (;;)
         {
-            // We work from m_pendingBlocksBackBuffer.  We persist both of these so that
-            // we don't need to reallocate memory for them.
-            std::swap(m_pendingBlocks, m_pendingBlocksBackBuffer);
-            lock.reset();
+            // Writing blocks out touches every byte of them, so it's best done
+            // on the node that the threads writing events are on.
+            if (const uint32_t requestedNode = m_numaNode.load(); requestedNode != numaNode)
+            {
+                MoveToNumaNode(requestedNode, originalAffinity);
+                numaNode = requestedNode;
+            }
+
+            const DWORD timeout = RunPeriodicTasks();
+
+            const bool completedFence = WriteQueuedBlocks();
+
+            // Now that the written blocks have been freed, top up the free
+            // blocks so the threads writing events don't have to.
+            BlockAllocator::Replenish();
 
-            for (auto& block : m_pendingBlocksBackBuffer)
+            auto lock = m_srwlock.lock_exclusive();
+
+            if (completedFence)
             {
-                WriteBlock(std::move(block));
+                m_cv.notify_all();
             }
-            m_pendingBlocksBackBuffer.clear();
 
-            lock = m_srwlock.lock_exclusive();
-            
-            while (!m_requestStop && m_pendingBlocks.empty())
+            if (m_requestStop)
+                break;
+
+            // A block that was pushed after we looked at the queue will have
+            // requested a wake, unless the count shows that it's still there.
+            if (m_queuedBlocks > 0 || m_hasOverflowBlocks || m_requestedFence > m_completedFence)
+                continue;
+
+            while (!m_requestStop && !m_wakeRequested)
             {
-                m_cv.wait(lock);
+                if (!m_cv.wait_for(lock, timeout))
+                    break;
             }
-            
-        } while (!m_requestStop);
+            m_wakeRequested = false;
+        }
     }
 }
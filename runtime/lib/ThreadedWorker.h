@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include "BlockQueue.h"
+#include "FlightRecorder.h"
 #include "Worker.h"
 
 #include <wil/resource.h>
@@ -18,12 +20,76 @@ namespace WinPixEventRuntime
     {
         wil::srwlock m_srwlock;
         wil::condition_variable m_cv;
+        bool m_wakeRequested = false;
 
         std::thread m_worker;
         std::atomic<bool> m_requestStop = true;
 
+        // Blocks are handed to the worker through m_queue without taking any
+        // locks. m_queuedBlocks counts the blocks that have been pushed but
+        // not yet written, the worker is only woken up when this goes from 0
+        // to 1, or when it reaches WakeHighWaterMark.
+        BlockQueue m_queue;
+        std::atomic<int32_t> m_queuedBlocks = 0;
+
+        // The most blocks there have been in m_queue at once.
+        std::atomic<int32_t> m_maxQueuedBlocks = 0;
+
+        static constexpr int32_t WakeHighWaterMark = BlockQueue::Capacity / 2;
+
+        // Blocks that didn't fit in m_queue.
+        wil::srwlock m_overflowLock;
+        std::vector<BlockAllocator::Block> m_overflowBlocks;
+        std::atomic<bool> m_hasOverflowBlocks = false;
+        std::atomic<uint64_t> m_overflowBlockCount = 0;
+
+        // Flight recorder requests, picked up by whichever thread writes out
+        // the queued blocks next.
+        wil::srwlock m_flightRecorderLock;
+        size_t m_flightRecorderSize = 0;
+        bool m_isFlightRecorderTriggered = false;
+        std::vector<BlockAllocator::Block> m_triggerHeaderBlocks;
+        std::atomic<bool> m_hasFlightRecorderRequest = false;
+
+        // While the flight recorder is on, blocks are only written out as
+        // well as recorded when this is set.
+        std::atomic<bool> m_isLiveCapture = false;
+
+        // Whichever thread writes out the queued blocks completes every fence
+        // that was requested before it started. Waiters use m_cv.
+        std::atomic<uint64_t> m_requestedFence = 0;
+        std::atomic<uint64_t> m_completedFence = 0;
+
+        // How often the worker calls HarvestStaleBlocks and WriteStatistics,
+        // if at all.
+        std::atomic<uint32_t> m_harvestInterval = 0;
+        uint64_t m_nextHarvestTime = 0;
+        std::atomic<uint32_t> m_statisticsInterval = 0;
+        uint64_t m_nextStatisticsTime = 0;
+
+        // The NUMA node the worker thread should run on. The worker moves
+        // itself, so it only ever changes its own affinity.
+        std::atomic<uint32_t> m_numaNode = AnyNumaNode;
+
+        // Only used by whichever thread is writing out the queued blocks.
+        BlockAllocator::BlockPacker m_packer;
+        FlightRecorder m_flightRecorder;
         std::vector<BlockAllocator::Block> m_pendingBlocks;
-        std::vector<BlockAllocator::Block> m_pendingBlocksBackBuffer;
+
+        // A copy of m_flightRecorder's count, for GetStatistics.
+        std::atomic<uint64_t> m_droppedBlocks = 0;
+
+        // When a backlog builds up, thread pool threads help to write it out,
+        // each with their own packer. The blocks are split up by the thread
+        // that recorded them, and each part is written by one writer, so every
+        // thread's blocks stay in order. Interned string blocks are written
+        // before any of them.
+        static constexpr size_t ParallelWriteThreshold = 256;
+        static constexpr size_t MaxParallelWriters = 4;
+        wil::unique_threadpool_work_nocancel m_parallelWork;
+        std::vector<BlockAllocator::Block> m_partitions[MaxParallelWriters];
+        size_t m_partitionCount = 0;
+        std::atomic<size_t> m_nextPartition = 0;
 
     public:
         ThreadedWorker();
@@ -32,9 +98,25 @@ namespace WinPixEventRuntime
         virtual void Start() override;
         virtual void Stop() override;
         virtual void Add(BlockAllocator::Block block) override;
+        virtual void SetFlightRecorderSize(size_t maxBytes) override;
+        virtual void SetLiveCapture(bool isLive) override;
+        virtual void TriggerFlightRecorder(std::vector<BlockAllocator::Block> headerBlocks) override;
+        virtual uint64_t AddFence() override;
+        virtual void WaitForFence(uint64_t fence) override;
+        virtual void SetHarvestInterval(uint32_t milliseconds) override;
+        virtual void SetStatisticsInterval(uint32_t milliseconds) override;
+        virtual void GetStatistics(PEvtStatsBlk& statistics) override;
+        virtual void SetNumaNode(uint32_t node) override;
 
     private:
         void DoStart();
+        void Wake();
+        DWORD RunPeriodicTasks();
+        bool WriteQueuedBlocks();
+        void WriteInParallel();
+        void WritePartitions(BlockAllocator::BlockPacker& packer);
+        static void CALLBACK ParallelWriteCallback(PTP_CALLBACK_INSTANCE, void* context, PTP_WORK);
+        static void MoveToNumaNode(uint32_t node, GROUP_AFFINITY const& originalAffinity);
         
         void Worker();
     };    
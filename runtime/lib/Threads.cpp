@@ -4,6 +4,10 @@
 #include "Threads.h"
 
 #include "ThreadData.h"
+#include "WinPixEventRuntime.h"
+#include "Worker.h"
+
+#include <utility>
 
 namespace WinPixEventRuntime
 {
@@ -12,6 +16,7 @@ namespace WinPixEventRuntime
 
     void Threads::Add(ThreadData* thread, bool isEnabled)
     {
+        thread->SetRegistryIndex(m_threads.size());
         m_threads.push_back(thread);
         UpdateThread(thread, isEnabled);
     }
@@ -19,10 +24,20 @@ namespace WinPixEventRuntime
 
     void Threads::Remove(ThreadData* thread)
     {
-        if (!m_threads.empty())
-        {
-            m_threads.erase(std::remove_if(m_threads.begin(), m_threads.end(), [=](auto* o) { return o == thread; }));
-        }
+        const size_t index = thread->GetRegistryIndex();
+        if (index >= m_threads.size() || m_threads[index] != thread)
+            return;
+
+        // The order doesn't matter, so the last thread fills the gap, which
+        // keeps this the same cost however many threads there are.
+        m_threads[index] = m_threads.back();
+        m_threads[index]->SetRegistryIndex(index);
+        m_threads.pop_back();
+
+        const auto statistics = thread->GetBlockStatistics();
+        m_exitedReplacements += statistics.Replacements;
+        m_exitedBytesRecorded += statistics.BytesRecorded;
+        m_exitedAllocationFailures += statistics.AllocationFailures;
     }
 
 
@@ -41,11 +56,56 @@ namespace WinPixEventRuntime
     }
 
 
-    void Threads::Flush(uint64_t eventTime) const
+    void Threads::Harvest(Worker& worker, uint64_t staleTime) const
+    {
+        std::vector<std::pair<ThreadData*, ThreadData::HarvestPoint>> points;
+        points.reserve(m_threads.size());
+
+        for (auto* thread : m_threads)
+        {
+            ThreadData::HarvestPoint point;
+            if (thread->PrepareHarvest(point))
+            {
+                points.emplace_back(thread, point);
+            }
+        }
+
+        if (points.empty())
+            return;
+
+        // One flush covers every thread (see ThreadData::Harvest)
+        FlushProcessWriteBuffers();
+
+        for (auto const& [thread, point] : points)
+        {
+            worker.Add(thread->Harvest(point, staleTime));
+        }
+    }
+
+
+    void Threads::GetBlockStatistics(std::vector<ThreadBlockStatistics>& statistics) const
     {
+        statistics.reserve(statistics.size() + m_threads.size());
+        for (auto* thread : m_threads)
+        {
+            statistics.push_back(thread->GetBlockStatistics());
+        }
+    }
+
+
+    void Threads::GetStatistics(PEvtStatsBlk& statistics) const
+    {
+        statistics.Threads = m_threads.size();
+        statistics.BlockReplacements = m_exitedReplacements;
+        statistics.BytesRecorded = m_exitedBytesRecorded;
+        statistics.AllocationFailures = m_exitedAllocationFailures;
+
         for (auto* thread : m_threads)
         {
-            WriteBlock(thread->Flush(eventTime));
+            const auto threadStatistics = thread->GetBlockStatistics();
+            statistics.BlockReplacements += threadStatistics.Replacements;
+            statistics.BytesRecorded += threadStatistics.BytesRecorded;
+            statistics.AllocationFailures += threadStatistics.AllocationFailures;
         }
     }
 }
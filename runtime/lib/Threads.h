@@ -3,16 +3,26 @@
 
 #pragma once
 
+#include <shared/PEvtBlk.h>
+
 #include <vector>
 
 namespace WinPixEventRuntime
 {
     class ThreadData;
+    class Worker;
+    struct ThreadBlockStatistics;
 
     class Threads
     {
         std::vector<ThreadData*> m_threads;
 
+        // The counts from threads that have gone, so that the totals in
+        // GetStatistics don't go backwards.
+        uint64_t m_exitedReplacements = 0;
+        uint64_t m_exitedBytesRecorded = 0;
+        uint64_t m_exitedAllocationFailures = 0;
+
     public:
         Threads();
         ~Threads();
@@ -20,7 +30,18 @@ namespace WinPixEventRuntime
         void Add(ThreadData* thread, bool isEnabled);
         void Remove(ThreadData* thread);
         void UpdateThreads(bool isEnabled);
-        void Flush(uint64_t eventTime) const;
+
+        // Hands the worker copies of the events that threads have written to
+        // their current blocks (see ThreadData::Harvest). With a staleTime,
+        // only events from threads that have been holding on to them since
+        // before then are harvested.
+        void Harvest(Worker& worker, uint64_t staleTime = ~0ull) const;
+
+        void GetBlockStatistics(std::vector<ThreadBlockStatistics>& statistics) const;
+
+        // Fills in the counts that threads keep, totalled over every thread
+        // there has been.
+        void GetStatistics(PEvtStatsBlk& statistics) const;
 
     private:
         void UpdateThread(ThreadData* thread, bool isEnabled);
@@ -5,6 +5,9 @@
 
 #include "BlockAllocator.h"
 #include "IncludePixEtw.h"
+#include "InternedStrings.h"
+#include "LatencyHistogram.h"
+#include "MappedFileSink.h"
 #include "ThreadData.h"
 #include "Threads.h"
 #include "Worker.h"
@@ -15,15 +18,91 @@
 
 #include <wil/resource.h>
 
+#include <atomic>
+
 namespace WinPixEventRuntime
 {
+    // The capture file, if there is one. Writers take the lock shared, so
+    // they only hold each other up when it's being opened or closed.
+    static wil::srwlock g_captureFileLock;
+    static std::unique_ptr<MappedFileSink> g_captureFile;
+
+
+    // Counted as blocks are written out, by the worker and the thread pool
+    // threads that help it.
+    static std::atomic<uint64_t> g_writtenEvents = 0;
+    static std::atomic<uint64_t> g_writtenBlocks = 0;
+    static std::atomic<uint64_t> g_writtenBytes = 0;
+    static std::atomic<uint64_t> g_writes = 0;
+
+    void RecordBlockWrite(uint32_t blocks, uint64_t events, uint64_t bytes) noexcept
+    {
+        g_writtenEvents.fetch_add(events, std::memory_order_relaxed);
+        g_writtenBlocks.fetch_add(blocks, std::memory_order_relaxed);
+        g_writtenBytes.fetch_add(bytes, std::memory_order_relaxed);
+        g_writes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+
+    // Gathers the blocks handed to it rather than writing them out.
+    class BlockCollector final : public Worker
+    {
+    public:
+        std::vector<BlockAllocator::Block> Blocks;
+
+        virtual void Start() override {}
+        virtual void Stop() override {}
+        virtual void Add(BlockAllocator::Block block) override { Blocks.push_back(std::move(block)); }
+        virtual uint64_t AddFence() override { return 0; }
+        virtual void WaitForFence(uint64_t) override {}
+        virtual void SetHarvestInterval(uint32_t) override {}
+        virtual void SetStatisticsInterval(uint32_t) override {}
+        virtual void GetStatistics(PEvtStatsBlk&) override {}
+        virtual void SetNumaNode(uint32_t) override {}
+        virtual void SetFlightRecorderSize(size_t) override {}
+        virtual void SetLiveCapture(bool) override {}
+        virtual void TriggerFlightRecorder(std::vector<BlockAllocator::Block>) override {}
+    };
+
+
     class EtwWriter
     {
         mutable wil::srwlock m_srwlock;
 
         Threads m_threads;
+        InternedStrings m_internedStrings;
         std::unique_ptr<Worker> m_worker = CreateWorker();
         bool m_isEnabled = false;
+
+        // Events are recorded while ETW has the provider enabled, or while
+        // the flight recorder is on. In the second case the worker keeps the
+        // blocks in memory until the flight recorder is triggered, and also
+        // writes them out if ETW has the provider enabled too.
+        size_t m_flightRecorderSize = 0;
+
+        // Likewise while there's a capture file open.
+        bool m_isWritingToFile = false;
+
+        // While this isn't 0, the worker harvests events from blocks that
+        // threads have been holding on to for longer than half of it, every
+        // half of it, so that no event waits much longer than this.
+        uint32_t m_maxEventLatency = 0;
+
+        // m_srwlock guards the control plane (threads, interned strings,
+        // enable/disable/flush). Handing blocks to m_worker doesn't take it:
+        // the worker copes with concurrent Add/Start/Stop by itself, so all
+        // TakeBlock needs is for m_worker to outlive it. Each handoff in
+        // progress is counted in a slot picked by thread id, and the
+        // destructor closes the door to new handoffs and then waits for the
+        // counts to drain.
+        struct alignas(64) HandoffSlot
+        {
+            std::atomic<int32_t> ActiveHandoffs = 0;
+        };
+
+        static constexpr size_t HandoffSlotCount = 16;
+        HandoffSlot m_handoffSlots[HandoffSlotCount];
+        std::atomic<bool> m_isClosed = false;
         
     public:
         EtwWriter() = default;
@@ -33,18 +112,34 @@ namespace WinPixEventRuntime
             try
             {
                 Flush();
+
+                // The worker mustn't harvest from us, or ask us for
+                // statistics, while we're going away
+                m_worker->SetHarvestInterval(0);
+                m_worker->SetStatisticsInterval(0);
+                m_worker->Stop();
             }
             catch (...)
             {
                 // Swallow errors
             }
+
+            // Any block handed off after this point is freed instead.
+            m_isClosed = true;
+            for (auto& slot : m_handoffSlots)
+            {
+                while (slot.ActiveHandoffs.load() != 0)
+                {
+                    YieldProcessor();
+                }
+            }
         }
         
 
         void RegisterThread(ThreadData* thread)
         {
             auto lock = m_srwlock.lock_exclusive();
-            m_threads.Add(thread, m_isEnabled);
+            m_threads.Add(thread, IsCapturing());
         }
 
         void UnregisterThread(ThreadData* thread)
@@ -59,9 +154,14 @@ namespace WinPixEventRuntime
 
             if (!m_isEnabled)
             {
+                const bool wasCapturing = IsCapturing();
                 m_isEnabled = true;
-                m_threads.UpdateThreads(true);
-                m_worker->Start();
+                UpdateLiveCapture();
+
+                if (!wasCapturing)
+                {
+                    StartCapture();
+                }
             }
         }
 
@@ -72,35 +172,374 @@ namespace WinPixEventRuntime
             if (m_isEnabled)
             {
                 m_isEnabled = false;
-                m_threads.UpdateThreads(false);
-                m_worker->Stop();
+                UpdateLiveCapture();
+
+                if (!IsCapturing())
+                {
+                    StopCapture();
+                }
             }
         }
 
-        void Flush()
+        void SetFlightRecorderSize(size_t maxBytes)
         {
             auto lock = m_srwlock.lock_exclusive();
 
-            if (!m_isEnabled)
+            const bool wasCapturing = IsCapturing();
+            m_flightRecorderSize = maxBytes;
+            m_worker->SetFlightRecorderSize(maxBytes);
+
+            if (!wasCapturing && IsCapturing())
+            {
+                StartCapture();
+            }
+            else if (wasCapturing && !IsCapturing())
+            {
+                StopCapture();
+            }
+        }
+
+        bool OpenCaptureFile(wchar_t const* fileName, uint64_t fileSize)
+        {
+            auto lock = m_srwlock.lock_exclusive();
+
+            auto captureFile = MappedFileSink::Create(fileName, fileSize);
+            if (!captureFile)
+                return false;
+
+            WriteInternedStrings(*captureFile);
+
+            // Blocks that the worker writes from now on go to the new file
+            {
+                auto captureFileLock = g_captureFileLock.lock_exclusive();
+                std::swap(g_captureFile, captureFile);
+            }
+
+            const bool wasCapturing = IsCapturing();
+            m_isWritingToFile = true;
+            UpdateLiveCapture();
+
+            if (!wasCapturing)
+            {
+                StartCapture();
+            }
+
+            return true;
+        }
+
+        void CloseCaptureFile()
+        {
+            auto lock = m_srwlock.lock_exclusive();
+
+            if (!m_isWritingToFile)
                 return;
 
-            auto eventTime = PIXGetTimestampCounter();
-            
-            m_worker->Stop();
+            m_isWritingToFile = false;
+            UpdateLiveCapture();
 
-            m_threads.Flush(eventTime);
+            // Stopping the capture writes out the blocks the worker has been
+            // given, which should go to the file before it's closed.
+            if (!IsCapturing())
+            {
+                StopCapture();
+            }
+
+            std::unique_ptr<MappedFileSink> captureFile;
+            {
+                auto captureFileLock = g_captureFileLock.lock_exclusive();
+                std::swap(g_captureFile, captureFile);
+            }
         }
 
-        void TakeBlock(BlockAllocator::Block block)
+        bool TriggerFlightRecorder()
+        {
+            auto lock = m_srwlock.lock_exclusive();
+
+            if (m_flightRecorderSize == 0)
+                return false;
+
+            // Hand over copies of the blocks that threads are part way
+            // through so that the most recent events are included.
+            m_threads.Harvest(*m_worker);
+
+            // The blocks with the interned strings were most likely dropped
+            // long ago, so they're written again ahead of the recorded ones.
+            BlockCollector internedStrings;
+            m_internedStrings.Write(internedStrings);
+
+            m_worker->TriggerFlightRecorder(std::move(internedStrings.Blocks));
+            return true;
+        }
+
+        uint64_t Flush()
+        {
+            auto lock = m_srwlock.lock_exclusive();
+
+            if (!IsCapturing())
+                return 0;
+
+            // Copies of the partial blocks are handed to the worker like any
+            // others, which keeps it running and leaves the writing to it (or
+            // puts them in the flight recorder). The threads carry on with
+            // their blocks and leave the copied events out when they finish
+            // with them.
+            m_threads.Harvest(*m_worker);
+
+            return m_worker->AddFence();
+        }
+
+        void SetMaxEventLatency(uint32_t milliseconds)
+        {
+            auto lock = m_srwlock.lock_exclusive();
+
+            m_maxEventLatency = milliseconds;
+            m_worker->SetHarvestInterval(milliseconds / 2);
+        }
+
+        void HarvestStaleBlocks(uint64_t now)
+        {
+            // The worker calls this, so it mustn't wait for the lock: whoever
+            // has it may be waiting for the worker to stop. It'll try again
+            // next time.
+            auto lock = m_srwlock.try_lock_shared();
+            if (!lock || m_maxEventLatency == 0 || !IsCapturing())
+                return;
+
+            static const uint64_t frequency = []
+            {
+                LARGE_INTEGER f = {};
+                QueryPerformanceFrequency(&f);
+                return static_cast<uint64_t>(f.QuadPart);
+            }();
+
+            const uint64_t staleTicks = frequency * m_maxEventLatency / 2000;
+
+            m_threads.Harvest(*m_worker, now > staleTicks ? now - staleTicks : 0);
+        }
+
+        void SetStatisticsInterval(uint32_t milliseconds)
+        {
+            auto lock = m_srwlock.lock_exclusive();
+            m_worker->SetStatisticsInterval(milliseconds);
+        }
+
+        void SetWorkerNumaNode(uint32_t node)
         {
             auto lock = m_srwlock.lock_exclusive();
+            m_worker->SetNumaNode(node);
+        }
+
+        void WriteStatistics()
+        {
+            // Like HarvestStaleBlocks, the worker calls this.
+            auto lock = m_srwlock.try_lock_shared();
+            if (!lock || !IsCapturing())
+                return;
+
+            const PEvtStatsBlk statistics = GetStatistics();
+
+            // The statistics go in a block of their own, so the worker
+            // writes them out, or keeps them in the flight recorder, like any
+            // other block.
+            auto block = BlockAllocator::Allocate(std::nullopt, sizeof(PEvtBlkHdr) + sizeof(PEvtStatsBlk) + sizeof(uint64_t));
+            if (!block)
+                return;
+
+            block->BlockType = PIXEVT_STATS_BLOCK;
+            block->cpuHeader.endTimestamp = block->cpuHeader.beginTimestamp;
+            memcpy(block->pPIXCurrent, &statistics, sizeof(statistics));
+            block->pPIXCurrent += sizeof(statistics);
+            *reinterpret_cast<uint64_t*>(block->pPIXCurrent) = PIXEventsBlockEndMarker;
+
             m_worker->Add(std::move(block));
         }
+
+        PEvtStatsBlk GetRuntimeStatistics() const
+        {
+            auto lock = m_srwlock.lock_shared();
+            return GetStatistics();
+        }
+
+        void WaitForFlush(uint64_t fence)
+        {
+            // m_worker outlives any caller that has a fence to wait for, and
+            // copes with being stopped and started while we wait.
+            m_worker->WaitForFence(fence);
+        }
+
+        void TakeBlock(BlockAllocator::Block block)
+        {
+            LatencyTimer timer(LatencyOperation::TakeBlock);
+
+            // Thread ids are multiples of 4
+            auto& slot = m_handoffSlots[(GetCurrentThreadId() >> 2) % HandoffSlotCount];
+
+            slot.ActiveHandoffs.fetch_add(1);
+            if (!m_isClosed.load())
+            {
+                m_worker->Add(std::move(block));
+            }
+            slot.ActiveHandoffs.fetch_sub(1);
+        }
+
+        std::vector<ThreadBlockStatistics> GetThreadBlockStatistics() const
+        {
+            auto lock = m_srwlock.lock_shared();
+
+            std::vector<ThreadBlockStatistics> statistics;
+            m_threads.GetBlockStatistics(statistics);
+            return statistics;
+        }
+
+        void RegisterInternedString(uint64_t shortcut, void const* string)
+        {
+            auto lock = m_srwlock.lock_exclusive();
+
+            if (!m_internedStrings.Add(shortcut, string))
+                return;
+
+            if (IsCapturing())
+            {
+                m_internedStrings.Write(*m_worker, m_internedStrings.Size() - 1);
+            }
+
+            if (m_isWritingToFile)
+            {
+                auto captureFileLock = g_captureFileLock.lock_shared();
+                if (g_captureFile)
+                {
+                    WriteInternedStrings(*g_captureFile, m_internedStrings.Size() - 1);
+                }
+            }
+        }
+
+    private:
+        // The capture file keeps the interned strings in a table of their
+        // own, so they're still there after the ring has gone round. Only
+        // called with m_srwlock held, so there's one writer at a time.
+        void WriteInternedStrings(MappedFileSink& captureFile, size_t first = 0)
+        {
+            BlockCollector blocks;
+            m_internedStrings.Write(blocks, first);
+
+            for (auto& block : blocks.Blocks)
+            {
+                block->BlockSize = BlockAllocator::GetUsedSize(block.get());
+                captureFile.WriteStringTable(block->BlockSize, block.get());
+            }
+        }
+
+        void UpdateLiveCapture()
+        {
+            m_worker->SetLiveCapture(m_isEnabled || m_isWritingToFile);
+        }
+
+        bool IsCapturing() const
+        {
+            return m_isEnabled || m_flightRecorderSize != 0 || m_isWritingToFile;
+        }
+
+        PEvtStatsBlk GetStatistics() const
+        {
+            PEvtStatsBlk statistics = {};
+            m_threads.GetStatistics(statistics);
+            m_worker->GetStatistics(statistics);
+
+            statistics.Events = g_writtenEvents.load(std::memory_order_relaxed);
+            statistics.BlocksWritten = g_writtenBlocks.load(std::memory_order_relaxed);
+            statistics.BytesWritten = g_writtenBytes.load(std::memory_order_relaxed);
+            statistics.Writes = g_writes.load(std::memory_order_relaxed);
+
+            return statistics;
+        }
+
+        void StartCapture()
+        {
+            m_threads.UpdateThreads(true);
+            m_worker->Start();
+            InvalidateThreadInfoCaches();
+
+            // Each capture needs its own copy of the strings interned so far
+            m_internedStrings.Write(*m_worker);
+        }
+
+        void StopCapture()
+        {
+            m_threads.UpdateThreads(false);
+            m_worker->Stop();
+            InvalidateThreadInfoCaches();
+        }
     };
 
 
     static std::optional<EtwWriter> g_etwWriter;
 
+    // The generation that callers compare against to decide whether their
+    // cached PIXEventsThreadInfo pointer is still good (see
+    // PIXGetCachedThreadInfo in PIXEventsCommon.h).
+    static volatile LONG64 g_captureGeneration = 1;
+
+
+    void InvalidateThreadInfoCaches() noexcept
+    {
+        InterlockedIncrement64(&g_captureGeneration);
+    }
+
+
+    static std::atomic<uint32_t> g_eventBlockSize = BlockAllocator::DefaultBlockSize;
+
+    void SetEventBlockSize(uint32_t blockSize) noexcept
+    {
+        g_eventBlockSize = (blockSize == AdaptiveBlockSize) ? AdaptiveBlockSize : BlockAllocator::ClampBlockSize(blockSize);
+    }
+
+
+    uint32_t GetEventBlockSize() noexcept
+    {
+        return g_eventBlockSize.load(std::memory_order_relaxed);
+    }
+
+
+    static std::atomic<bool> g_isBlockCompressionEnabled = false;
+
+    void SetBlockCompression(bool isEnabled) noexcept
+    {
+        g_isBlockCompressionEnabled = isEnabled;
+    }
+
+
+    bool IsBlockCompressionEnabled() noexcept
+    {
+        return g_isBlockCompressionEnabled.load(std::memory_order_relaxed);
+    }
+
+
+    // Blocks are compressed by the worker, and by the thread pool threads
+    // that help it with a backlog.
+    static std::atomic<uint64_t> g_compressedBlocks = 0;
+    static std::atomic<uint64_t> g_uncompressedBytes = 0;
+    static std::atomic<uint64_t> g_compressedBytes = 0;
+    static std::atomic<uint64_t> g_compressionTicks = 0;
+
+    void RecordBlockCompression(uint32_t uncompressedBytes, uint32_t compressedBytes, uint64_t ticks) noexcept
+    {
+        g_compressedBlocks.fetch_add(1, std::memory_order_relaxed);
+        g_uncompressedBytes.fetch_add(uncompressedBytes, std::memory_order_relaxed);
+        g_compressedBytes.fetch_add(compressedBytes, std::memory_order_relaxed);
+        g_compressionTicks.fetch_add(ticks, std::memory_order_relaxed);
+    }
+
+
+    CompressionStatistics GetCompressionStatistics() noexcept
+    {
+        return {
+            g_compressedBlocks.load(std::memory_order_relaxed),
+            g_uncompressedBytes.load(std::memory_order_relaxed),
+            g_compressedBytes.load(std::memory_order_relaxed),
+            g_compressionTicks.load(std::memory_order_relaxed),
+        };
+    }
+
 
     void Initialize() noexcept
     {
@@ -113,6 +552,12 @@ namespace WinPixEventRuntime
     {
         g_etwWriter->Flush();
         g_etwWriter.reset();
+
+        {
+            auto captureFileLock = g_captureFileLock.lock_exclusive();
+            g_captureFile.reset();
+        }
+
         BlockAllocator::Shutdown();
     }
 
@@ -129,9 +574,57 @@ namespace WinPixEventRuntime
     }
 
 
-    void FlushCapture() noexcept
+    uint64_t FlushCapture() noexcept
     {   
-        g_etwWriter->Flush();
+        return g_etwWriter->Flush();
+    }
+
+
+    void WaitForFlush(uint64_t fence) noexcept
+    {
+        g_etwWriter->WaitForFlush(fence);
+    }
+
+
+    void SetMaxEventLatency(uint32_t milliseconds) noexcept
+    {
+        g_etwWriter->SetMaxEventLatency(milliseconds);
+    }
+
+
+    void HarvestStaleBlocks() noexcept
+    {
+        g_etwWriter->HarvestStaleBlocks(PIXGetTimestampCounter());
+    }
+
+
+    void HarvestStaleBlocksAt(uint64_t now) noexcept
+    {
+        g_etwWriter->HarvestStaleBlocks(now);
+    }
+
+
+    PEvtStatsBlk GetRuntimeStatistics() noexcept
+    {
+        return g_etwWriter->GetRuntimeStatistics();
+    }
+
+
+    void SetStatisticsInterval(uint32_t milliseconds) noexcept
+    {
+        g_etwWriter->SetStatisticsInterval(milliseconds);
+    }
+
+
+    void WriteStatistics() noexcept
+    {
+        g_etwWriter->WriteStatistics();
+    }
+
+
+    void SetWorkerNumaNode(uint32_t node) noexcept
+    {
+        g_etwWriter->SetWorkerNumaNode(node);
     }
 
 
@@ -152,6 +645,56 @@ namespace WinPixEventRuntime
     {
         g_etwWriter->TakeBlock(std::move(block));
     }
+
+
+    void RegisterInternedString(uint64_t shortcut, void const* string) noexcept
+    {
+        g_etwWriter->RegisterInternedString(shortcut, string);
+    }
+
+
+    void SetFlightRecorderSize(size_t maxBytes) noexcept
+    {
+        g_etwWriter->SetFlightRecorderSize(maxBytes);
+    }
+
+
+    bool TriggerFlightRecorder() noexcept
+    {
+        return g_etwWriter->TriggerFlightRecorder();
+    }
+
+
+    bool OpenCaptureFile(wchar_t const* fileName, uint64_t fileSize) noexcept
+    {
+        return g_etwWriter->OpenCaptureFile(fileName, fileSize);
+    }
+
+
+    void CloseCaptureFile() noexcept
+    {
+        g_etwWriter->CloseCaptureFile();
+    }
+
+
+    bool WriteBlockToCaptureFile(uint32_t numBytes, void const* block) noexcept
+    {
+        auto lock = g_captureFileLock.lock_shared();
+        return g_captureFile && g_captureFile->Write(numBytes, block);
+    }
+
+
+    bool WriteBlocksToCaptureFile(uint32_t count, BlockSpan const* spans) noexcept
+    {
+        auto lock = g_captureFileLock.lock_shared();
+        return g_captureFile && g_captureFile->Write(count, spans);
+    }
+
+
+    std::vector<ThreadBlockStatistics> GetThreadBlockStatistics()
+    {
+        return g_etwWriter->GetThreadBlockStatistics();
+    }
 }
 
 //
@@ -161,6 +704,8 @@ namespace WinPixEventRuntime
 
 UINT64 PIXEventsReplaceBlock(PIXEventsThreadInfo* threadInfo, bool getEarliestTime) noexcept
 {
+    WinPixEventRuntime::LatencyTimer timer(WinPixEventRuntime::LatencyOperation::ReplaceBlock);
+
     std::optional<uint64_t> eventTime;
     if (getEarliestTime)
         eventTime = PIXGetTimestampCounter();
@@ -169,9 +714,128 @@ UINT64 PIXEventsReplaceBlock(PIXEventsThreadInfo* threadInfo, bool getEarliestTi
 }
 
 
+void WINAPI PIXEventsRegisterInternedString(UINT64 shortcut, _In_ const void* string) noexcept
+{
+    WinPixEventRuntime::RegisterInternedString(shortcut, string);
+}
+
+
+const volatile UINT64* WINAPI PIXEventsGetCaptureGeneration() noexcept
+{
+    return reinterpret_cast<const volatile UINT64*>(&WinPixEventRuntime::g_captureGeneration);
+}
+
+
+const volatile UINT32* WINAPI PIXEventsGetThreadExitedFlag() noexcept
+{
+    return WinPixEventRuntime::ThreadData::GetThreadExitedFlag();
+}
+
+
 #ifdef PIX_EVENTS_ARE_TURNED_ON
 // If events are turned off, these functions are empty inlines in pix3.h
 
+void WINAPI PIXSetEventBlockSize(UINT32 blockSize)
+{
+    WinPixEventRuntime::SetEventBlockSize(blockSize);
+}
+
+void WINAPI PIXSetFlightRecorderSize(UINT64 maxBytes)
+{
+    WinPixEventRuntime::SetFlightRecorderSize(static_cast<size_t>(maxBytes));
+}
+
+void WINAPI PIXTriggerFlightRecorder()
+{
+    (void)WinPixEventRuntime::TriggerFlightRecorder();
+}
+
+void WINAPI PIXSetEventBlockCompression(BOOL enable)
+{
+    WinPixEventRuntime::SetBlockCompression(enable != FALSE);
+}
+
+void WINAPI PIXSetEventBlockLargePages(BOOL enable)
+{
+    WinPixEventRuntime::BlockAllocator::SetLargePages(enable != FALSE);
+}
+
+void WINAPI PIXSetMaxEventLatency(UINT32 milliseconds)
+{
+    WinPixEventRuntime::SetMaxEventLatency(milliseconds);
+}
+
+void WINAPI PIXSetStatisticsInterval(UINT32 milliseconds)
+{
+    WinPixEventRuntime::SetStatisticsInterval(milliseconds);
+}
+
+void WINAPI PIXSetWorkerNumaNode(UINT32 node)
+{
+    static_assert(PIX_NUMA_NODE_ANY == WinPixEventRuntime::Worker::AnyNumaNode);
+    WinPixEventRuntime::SetWorkerNumaNode(node);
+}
+
+void WINAPI PIXGetRuntimeStatistics(_Out_ PIXRuntimeStatistics* statistics)
+{
+    if (!statistics)
+        return;
+
+    const PEvtStatsBlk runtimeStatistics = WinPixEventRuntime::GetRuntimeStatistics();
+
+    statistics->Threads = runtimeStatistics.Threads;
+    statistics->Events = runtimeStatistics.Events;
+    statistics->BlocksWritten = runtimeStatistics.BlocksWritten;
+    statistics->BytesRecorded = runtimeStatistics.BytesRecorded;
+    statistics->BytesWritten = runtimeStatistics.BytesWritten;
+    statistics->Writes = runtimeStatistics.Writes;
+    statistics->BlockReplacements = runtimeStatistics.BlockReplacements;
+    statistics->AllocationFailures = runtimeStatistics.AllocationFailures;
+    statistics->QueuedBlocks = runtimeStatistics.QueuedBlocks;
+    statistics->MaxQueuedBlocks = runtimeStatistics.MaxQueuedBlocks;
+    statistics->OverflowBlocks = runtimeStatistics.OverflowBlocks;
+    statistics->DroppedBlocks = runtimeStatistics.DroppedBlocks;
+}
+
+BOOL WINAPI PIXGetRuntimeLatency(UINT32 operation, _Out_ PIXRuntimeLatency* latency)
+{
+    if (!latency)
+        return FALSE;
+
+    *latency = {};
+
+#if PIX_ENABLE_LATENCY_HISTOGRAMS
+    if (operation >= static_cast<UINT32>(WinPixEventRuntime::LatencyOperation::Count))
+        return FALSE;
+
+    const auto summary = WinPixEventRuntime::GetLatencyHistogram(static_cast<WinPixEventRuntime::LatencyOperation>(operation)).GetSummary();
+
+    static_assert(ARRAYSIZE(latency->Buckets) == WinPixEventRuntime::LatencyHistogram::BucketCount);
+
+    latency->Count = summary.Count;
+    latency->P50 = summary.P50;
+    latency->P99 = summary.P99;
+    latency->P999 = summary.P999;
+    latency->Max = summary.Max;
+    memcpy(latency->Buckets, summary.Buckets, sizeof(latency->Buckets));
+    return TRUE;
+#else
+    (void)operation;
+    return FALSE;
+#endif
+}
+
+HRESULT WINAPI PIXSetCaptureFile(_In_opt_ PCWSTR fileName, UINT64 fileSize)
+{
+    if (!fileName)
+    {
+        WinPixEventRuntime::CloseCaptureFile();
+        return S_OK;
+    }
+
+    return WinPixEventRuntime::OpenCaptureFile(fileName, fileSize) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+}
+
 void WINAPI PIXReportCounter(_In_ PCWSTR name, float value)
 {
     EventWritePIXReportCounterData(value, name);
@@ -9,6 +9,8 @@
 #include "BlockAllocator.h"
 #include <shared/PEvtBlk.h>
 
+#include <vector>
+
 namespace WinPixEventRuntime
 {
     void Initialize() noexcept;
@@ -16,7 +18,22 @@ namespace WinPixEventRuntime
 
     void EnableCapture() noexcept;
     void DisableCapture() noexcept;
-    void FlushCapture() noexcept;
+
+    // Hands each thread's partial block to the worker without waiting for
+    // them to be written out. Callers that need them written can pass the
+    // returned fence to WaitForFlush.
+    uint64_t FlushCapture() noexcept;
+    void WaitForFlush(uint64_t fence) noexcept;
+
+    // While this isn't 0, events that threads have written are harvested
+    // from their blocks (see ThreadData::Harvest) and written out within
+    // about this many milliseconds, rather than waiting for the block to
+    // fill. Off by default. The worker calls HarvestStaleBlocks to do this.
+    void SetMaxEventLatency(uint32_t milliseconds) noexcept;
+    void HarvestStaleBlocks() noexcept;
+
+    // Likewise, but as if the time were now (in PIXGetTimestampCounter ticks).
+    void HarvestStaleBlocksAt(uint64_t now) noexcept;
 
     class ThreadData;
     void RegisterThread(ThreadData* threadData) noexcept;
@@ -24,10 +41,110 @@ namespace WinPixEventRuntime
 
     void TakeBlock(BlockAllocator::Block block) noexcept;
 
+    void RegisterInternedString(uint64_t shortcut, void const* string) noexcept;
+
+    void InvalidateThreadInfoCaches() noexcept;
+
+    // The size of newly allocated blocks, or AdaptiveBlockSize to let each
+    // thread choose based on how quickly it fills them.
+    constexpr uint32_t AdaptiveBlockSize = 0;
+    void SetEventBlockSize(uint32_t blockSize) noexcept;
+    uint32_t GetEventBlockSize() noexcept;
+
+    // Whether the worker compresses blocks before writing them out (see
+    // PEvtCompression.h). Off by default.
+    void SetBlockCompression(bool isEnabled) noexcept;
+    bool IsBlockCompressionEnabled() noexcept;
+
+    struct CompressionStatistics
+    {
+        uint64_t Blocks;            // Number of blocks compressed
+        uint64_t UncompressedBytes;
+        uint64_t CompressedBytes;   // Including blocks written uncompressed because they didn't shrink
+        uint64_t Ticks;             // Time spent compressing, in QueryPerformanceCounter ticks
+    };
+
+    void RecordBlockCompression(uint32_t uncompressedBytes, uint32_t compressedBytes, uint64_t ticks) noexcept;
+    CompressionStatistics GetCompressionStatistics() noexcept;
+
+    // Called for each write of blocks, by the worker and the thread pool
+    // threads that help it.
+    void RecordBlockWrite(uint32_t blocks, uint64_t events, uint64_t bytes) noexcept;
+
+    // Gathers the counts kept by the threads, the worker and the writes into
+    // one set of statistics.
+    PEvtStatsBlk GetRuntimeStatistics() noexcept;
+
+    // While this isn't 0, the worker hands a PIXEVT_STATS_BLOCK block to
+    // itself about this often, by calling WriteStatistics, so that the
+    // statistics end up in the capture along with the events. Off by default.
+    void SetStatisticsInterval(uint32_t milliseconds) noexcept;
+    void WriteStatistics() noexcept;
+
+    // Keeps the worker thread on the processors of a NUMA node, or lets it
+    // run anywhere again when node is Worker::AnyNumaNode. Threads writing
+    // events already get blocks from their own node's arena (see
+    // BlockAllocator), so this is for applications whose event-heavy threads
+    // all live on one node.
+    void SetWorkerNumaNode(uint32_t node) noexcept;
+
+    // While the flight recorder is on, events are recorded whether or not
+    // ETW has the provider enabled, and the last maxBytes worth of blocks are
+    // kept in memory. They're only written out as they come in if there's a
+    // capture running as well. Triggering it writes out the blocks it has
+    // kept, so a capture that was already running gets them twice. Returns
+    // false if the flight recorder isn't on.
+    void SetFlightRecorderSize(size_t maxBytes) noexcept;
+    bool TriggerFlightRecorder() noexcept;
+
+    // A run of one or more blocks, each sized by its header's BlockSize.
+    struct BlockSpan
+    {
+        uint32_t NumBytes;
+        void* Data;
+    };
+
+    // While a capture file is open, blocks are written into it (see
+    // MappedFileSink) as well as through ETW, and events are recorded whether
+    // or not ETW has the provider enabled.
+    bool OpenCaptureFile(wchar_t const* fileName, uint64_t fileSize) noexcept;
+    void CloseCaptureFile() noexcept;
+
+    // Returns false if there's no capture file open, or the block didn't fit.
+    bool WriteBlockToCaptureFile(uint32_t numBytes, void const* block) noexcept;
+    bool WriteBlocksToCaptureFile(uint32_t count, BlockSpan const* spans) noexcept;
+
+    struct ThreadBlockStatistics
+    {
+        uint32_t ThreadId;
+        uint32_t BlockSize;         // Size of the thread's most recent block
+        uint64_t Replacements;      // Number of blocks the thread has started
+        uint64_t BytesRecorded;     // Bytes of events in the blocks the thread has finished with
+        uint64_t AllocationFailures;
+    };
+
+    std::vector<ThreadBlockStatistics> GetThreadBlockStatistics();
+
     class Worker;
     std::unique_ptr<Worker> CreateWorker() noexcept;
     
     void WriteBlock(uint32_t numBytes, void* block) noexcept;
+
+    // Statistics blocks (PIXEVT_STATS_BLOCK) have an ETW event of their own,
+    // PIXRecordRuntimeStatistics, so consumers of the timing block events
+    // never see them.
+    void WriteStatisticsBlock(uint32_t numBytes, void* block) noexcept;
+
+    // Whether whoever is reading the blocks can take several of them in one
+    // write. ETW consumers that only know about PIXRecordTimingBlock_v2 read a
+    // single block from each event, so they need every block written on its
+    // own.
+    bool AreBlockBatchesEnabled() noexcept;
+
+    // Writes several runs of blocks out as one, in order and without copying
+    // them together. They add up to no more than BlockAllocator::MaxWriteSize
+    // and count is at most BlockAllocator::MaxSpansPerWrite.
+    void WriteBlocks(uint32_t count, BlockSpan const* spans) noexcept;
 }
 
 
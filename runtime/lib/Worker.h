@@ -4,6 +4,9 @@
 #pragma once
 
 #include "BlockAllocator.h"
+#include <shared/PEvtBlk.h>
+
+#include <vector>
 
 namespace WinPixEventRuntime
 {
@@ -19,6 +22,41 @@ namespace WinPixEventRuntime
         virtual void Start() = 0;
         virtual void Stop() = 0;
         virtual void Add(BlockAllocator::Block block) = 0;
+
+        // Returns a fence that completes once every block added before the
+        // call has been written out (or kept by the flight recorder).
+        // WaitForFence blocks until then.
+        virtual uint64_t AddFence() = 0;
+        virtual void WaitForFence(uint64_t fence) = 0;
+
+        // When milliseconds isn't 0, the worker calls HarvestStaleBlocks
+        // about this often.
+        virtual void SetHarvestInterval(uint32_t milliseconds) = 0;
+
+        // Likewise for WriteStatistics.
+        virtual void SetStatisticsInterval(uint32_t milliseconds) = 0;
+
+        // Fills in the queue depths and the counts of blocks the worker has
+        // had to set aside or drop.
+        virtual void GetStatistics(PEvtStatsBlk& statistics) = 0;
+
+        // Keeps the worker on the processors of a NUMA node, or lets it run
+        // anywhere again when node is AnyNumaNode.
+        static constexpr uint32_t AnyNumaNode = 0xFFFFFFFF;
+        virtual void SetNumaNode(uint32_t node) = 0;
+
+        // When maxBytes isn't 0, blocks are kept in a FlightRecorder of that
+        // size. They're only written out as well while there's a live capture
+        // (see SetLiveCapture).
+        virtual void SetFlightRecorderSize(size_t maxBytes) = 0;
+
+        // Whether something (an ETW session or a capture file) is taking the
+        // blocks as they're written.
+        virtual void SetLiveCapture(bool isLive) = 0;
+
+        // Writes out headerBlocks followed by the blocks the flight recorder
+        // holds, including any that were added before this was called.
+        virtual void TriggerFlightRecorder(std::vector<BlockAllocator::Block> headerBlocks) = 0;
     };
 
 }
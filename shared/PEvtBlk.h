@@ -12,6 +12,8 @@
 enum PIXEVT_BLOCK_TYPE : UINT32
 {
     PIXEVT_CPU_BLOCK,
+    PIXEVT_CPU_BLOCK_COMPRESSED,    // A PIXEVT_CPU_BLOCK whose events are compressed (see PEvtCmpBlkHdr)
+    PIXEVT_STATS_BLOCK,             // The runtime's own statistics (see PEvtStatsBlk)
 
     PIXEVT_INVALID_BLOCK = (UINT32)-1
 };
@@ -31,8 +33,38 @@ struct PEvtBlkHdr
 {
     BYTE*  pPIXLimit;               // Points to end of the block
     BYTE*  pPIXCurrent;             // Current insertion point for incoming data
-    UINT32 Reserved;                // For padding (64-bit alignment) and potential future use
+    UINT32 BlockSize;               // Number of bytes written out for this block, 0 if it fills the whole buffer.
+                                    // A buffer may hold several blocks back to back (see DecodeTimingBlocks).
     PIXEVT_BLOCK_TYPE BlockType;    // Whether this block contains CPU info, GPU info, etc.
     PEvtCpuBlkHdr cpuHeader;    // CPU-specific block header info
 };
 
+// PEvtCmpBlkHdr:
+// Follows the PEvtBlkHdr of a PIXEVT_CPU_BLOCK_COMPRESSED block, and is followed
+// by the compressed events (see PEvtCompression.h). BlockSize in the PEvtBlkHdr
+// is the compressed size of the whole block.
+struct PEvtCmpBlkHdr
+{
+    UINT32 DataSize;                // Size of the events once they are decompressed
+    UINT32 Reserved;
+};
+
+// PEvtStatsBlk:
+// Follows the PEvtBlkHdr of a PIXEVT_STATS_BLOCK block, and is followed by an
+// end marker. The runtime writes one of these periodically, if asked to. The
+// counts are totals since the runtime started, except for the queue depths.
+struct PEvtStatsBlk
+{
+    UINT64 Threads;                 // Threads currently registered
+    UINT64 Events;                  // Events written out
+    UINT64 BlocksWritten;
+    UINT64 BytesRecorded;           // Bytes of events that threads have recorded into blocks
+    UINT64 BytesWritten;            // Bytes handed to ETW or the capture file, after compression
+    UINT64 Writes;                  // Number of writes those bytes took
+    UINT64 BlockReplacements;       // Blocks that threads have started
+    UINT64 AllocationFailures;      // Times a thread couldn't get a new block, and dropped events
+    UINT64 QueuedBlocks;            // Blocks waiting for the worker
+    UINT64 MaxQueuedBlocks;         // The most that have been waiting at once
+    UINT64 OverflowBlocks;          // Blocks that didn't fit in the worker's queue
+    UINT64 DroppedBlocks;           // Blocks that the flight recorder let go of
+};
@@ -0,0 +1,209 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <windows.h>
+
+#include <string.h>
+
+// Compression for PIXEVT_CPU_BLOCK_COMPRESSED blocks (see PEvtBlk.h).
+//
+// The compressed data uses the LZ4 block format: a series of sequences, each a
+// token byte holding a literal length and a match length in its two nibbles,
+// any extra length bytes, the literals, and a 16 bit offset back to the match.
+// The last sequence is only literals. The compressor is a simple greedy one
+// with a single hash table lookup per position, which suits event blocks well:
+// their format strings, colors and the top bits of their timestamps repeat
+// from one event to the next.
+
+constexpr size_t PEVT_COMPRESSION_MIN_MATCH = 4;
+constexpr size_t PEVT_COMPRESSION_LAST_LITERALS = 5;   // The last bytes are always literals
+constexpr size_t PEVT_COMPRESSION_MATCH_LIMIT = 12;    // No match starts in the last bytes
+constexpr size_t PEVT_COMPRESSION_MAX_INPUT = 0xffff;  // Positions are stored in 16 bits
+
+inline UINT32 PEvtCompressionRead32(BYTE const* p)
+{
+    UINT32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline BYTE* PEvtCompressionWriteLength(BYTE* destination, size_t length)
+{
+    while (length >= 255)
+    {
+        *destination++ = 255;
+        length -= 255;
+    }
+    *destination++ = static_cast<BYTE>(length);
+    return destination;
+}
+
+// Returns the compressed size, or 0 if the compressed data doesn't fit in
+// destinationCapacity.
+inline size_t PEvtCompress(BYTE const* source, size_t sourceSize, BYTE* destination, size_t destinationCapacity)
+{
+    constexpr int HashBits = 11;
+
+    if (sourceSize > PEVT_COMPRESSION_MAX_INPUT)
+        return 0;
+
+    UINT16 table[1 << HashBits] = {};
+
+    BYTE* out = destination;
+    BYTE* const outEnd = destination + destinationCapacity;
+
+    // Writes the literals from anchor up to position, then the match if there
+    // is one.
+    auto writeSequence = [&](size_t anchor, size_t position, size_t offset, size_t matchLength)
+    {
+        const size_t literalLength = position - anchor;
+        const size_t matchCode = matchLength ? matchLength - PEVT_COMPRESSION_MIN_MATCH : 0;
+
+        const size_t worstSize = 1 + (literalLength / 255 + 1) + literalLength + 2 + (matchCode / 255 + 1);
+        if (static_cast<size_t>(outEnd - out) < worstSize)
+            return false;
+
+        BYTE* token = out++;
+        *token = static_cast<BYTE>((literalLength < 15 ? literalLength : 15) << 4);
+        if (literalLength >= 15)
+        {
+            out = PEvtCompressionWriteLength(out, literalLength - 15);
+        }
+
+        memcpy(out, source + anchor, literalLength);
+        out += literalLength;
+
+        if (matchLength)
+        {
+            *out++ = static_cast<BYTE>(offset);
+            *out++ = static_cast<BYTE>(offset >> 8);
+
+            *token |= static_cast<BYTE>(matchCode < 15 ? matchCode : 15);
+            if (matchCode >= 15)
+            {
+                out = PEvtCompressionWriteLength(out, matchCode - 15);
+            }
+        }
+
+        return true;
+    };
+
+    size_t anchor = 0;
+
+    if (sourceSize > PEVT_COMPRESSION_MATCH_LIMIT)
+    {
+        const size_t positionLimit = sourceSize - PEVT_COMPRESSION_MATCH_LIMIT;
+        const size_t matchEndLimit = sourceSize - PEVT_COMPRESSION_LAST_LITERALS;
+
+        size_t position = 1;
+        while (position < positionLimit)
+        {
+            const UINT32 sequence = PEvtCompressionRead32(source + position);
+            const UINT32 hash = (sequence * 2654435761u) >> (32 - HashBits);
+
+            const size_t candidate = table[hash];
+            table[hash] = static_cast<UINT16>(position);
+
+            if (candidate < position && PEvtCompressionRead32(source + candidate) == sequence)
+            {
+                size_t matchLength = PEVT_COMPRESSION_MIN_MATCH;
+                while (position + matchLength < matchEndLimit && source[candidate + matchLength] == source[position + matchLength])
+                {
+                    ++matchLength;
+                }
+
+                if (!writeSequence(anchor, position, position - candidate, matchLength))
+                    return 0;
+
+                position += matchLength;
+                anchor = position;
+            }
+            else
+            {
+                ++position;
+            }
+        }
+    }
+
+    if (!writeSequence(anchor, sourceSize, 0, 0))
+        return 0;
+
+    return static_cast<size_t>(out - destination);
+}
+
+// Returns false unless the compressed data is well formed and decompresses to
+// exactly destinationSize bytes.
+inline bool PEvtDecompress(BYTE const* source, size_t sourceSize, BYTE* destination, size_t destinationSize)
+{
+    size_t in = 0;
+    size_t out = 0;
+
+    auto readLength = [&](size_t& length)
+    {
+        BYTE b;
+        do
+        {
+            if (in >= sourceSize)
+                return false;
+            b = source[in++];
+            length += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (in < sourceSize)
+    {
+        const BYTE token = source[in++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(literalLength))
+            return false;
+
+        if (literalLength > sourceSize - in || literalLength > destinationSize - out)
+            return false;
+
+        memcpy(destination + out, source + in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        // The last sequence has no match
+        if (in == sourceSize)
+            break;
+
+        if (sourceSize - in < 2)
+            return false;
+
+        const size_t offset = source[in] | (static_cast<size_t>(source[in + 1]) << 8);
+        in += 2;
+
+        if (offset == 0 || offset > out)
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(matchLength))
+            return false;
+        matchLength += PEVT_COMPRESSION_MIN_MATCH;
+
+        if (matchLength > destinationSize - out)
+            return false;
+
+        BYTE* match = destination + out - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(destination + out, match, matchLength);
+        }
+        else
+        {
+            // The match overlaps what it's copying to, repeating a pattern
+            for (size_t i = 0; i < matchLength; ++i)
+            {
+                destination[out + i] = match[i];
+            }
+        }
+        out += matchLength;
+    }
+
+    return out == destinationSize;
+}
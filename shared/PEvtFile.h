@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdint>
+
+// Layout of a capture file that blocks are written into through a file mapping
+// (see PIXSetCaptureFile). After the header comes a table of commit sequence
+// numbers, one per slot, and then a ring of fixed size slots that each hold a
+// PEvtFileSlotHdr followed by the bytes of one write. A slot's commit sequence
+// number is cleared before it is overwritten and only set again once the new
+// write has been copied in, so a reader can recover the writes that completed,
+// in order, from a file left behind by a process that crashed.
+//
+// The interned strings that events refer to are kept apart from the ring, in a
+// string table between the commit sequence numbers and the slots, so that they
+// aren't lost when the ring goes round. The table holds blocks of
+// PIXEvent_InternString records that are appended and then committed by
+// raising StringTableUsed.
+
+constexpr uint64_t PIXEVT_FILE_MAGIC = 0x474e495254564550ull; // "PEVTRING"
+constexpr uint32_t PIXEVT_FILE_VERSION = 2;
+
+struct PEvtFileHdr
+{
+    uint64_t Magic;                 // PIXEVT_FILE_MAGIC
+    uint32_t Version;               // PIXEVT_FILE_VERSION
+    uint32_t SlotCount;             // Number of slots in the ring
+    uint32_t SlotSize;              // Size of each slot, including its PEvtFileSlotHdr
+    uint32_t SlotsOffset;           // Offset of the first slot from the start of the file
+    uint32_t StringTableOffset;     // Offset of the string table from the start of the file
+    uint32_t StringTableSize;       // Number of bytes set aside for the string table
+    uint64_t StringTableUsed;       // Number of bytes of the string table that have been committed
+    // uint64_t CommitSequence[SlotCount] follows. 0 means that the slot doesn't
+    // hold a complete write, otherwise it is 1 + the position of the write in
+    // the order they were made, so slot = (CommitSequence - 1) % SlotCount.
+};
+
+struct PEvtFileSlotHdr
+{
+    uint32_t Size;                  // Number of bytes written to the slot after this header
+    uint32_t Reserved;
+};
@@ -0,0 +1,493 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+
+#include "MockD3D12.h" // Include this before pix3.h to trick pix3.h into using the mocked D3D12 definitions
+#include <pix3.h>
+
+#pragma warning(disable:4464) // relative include path contains '..'
+#include "../runtime/lib/BlockAllocator.h"
+
+#include <shared/PEvtBlk.h>
+#include <PixEventDecoder.h>
+
+#include <psapi.h>
+#include <wil/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+
+extern std::vector<std::vector<uint8_t>> g_blocks;
+extern bool g_areBlockBatchesEnabled;
+
+TEST(BlockAllocatorTests, FreedBlocks_AreReused)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+
+    auto block = WinPixEventRuntime::BlockAllocator::Allocate(1ull);
+    ASSERT_TRUE(block);
+    PEvtBlkHdr* first = block.get();
+    ASSERT_EQ(1ull, block->cpuHeader.beginTimestamp);
+    block.reset();
+
+    block = WinPixEventRuntime::BlockAllocator::Allocate(2ull);
+    ASSERT_EQ(first, block.get());
+    ASSERT_EQ(2ull, block->cpuHeader.beginTimestamp);
+    block.reset();
+
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+
+    // Blocks cached by this thread must not outlive the allocator they came from
+    WinPixEventRuntime::BlockAllocator::Initialize();
+    block = WinPixEventRuntime::BlockAllocator::Allocate(3ull);
+    ASSERT_TRUE(block);
+    block.reset();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
+
+//
+// Many producer threads allocate blocks and hand them to a single consumer
+// that frees them, like threads rolling blocks while the worker writes them
+// out. The freed blocks should find their way back to the producers rather
+// than new ones being allocated each time.
+//
+TEST(BlockAllocatorTests, BlocksFreedByConsumer_ReturnToProducers)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+
+    constexpr int kProducers = 32;
+    constexpr int kBlocksPerProducer = 2000;
+    constexpr size_t kMaxPending = 256;
+
+    std::mutex mutex;
+    std::vector<WinPixEventRuntime::BlockAllocator::Block> pending;
+    std::set<PEvtBlkHdr*> seen;
+    std::atomic<int> producersRunning = kProducers;
+
+    std::thread consumer([&] {
+        std::vector<WinPixEventRuntime::BlockAllocator::Block> blocks;
+        while (producersRunning > 0 || !blocks.empty())
+        {
+            blocks.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::swap(blocks, pending);
+            }
+        }
+        WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    });
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        producers.emplace_back([&] {
+            std::set<PEvtBlkHdr*> local;
+            for (int i = 0; i < kBlocksPerProducer; ++i)
+            {
+                // Don't let the consumer fall too far behind
+                for (;;)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (pending.size() < kMaxPending)
+                            break;
+                    }
+                    std::this_thread::yield();
+                }
+
+                auto block = WinPixEventRuntime::BlockAllocator::Allocate(std::nullopt);
+                if (!block)
+                {
+                    ADD_FAILURE() << "Allocate failed";
+                    break;
+                }
+                local.insert(block.get());
+
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.push_back(std::move(block));
+            }
+            WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            seen.insert(local.begin(), local.end());
+            --producersRunning;
+        });
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    consumer.join();
+
+    // Without recycling every allocation would be a new block. With it, the
+    // blocks in use are the pending ones, the ones being freed and the ones
+    // cached by each thread.
+    ASSERT_LT(seen.size(), kMaxPending * 8);
+
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
+
+//
+// A thread running on one NUMA node should get blocks whose memory is on that
+// node, wherever the blocks are freed. This can only be checked on machines
+// with more than one node.
+//
+TEST(BlockAllocatorTests, Blocks_ComeFromTheThreadsNumaNode)
+{
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode) || highestNode == 0)
+    {
+        GTEST_SKIP() << "Only one NUMA node";
+    }
+
+    const USHORT node = 1;
+    GROUP_AFFINITY nodeAffinity = {};
+    ASSERT_TRUE(GetNumaNodeProcessorMaskEx(node, &nodeAffinity));
+
+    GROUP_AFFINITY originalAffinity = {};
+    ASSERT_TRUE(SetThreadGroupAffinity(GetCurrentThread(), &nodeAffinity, &originalAffinity));
+    auto restoreAffinity = wil::scope_exit([&] { SetThreadGroupAffinity(GetCurrentThread(), &originalAffinity, nullptr); });
+
+    WinPixEventRuntime::BlockAllocator::Initialize();
+    auto shutdown = wil::scope_exit([] {
+        WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+        WinPixEventRuntime::BlockAllocator::Shutdown();
+    });
+
+    // Declared after the guards, so the blocks are freed before the allocator
+    // is shut down, even if an assert returns early
+    std::vector<WinPixEventRuntime::BlockAllocator::Block> blocks;
+    for (uint64_t i = 0; i < 32; ++i)
+    {
+        auto block = WinPixEventRuntime::BlockAllocator::Allocate(i);
+        ASSERT_TRUE(block);
+        blocks.push_back(std::move(block));
+    }
+
+    // Freeing them on another thread must send them back to node 1's arena
+    std::thread([&] { blocks.clear(); WinPixEventRuntime::BlockAllocator::ReleaseThreadCache(); }).join();
+
+    for (uint64_t i = 0; i < 32; ++i)
+    {
+        auto block = WinPixEventRuntime::BlockAllocator::Allocate(i);
+        ASSERT_TRUE(block);
+        blocks.push_back(std::move(block));
+    }
+
+    for (auto& block : blocks)
+    {
+        PSAPI_WORKING_SET_EX_INFORMATION info = {};
+        info.VirtualAddress = block.get();
+        ASSERT_TRUE(QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)));
+        ASSERT_TRUE(info.VirtualAttributes.Valid);
+        ASSERT_EQ(node, info.VirtualAttributes.Node);
+    }
+}
+
+TEST(BlockAllocatorTests, LargePages_FallBackToOrdinaryPages)
+{
+    WinPixEventRuntime::BlockAllocator::SetLargePages(true);
+    WinPixEventRuntime::BlockAllocator::Initialize();
+
+    // Whether or not this process can have large pages, every size of block
+    // must be usable all the way to its end.
+    std::vector<WinPixEventRuntime::BlockAllocator::Block> blocks;
+    for (uint32_t blockSize = WinPixEventRuntime::BlockAllocator::MinBlockSize; blockSize <= WinPixEventRuntime::BlockAllocator::MaxBlockSize; blockSize *= 2)
+    {
+        for (uint64_t i = 0; i < 64; ++i)
+        {
+            auto block = WinPixEventRuntime::BlockAllocator::Allocate(i, blockSize);
+            ASSERT_TRUE(block);
+            ASSERT_EQ(blockSize, WinPixEventRuntime::BlockAllocator::GetBlockSize(block.get()));
+            std::memset(block.get() + 1, 0xcc, blockSize - sizeof(PEvtBlkHdr));
+            blocks.push_back(std::move(block));
+        }
+    }
+
+    blocks.clear();
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+    WinPixEventRuntime::BlockAllocator::SetLargePages(false);
+}
+
+//
+// Many threads fill blocks with marker-sized events while a consumer reads
+// them back and frees them, as the worker does when it writes them out. With
+// ordinary pages each 16kb block spans four pages, so hundreds of threads
+// keep the TLB busy; with large pages a whole 2mb chunk is one entry. The time
+// per marker is printed for both rather than checked, since it depends on the
+// machine, so it only runs with --gtest_also_run_disabled_tests. To see the
+// dTLB misses themselves, run this under a profiler that samples the
+// processor's TLB miss counters.
+//
+static double MeasureMarkerStorm(bool useLargePages, bool& usedLargePages)
+{
+    constexpr int kThreads = 256;
+    constexpr int kBlocksPerThread = 64;
+    constexpr size_t kMaxPending = 1024;
+
+    // Header, color and a short string, like PIXSetMarker(color, "marker")
+    constexpr size_t kMarkerQwords = 4;
+
+    WinPixEventRuntime::BlockAllocator::SetLargePages(useLargePages);
+    WinPixEventRuntime::BlockAllocator::Initialize();
+
+    std::mutex mutex;
+    std::vector<WinPixEventRuntime::BlockAllocator::Block> pending;
+    std::atomic<int> producersRunning = kThreads;
+    std::atomic<bool> go = false;
+    std::atomic<uint64_t> markers = 0;
+    uint64_t checksum = 0;
+
+    std::thread consumer([&] {
+        std::vector<WinPixEventRuntime::BlockAllocator::Block> blocks;
+        for (;;)
+        {
+            // Checked before taking the blocks, so none are left behind
+            const bool producersDone = producersRunning == 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::swap(blocks, pending);
+            }
+
+            if (blocks.empty() && producersDone)
+                break;
+
+            for (auto& block : blocks)
+            {
+                auto begin = reinterpret_cast<uint64_t const*>(block.get() + 1);
+                auto end = reinterpret_cast<uint64_t const*>(block->pPIXCurrent);
+                for (auto qword = begin; qword != end; ++qword)
+                {
+                    checksum += *qword;
+                }
+            }
+            blocks.clear();
+        }
+        WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    });
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        producers.emplace_back([&] {
+            while (!go)
+            {
+                std::this_thread::yield();
+            }
+
+            uint64_t written = 0;
+            for (int i = 0; i < kBlocksPerThread; ++i)
+            {
+                for (;;)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (pending.size() < kMaxPending)
+                            break;
+                    }
+                    std::this_thread::yield();
+                }
+
+                auto block = WinPixEventRuntime::BlockAllocator::Allocate(std::nullopt);
+                if (!block)
+                {
+                    ADD_FAILURE() << "Allocate failed";
+                    break;
+                }
+
+                auto destination = reinterpret_cast<uint64_t*>(block->pPIXCurrent);
+                auto limit = reinterpret_cast<uint64_t*>(block->pPIXLimit) - 1;
+                while (destination + kMarkerQwords <= limit)
+                {
+                    for (size_t q = 0; q < kMarkerQwords; ++q)
+                    {
+                        *destination++ = written + q;
+                    }
+                    ++written;
+                }
+                *destination = PIXEventsBlockEndMarker;
+                block->pPIXCurrent = reinterpret_cast<BYTE*>(destination);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.push_back(std::move(block));
+            }
+            WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+            markers += written;
+            --producersRunning;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    consumer.join();
+
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    usedLargePages = WinPixEventRuntime::BlockAllocator::IsUsingLargePages();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+    WinPixEventRuntime::BlockAllocator::SetLargePages(false);
+
+    // Keep the consumer's reads from being optimized away
+    EXPECT_NE(0u, checksum);
+
+    return ns / static_cast<double>(markers.load());
+}
+
+TEST(BlockAllocatorTests, DISABLED_Benchmark_LargePageMarkerStorm)
+{
+    bool usedLargePages = false;
+
+    // Warm up
+    (void)MeasureMarkerStorm(false, usedLargePages);
+
+    const double ordinary = MeasureMarkerStorm(false, usedLargePages);
+    std::printf("Ordinary pages: %.2f ns/marker\n", ordinary);
+
+    const double large = MeasureMarkerStorm(true, usedLargePages);
+    if (usedLargePages)
+    {
+        std::printf("Large pages:    %.2f ns/marker\n", large);
+    }
+    else
+    {
+        std::printf("Large pages not available (SeLockMemoryPrivilege needed): %.2f ns/marker\n", large);
+    }
+}
+
+TEST(BlockAllocatorTests, SmallBlocks_ArePackedIntoOneWrite)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+    g_blocks.clear();
+
+    {
+        WinPixEventRuntime::BlockAllocator::BlockPacker packer;
+        for (uint64_t i = 1; i <= 3; ++i)
+        {
+            auto block = WinPixEventRuntime::BlockAllocator::Allocate(i);
+            ASSERT_TRUE(block);
+            block->cpuHeader.threadId = static_cast<UINT32>(i);
+            packer.Write(std::move(block));
+        }
+
+        ASSERT_TRUE(g_blocks.empty());
+        packer.Flush();
+    }
+
+    ASSERT_EQ(1u, g_blocks.size());
+    ASSERT_EQ(3 * (sizeof(PEvtBlkHdr) + sizeof(uint64_t)), g_blocks[0].size());
+
+    auto decoded = PixEventDecoder::DecodeTimingBlocks(true, true, (uint32_t)g_blocks[0].size(), g_blocks[0].data(), [](uint64_t time) { return time; });
+    ASSERT_EQ(3u, decoded.size());
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(i + 1, decoded[i].ThreadId);
+        ASSERT_TRUE(decoded[i].Events.empty());
+    }
+
+    g_blocks.clear();
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
+
+TEST(BlockAllocatorTests, Blocks_AreWrittenOnTheirOwnWithoutBatches)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+    g_blocks.clear();
+
+    // Like an ETW session that only knows about PIXRecordTimingBlock_v2
+    g_areBlockBatchesEnabled = false;
+
+    {
+        WinPixEventRuntime::BlockAllocator::BlockPacker packer;
+        for (uint64_t i = 1; i <= 3; ++i)
+        {
+            // No ASSERTs until g_areBlockBatchesEnabled is restored
+            auto block = WinPixEventRuntime::BlockAllocator::Allocate(i);
+            EXPECT_TRUE(block);
+            if (block)
+            {
+                block->cpuHeader.threadId = static_cast<UINT32>(i);
+                packer.Write(std::move(block));
+            }
+        }
+    }
+
+    g_areBlockBatchesEnabled = true;
+
+    ASSERT_EQ(3u, g_blocks.size());
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(sizeof(PEvtBlkHdr) + sizeof(uint64_t), g_blocks[i].size());
+
+        auto decoded = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)g_blocks[i].size(), g_blocks[i].data(), [](uint64_t time) { return time; });
+        ASSERT_TRUE(decoded.Events.empty());
+        ASSERT_EQ(i + 1, reinterpret_cast<PEvtBlkHdr const*>(g_blocks[i].data())->cpuHeader.threadId);
+    }
+
+    g_blocks.clear();
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
+
+TEST(BlockAllocatorTests, LargeBlocks_AreWrittenTogether)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+    g_blocks.clear();
+
+    // Each block is too big to be worth copying, but several of them still
+    // fit in one write.
+    constexpr uint32_t kPayloadSize = 8 * 1024;
+    constexpr uint32_t kBlockSize = sizeof(PEvtBlkHdr) + kPayloadSize;
+    constexpr uint32_t kBlocksPerWrite = WinPixEventRuntime::BlockAllocator::MaxWriteSize / kBlockSize;
+    constexpr uint32_t kBlocks = kBlocksPerWrite + 1;
+
+    {
+        WinPixEventRuntime::BlockAllocator::BlockPacker packer;
+        for (uint32_t i = 1; i <= kBlocks; ++i)
+        {
+            auto block = WinPixEventRuntime::BlockAllocator::Allocate(i);
+            ASSERT_TRUE(block);
+            block->cpuHeader.threadId = i;
+            block->pPIXCurrent = reinterpret_cast<BYTE*>(block.get()) + kBlockSize - sizeof(UINT64);
+
+            // Nothing but end markers, so the decoder has no events to read
+            std::fill(reinterpret_cast<UINT64*>(block.get() + 1), reinterpret_cast<UINT64*>(block->pPIXCurrent) + 1, PIXEventsBlockEndMarker);
+
+            packer.Write(std::move(block));
+        }
+        packer.Flush();
+    }
+
+    ASSERT_EQ(2u, g_blocks.size());
+    ASSERT_EQ(kBlocksPerWrite * kBlockSize, g_blocks[0].size());
+    ASSERT_EQ(kBlockSize, g_blocks[1].size());
+
+    uint32_t threadId = 0;
+    for (auto& write : g_blocks)
+    {
+        auto decoded = PixEventDecoder::DecodeTimingBlocks(true, true, (uint32_t)write.size(), write.data(), [](uint64_t time) { return time; });
+        for (auto const& block : decoded)
+        {
+            ASSERT_EQ(++threadId, block.ThreadId);
+        }
+    }
+    ASSERT_EQ(kBlocks, threadId);
+
+    g_blocks.clear();
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
@@ -0,0 +1,195 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+
+#include "MockD3D12.h" // Include this before pix3.h to trick pix3.h into using the mocked D3D12 definitions
+#include <pix3.h>
+
+#pragma warning(disable:4464)
+#include "../runtime/lib/WinPixEventRuntime.h"
+#include "../runtime/lib/ThreadData.h"
+
+#include <shared/PEvtCompression.h>
+#include <PixEventDecoder.h>
+
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+extern std::optional<WinPixEventRuntime::ThreadData> g_threadData;
+extern std::vector<std::vector<uint8_t>> g_blocks;
+
+class BlockCompressionTests : public ::testing::Test
+{
+public:
+    virtual void SetUp() override
+    {
+        g_blocks.clear();
+        WinPixEventRuntime::Initialize();
+        g_threadData.emplace();
+        WinPixEventRuntime::EnableCapture();
+    }
+
+    virtual void TearDown() override
+    {
+        WinPixEventRuntime::SetBlockCompression(false);
+        g_threadData.reset();
+        WinPixEventRuntime::DisableCapture();
+        WinPixEventRuntime::Shutdown();
+    }
+
+    // Records a typical mix of events, and returns the blocks they end up in.
+    static std::vector<std::vector<uint8_t>> RecordEvents()
+    {
+        g_blocks.clear();
+        for (int i = 0; i < 2000; ++i)
+        {
+            PIXBeginEvent(PIX_COLOR_INDEX(static_cast<uint8_t>(i % 8)), L"Frame %d", i);
+            PIXSetMarker(PIX_COLOR(255, 0, 0), "Draw %d of %d", i % 100, 100);
+            PIXEndEvent();
+        }
+        WinPixEventRuntime::FlushCapture();
+        return std::exchange(g_blocks, {});
+    }
+
+    static std::vector<std::pair<uint32_t, std::wstring>> Decode(std::vector<std::vector<uint8_t>>& buffers)
+    {
+        std::vector<std::pair<uint32_t, std::wstring>> events;
+        for (auto& buffer : buffers)
+        {
+            for (auto const& block : PixEventDecoder::DecodeTimingBlocks(true, true, (uint32_t)buffer.size(), buffer.data(), [](uint64_t time) { return time; }))
+            {
+                for (auto const& event : block.Events)
+                {
+                    events.emplace_back(event.Color, event.Name ? event.Name : L"");
+                }
+            }
+        }
+        return events;
+    }
+};
+
+TEST_F(BlockCompressionTests, CompressedBlocks_DecodeToTheSameEvents)
+{
+    auto blocks = RecordEvents();
+    ASSERT_GT(blocks.size(), 1u);
+
+    auto expected = Decode(blocks);
+    ASSERT_EQ(6000u, expected.size());
+
+    // Send copies of the blocks through the worker's packer with compression on
+    WinPixEventRuntime::SetBlockCompression(true);
+    auto before = WinPixEventRuntime::GetCompressionStatistics();
+    {
+        WinPixEventRuntime::BlockAllocator::BlockPacker packer;
+        for (auto const& recorded : blocks)
+        {
+            auto block = WinPixEventRuntime::BlockAllocator::Allocate(std::nullopt);
+            ASSERT_TRUE(block);
+
+            // Everything after the header, up to and including the end marker
+            const size_t dataSize = recorded.size() - sizeof(PEvtBlkHdr);
+            ASSERT_LE(dataSize, static_cast<size_t>(block->pPIXLimit - block->pPIXCurrent));
+
+            memcpy(block->pPIXCurrent, recorded.data() + sizeof(PEvtBlkHdr), dataSize);
+            block->pPIXCurrent += dataSize - sizeof(uint64_t);
+            block->cpuHeader = reinterpret_cast<PEvtBlkHdr const*>(recorded.data())->cpuHeader;
+
+            packer.Write(std::move(block));
+        }
+    }
+    auto after = WinPixEventRuntime::GetCompressionStatistics();
+
+    ASSERT_EQ(blocks.size(), after.Blocks - before.Blocks);
+    ASSERT_LT(after.CompressedBytes - before.CompressedBytes, after.UncompressedBytes - before.UncompressedBytes);
+
+    size_t writtenBytes = 0;
+    for (auto const& buffer : g_blocks)
+    {
+        writtenBytes += buffer.size();
+        ASSERT_EQ(PIXEVT_CPU_BLOCK_COMPRESSED, reinterpret_cast<PEvtBlkHdr const*>(buffer.data())->BlockType);
+    }
+
+    size_t recordedBytes = 0;
+    for (auto const& buffer : blocks)
+    {
+        recordedBytes += buffer.size();
+    }
+    ASSERT_LT(writtenBytes, recordedBytes);
+
+    ASSERT_EQ(expected, Decode(g_blocks));
+}
+
+TEST_F(BlockCompressionTests, IncompressibleAndTruncatedData_AreRejected)
+{
+    std::vector<BYTE> data(4096);
+    uint32_t seed = 1;
+    for (auto& b : data)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        b = static_cast<BYTE>(seed >> 24);
+    }
+
+    std::vector<BYTE> compressed(data.size());
+    ASSERT_EQ(0u, PEvtCompress(data.data(), data.size(), compressed.data(), compressed.size()));
+
+    std::vector<BYTE> repeated(4096, 7);
+    size_t compressedSize = PEvtCompress(repeated.data(), repeated.size(), compressed.data(), compressed.size());
+    ASSERT_GT(compressedSize, 0u);
+
+    std::vector<BYTE> decompressed(repeated.size());
+    ASSERT_TRUE(PEvtDecompress(compressed.data(), compressedSize, decompressed.data(), decompressed.size()));
+    ASSERT_EQ(repeated, decompressed);
+
+    // Data that doesn't decompress to exactly the expected size is rejected
+    ASSERT_FALSE(PEvtDecompress(compressed.data(), compressedSize - 1, decompressed.data(), decompressed.size()));
+    ASSERT_FALSE(PEvtDecompress(compressed.data(), compressedSize, decompressed.data(), decompressed.size() - 1));
+}
+
+//
+// Prints how well typical event blocks compress and what it costs the worker,
+// to help decide whether to turn compression on. The numbers depend on the
+// machine and on the events, so they aren't checked, and it only runs with
+// --gtest_also_run_disabled_tests.
+//
+TEST_F(BlockCompressionTests, DISABLED_Benchmark_CompressionRatioAndCost)
+{
+    auto blocks = RecordEvents();
+
+    std::vector<BYTE> compressed(WinPixEventRuntime::BlockAllocator::MaxBlockSize);
+    std::vector<BYTE> decompressed(WinPixEventRuntime::BlockAllocator::MaxBlockSize);
+
+    constexpr int kRepeats = 50;
+    size_t uncompressedBytes = 0;
+    size_t compressedBytes = 0;
+    double compressSeconds = 0;
+    double decompressSeconds = 0;
+
+    for (int repeat = 0; repeat < kRepeats; ++repeat)
+    {
+        for (auto const& block : blocks)
+        {
+            auto data = block.data() + sizeof(PEvtBlkHdr);
+            auto dataSize = block.size() - sizeof(PEvtBlkHdr);
+
+            auto start = std::chrono::steady_clock::now();
+            size_t size = PEvtCompress(data, dataSize, compressed.data(), compressed.size());
+            auto middle = std::chrono::steady_clock::now();
+            ASSERT_TRUE(PEvtDecompress(compressed.data(), size, decompressed.data(), dataSize));
+            auto end = std::chrono::steady_clock::now();
+
+            uncompressedBytes += dataSize;
+            compressedBytes += size;
+            compressSeconds += std::chrono::duration<double>(middle - start).count();
+            decompressSeconds += std::chrono::duration<double>(end - middle).count();
+        }
+    }
+
+    const double megabytes = uncompressedBytes / (1024.0 * 1024.0);
+    std::printf("ratio %.2f:1, compress %.0f MB/s (%.1f us per 16kb block), decompress %.0f MB/s\n",
+        static_cast<double>(uncompressedBytes) / compressedBytes,
+        megabytes / compressSeconds,
+        compressSeconds * 1e6 / (uncompressedBytes / (16.0 * 1024.0)),
+        megabytes / decompressSeconds);
+}
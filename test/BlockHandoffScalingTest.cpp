@@ -0,0 +1,109 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+//
+// Handing a full block to the worker (WinPixEventRuntime::TakeBlock) doesn't
+// share a lock with thread registration or enable/disable, or with other
+// handoffs, so threads handing off blocks don't serialize on a single lock.
+// These tests hold one handoff up part way through and check that everything
+// else still gets through.
+//
+
+#include "pch.h"
+
+#pragma warning(disable:4464) // relative include path contains '..'
+#include "../runtime/lib/WinPixEventRuntime.h"
+#include "../runtime/lib/ThreadData.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <thread>
+
+extern std::function<void()> g_onWorkerAdd;
+
+class BlockHandoffScalingTest : public ::testing::Test
+{
+public:
+    virtual void SetUp() override
+    {
+        WinPixEventRuntime::Initialize();
+
+        // Only the first block handed to the worker is held up
+        g_onWorkerAdd = [this]
+        {
+            if (!m_isHeld.exchange(true))
+            {
+                m_entered.set_value();
+                m_released.wait();
+            }
+        };
+
+        m_handoff = std::thread([]
+        {
+            WinPixEventRuntime::TakeBlock(WinPixEventRuntime::BlockAllocator::Allocate(std::nullopt));
+        });
+        m_entered.get_future().wait();
+    }
+
+    virtual void TearDown() override
+    {
+        Release();
+        m_handoff.join();
+        g_onWorkerAdd = nullptr;
+
+        WinPixEventRuntime::Shutdown();
+    }
+
+    // Runs work while the handoff is held up, and returns whether it finished.
+    // Work that waited for the handoff would never finish, so it is given up
+    // on after a while and the handoff is let go rather than hanging the test.
+    template<class Work>
+    bool CompletesDuringHandoff(Work&& work)
+    {
+        auto done = std::async(std::launch::async, std::forward<Work>(work));
+        const bool isReady = done.wait_for(std::chrono::seconds(30)) == std::future_status::ready;
+        Release();
+        return isReady;
+    }
+
+    void Release()
+    {
+        if (!m_isReleased.exchange(true))
+        {
+            m_release.set_value();
+        }
+    }
+
+private:
+    std::atomic<bool> m_isHeld = false;
+    std::promise<void> m_entered;
+    std::promise<void> m_release;
+    std::shared_future<void> m_released = m_release.get_future().share();
+    std::atomic<bool> m_isReleased = false;
+    std::thread m_handoff;
+};
+
+TEST_F(BlockHandoffScalingTest, OtherHandoffs_DontWaitForAHandoff)
+{
+    ASSERT_TRUE(CompletesDuringHandoff([]
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            std::thread([] { WinPixEventRuntime::TakeBlock(WinPixEventRuntime::BlockAllocator::Allocate(std::nullopt)); }).join();
+        }
+    }));
+}
+
+TEST_F(BlockHandoffScalingTest, ControlPlane_DoesntWaitForAHandoff)
+{
+    ASSERT_TRUE(CompletesDuringHandoff([]
+    {
+        WinPixEventRuntime::EnableCapture();
+        WinPixEventRuntime::DisableCapture();
+
+        // Registers and unregisters a thread
+        std::thread([] { WinPixEventRuntime::ThreadData threadData; }).join();
+    }));
+}
@@ -0,0 +1,328 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+
+#include "MockD3D12.h" // Include this before pix3.h to trick pix3.h into using the mocked D3D12 definitions
+#include <pix3.h>
+
+#pragma warning(disable:4464)
+#include "../runtime/lib/FlightRecorder.h"
+#include "../runtime/lib/ThreadedWorker.h"
+#include "../runtime/lib/WinPixEventRuntime.h"
+#include "../runtime/lib/ThreadData.h"
+
+#include <PixEventDecoder.h>
+
+extern std::optional<WinPixEventRuntime::ThreadData> g_threadData;
+extern std::vector<std::vector<uint8_t>> g_blocks;
+
+class FlightRecorderTests : public ::testing::Test
+{
+public:
+    virtual void SetUp() override
+    {
+        g_blocks.clear();
+        WinPixEventRuntime::Initialize();
+        g_threadData.emplace();
+    }
+
+    virtual void TearDown() override
+    {
+        PIXSetFlightRecorderSize(0);
+        g_threadData.reset();
+        WinPixEventRuntime::Shutdown();
+        WinPixEventRuntime::SetEventBlockSize(WinPixEventRuntime::BlockAllocator::DefaultBlockSize);
+    }
+
+    static std::vector<uint32_t> DecodeColors()
+    {
+        std::vector<uint32_t> colors;
+        PixEventDecoder::DecodedInternedStrings internedStrings;
+        for (auto& block : g_blocks)
+        {
+            auto data = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)block.size(), block.data(), [](uint64_t time) { return time; }, &internedStrings);
+            for (auto const& event : data.Events)
+            {
+                colors.push_back(event.Color);
+            }
+        }
+        return colors;
+    }
+};
+
+TEST_F(FlightRecorderTests, Blocks_AreOnlyWrittenWhenTriggered)
+{
+    // Nothing is recorded without a capture or the flight recorder
+    PIXSetMarker(1, L"not recorded");
+    ASSERT_FALSE(WinPixEventRuntime::TriggerFlightRecorder());
+
+    PIXSetFlightRecorderSize(1024 * 1024);
+
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        PIXSetMarker(i, L"a marker that takes up some space");
+    }
+
+    // Flushing hands the thread's block over, but it stays in the recorder
+    WinPixEventRuntime::FlushCapture();
+    ASSERT_TRUE(g_blocks.empty());
+
+    PIXSetMarker(1000, L"last marker");
+    ASSERT_TRUE(WinPixEventRuntime::TriggerFlightRecorder());
+
+    auto colors = DecodeColors();
+    ASSERT_EQ(1001u, colors.size());
+    for (uint32_t i = 0; i < colors.size(); ++i)
+    {
+        ASSERT_EQ(i, colors[i]);
+    }
+
+    // Triggering again only writes what has been recorded since
+    g_blocks.clear();
+    PIXSetMarker(1001, L"after trigger");
+    ASSERT_TRUE(WinPixEventRuntime::TriggerFlightRecorder());
+
+    colors = DecodeColors();
+    ASSERT_EQ(1u, colors.size());
+    ASSERT_EQ(1001u, colors[0]);
+}
+
+TEST_F(FlightRecorderTests, OldestBlocks_AreDropped)
+{
+    constexpr size_t kRecorderSize = 64 * 1024;
+
+    PIXSetEventBlockSize(4096);
+    PIXSetFlightRecorderSize(kRecorderSize);
+
+    PIXSetMarker(PIX_COLOR_INDEX(1), PIX_INTERN("flight recorder marker"));
+
+    constexpr uint32_t kMarkers = 20000;
+    for (uint32_t i = 0; i < kMarkers; ++i)
+    {
+        PIXSetMarker(i, L"a marker that takes up some space");
+    }
+
+    ASSERT_TRUE(WinPixEventRuntime::TriggerFlightRecorder());
+
+    // The string table comes first, since the block it was in has long gone
+    ASSERT_GT(g_blocks.size(), 1u);
+    auto table = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)g_blocks[0].size(), g_blocks[0].data(), [](uint64_t time) { return time; });
+    ASSERT_TRUE(table.Events.empty());
+
+    // Then the most recent blocks, up to the recorder's size (plus the block
+    // that was flushed by the trigger)
+    size_t recordedBytes = 0;
+    for (size_t i = 1; i < g_blocks.size(); ++i)
+    {
+        recordedBytes += g_blocks[i].size();
+    }
+    ASSERT_LE(recordedBytes, kRecorderSize + 4096);
+
+    auto colors = DecodeColors();
+    ASSERT_FALSE(colors.empty());
+    ASSERT_LT(colors.size(), kMarkers);
+    ASSERT_EQ(kMarkers - 1, colors.back());
+    for (size_t i = 1; i < colors.size(); ++i)
+    {
+        ASSERT_EQ(colors[i - 1] + 1, colors[i]);
+    }
+}
+
+TEST_F(FlightRecorderTests, TurningOff_StopsRecording)
+{
+    PIXSetFlightRecorderSize(1024 * 1024);
+    PIXSetMarker(1, L"recorded");
+
+    PIXSetFlightRecorderSize(0);
+    ASSERT_FALSE(WinPixEventRuntime::TriggerFlightRecorder());
+
+    PIXSetMarker(2, L"not recorded");
+    ASSERT_EQ(nullptr, PIXGetThreadInfo()->biasedLimit);
+    ASSERT_TRUE(g_blocks.empty());
+
+    // A capture started while the recorder is on carries on when it is turned off
+    PIXSetFlightRecorderSize(1024 * 1024);
+    WinPixEventRuntime::EnableCapture();
+    PIXSetFlightRecorderSize(0);
+
+    PIXSetMarker(3, L"captured");
+    WinPixEventRuntime::FlushCapture();
+    WinPixEventRuntime::DisableCapture();
+
+    auto colors = DecodeColors();
+    ASSERT_EQ(1u, colors.size());
+    ASSERT_EQ(3u, colors[0]);
+}
+
+TEST_F(FlightRecorderTests, RunningCapture_GetsEventsWhileRecording)
+{
+    WinPixEventRuntime::EnableCapture();
+    PIXSetFlightRecorderSize(1024 * 1024);
+
+    PIXSetMarker(1, L"captured and recorded");
+    WinPixEventRuntime::FlushCapture();
+
+    auto colors = DecodeColors();
+    ASSERT_EQ(1u, colors.size());
+    ASSERT_EQ(1u, colors[0]);
+
+    // The recorder kept its own copy
+    g_blocks.clear();
+    ASSERT_TRUE(WinPixEventRuntime::TriggerFlightRecorder());
+
+    colors = DecodeColors();
+    ASSERT_EQ(1u, colors.size());
+    ASSERT_EQ(1u, colors[0]);
+
+    WinPixEventRuntime::DisableCapture();
+}
+
+//
+// The same, through the ThreadedWorker that the runtime uses, rather than the
+// test worker.
+//
+class FlightRecorderWorkerTests : public ::testing::Test
+{
+public:
+    virtual void SetUp() override
+    {
+        g_blocks.clear();
+        WinPixEventRuntime::BlockAllocator::Initialize();
+        m_worker.Start();
+    }
+
+    virtual void TearDown() override
+    {
+        m_worker.Stop();
+        g_blocks.clear();
+        WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+        WinPixEventRuntime::BlockAllocator::Shutdown();
+    }
+
+    void Add(uint32_t threadId)
+    {
+        auto block = WinPixEventRuntime::BlockAllocator::Allocate(std::nullopt);
+        ASSERT_TRUE(block);
+        block->cpuHeader.threadId = threadId;
+        m_worker.Add(std::move(block));
+    }
+
+    void Trigger(uint32_t headerThreadId)
+    {
+        std::vector<WinPixEventRuntime::BlockAllocator::Block> headerBlocks;
+        headerBlocks.push_back(WinPixEventRuntime::BlockAllocator::Allocate(std::nullopt));
+        headerBlocks.back()->cpuHeader.threadId = headerThreadId;
+        m_worker.TriggerFlightRecorder(std::move(headerBlocks));
+    }
+
+    // Waits for the worker to write out what it's been given, and returns the
+    // thread ids of the blocks written so far, in order.
+    std::vector<uint32_t> WrittenThreadIds()
+    {
+        m_worker.WaitForFence(m_worker.AddFence());
+
+        std::vector<uint32_t> threadIds;
+        for (auto& buffer : g_blocks)
+        {
+            for (auto const& block : PixEventDecoder::DecodeTimingBlocks(true, true, (uint32_t)buffer.size(), buffer.data(), [](uint64_t time) { return time; }))
+            {
+                threadIds.push_back(block.ThreadId);
+            }
+        }
+        return threadIds;
+    }
+
+    WinPixEventRuntime::ThreadedWorker m_worker;
+};
+
+TEST_F(FlightRecorderWorkerTests, RecordedBlocks_AreOnlyWrittenWhenTriggered)
+{
+    m_worker.SetFlightRecorderSize(1024 * 1024);
+
+    for (uint32_t i = 1; i <= 3; ++i)
+    {
+        Add(i);
+    }
+    ASSERT_TRUE(WrittenThreadIds().empty());
+
+    Trigger(100);
+    ASSERT_EQ((std::vector<uint32_t>{ 100, 1, 2, 3 }), WrittenThreadIds());
+}
+
+TEST_F(FlightRecorderWorkerTests, LiveCapture_GetsBlocksWhileRecording)
+{
+    m_worker.SetFlightRecorderSize(1024 * 1024);
+    m_worker.SetLiveCapture(true);
+
+    for (uint32_t i = 1; i <= 3; ++i)
+    {
+        Add(i);
+    }
+    ASSERT_EQ((std::vector<uint32_t>{ 1, 2, 3 }), WrittenThreadIds());
+
+    // And they're written again when the recorder is triggered
+    Trigger(100);
+    ASSERT_EQ((std::vector<uint32_t>{ 1, 2, 3, 100, 1, 2, 3 }), WrittenThreadIds());
+}
+
+TEST_F(FlightRecorderWorkerTests, Size_CountsTheUsedPartOfEachBlock)
+{
+    // Room for three blocks with nothing in them, though each is much bigger
+    constexpr size_t kEmptyBlockSize = sizeof(PEvtBlkHdr) + sizeof(uint64_t);
+    m_worker.SetFlightRecorderSize(3 * kEmptyBlockSize);
+
+    for (uint32_t i = 1; i <= 5; ++i)
+    {
+        Add(i);
+    }
+
+    Trigger(100);
+    ASSERT_EQ((std::vector<uint32_t>{ 100, 3, 4, 5 }), WrittenThreadIds());
+
+    PEvtStatsBlk statistics = {};
+    m_worker.GetStatistics(statistics);
+    ASSERT_EQ(2u, statistics.DroppedBlocks);
+}
+
+TEST(FlightRecorderClassTests, Size_LimitsTheBlocksKept)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+
+    // Blocks are counted by how much of them has been used, which for these
+    // is just the end marker
+    constexpr size_t kEmptyBlockSize = sizeof(PEvtBlkHdr) + sizeof(uint64_t);
+
+    {
+        WinPixEventRuntime::FlightRecorder recorder;
+        ASSERT_FALSE(recorder.IsEnabled());
+
+        recorder.SetSize(2 * kEmptyBlockSize);
+        ASSERT_TRUE(recorder.IsEnabled());
+
+        for (uint64_t i = 1; i <= 5; ++i)
+        {
+            recorder.Add(WinPixEventRuntime::BlockAllocator::Allocate(i));
+        }
+
+        ASSERT_EQ(2u, recorder.GetBlockCount());
+        ASSERT_EQ(3u, recorder.GetDroppedBlockCount());
+
+        auto blocks = recorder.TakeBlocks();
+        ASSERT_EQ(2u, blocks.size());
+        ASSERT_EQ(4u, blocks[0]->cpuHeader.beginTimestamp);
+        ASSERT_EQ(5u, blocks[1]->cpuHeader.beginTimestamp);
+        ASSERT_EQ(0u, recorder.GetBlockCount());
+
+        // A block bigger than the recorder is still kept
+        recorder.SetSize(1);
+        recorder.Add(WinPixEventRuntime::BlockAllocator::Allocate(6ull));
+        ASSERT_EQ(1u, recorder.GetBlockCount());
+
+        recorder.SetSize(0);
+        ASSERT_EQ(0u, recorder.GetBlockCount());
+    }
+
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
@@ -0,0 +1,134 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+
+#include "MockD3D12.h" // Include this before pix3.h to trick pix3.h into using the mocked D3D12 definitions
+#include <pix3.h>
+
+#pragma warning(disable:4464)
+#include "../runtime/lib/LatencyHistogram.h"
+#include "../runtime/lib/WinPixEventRuntime.h"
+#include "../runtime/lib/ThreadData.h"
+
+#include <thread>
+#include <vector>
+
+extern std::optional<WinPixEventRuntime::ThreadData> g_threadData;
+extern std::vector<std::vector<uint8_t>> g_blocks;
+
+using WinPixEventRuntime::LatencyHistogram;
+
+TEST(LatencyHistogramTests, Durations_GoInPowerOfTwoBuckets)
+{
+    ASSERT_EQ(0u, LatencyHistogram::GetBucket(0));
+    ASSERT_EQ(0u, LatencyHistogram::GetBucket(1));
+    ASSERT_EQ(1u, LatencyHistogram::GetBucket(2));
+    ASSERT_EQ(1u, LatencyHistogram::GetBucket(3));
+    ASSERT_EQ(2u, LatencyHistogram::GetBucket(4));
+    ASSERT_EQ(10u, LatencyHistogram::GetBucket(1024));
+    ASSERT_EQ(10u, LatencyHistogram::GetBucket(2047));
+    ASSERT_EQ(63u, LatencyHistogram::GetBucket(~0ull));
+}
+
+TEST(LatencyHistogramTests, Percentiles_AreBucketUpperBounds)
+{
+    LatencyHistogram histogram;
+
+    // 989 fast calls, 10 slower ones and one very slow one
+    for (int i = 0; i < 989; ++i)
+    {
+        histogram.Record(100);
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        histogram.Record(1000);
+    }
+    histogram.Record(100000);
+
+    auto summary = histogram.GetSummary();
+    ASSERT_EQ(1000u, summary.Count);
+    ASSERT_EQ(989u, summary.Buckets[6]);
+    ASSERT_EQ(10u, summary.Buckets[9]);
+    ASSERT_EQ(1u, summary.Buckets[16]);
+
+    ASSERT_EQ(127u, summary.P50);
+    ASSERT_EQ(1023u, summary.P99);
+    ASSERT_EQ(1023u, summary.P999);
+    ASSERT_EQ(100000u, summary.Max);
+
+    histogram.Reset();
+    summary = histogram.GetSummary();
+    ASSERT_EQ(0u, summary.Count);
+    ASSERT_EQ(0u, summary.P50);
+    ASSERT_EQ(0u, summary.Max);
+}
+
+TEST(LatencyHistogramTests, Threads_AreAddedUp)
+{
+    LatencyHistogram histogram;
+
+    // Enough threads that some of them record into different shards
+    std::vector<std::thread> threads;
+    for (uint64_t i = 1; i <= 16; ++i)
+    {
+        threads.emplace_back([&histogram, i]
+        {
+            for (int j = 0; j < 100; ++j)
+            {
+                histogram.Record(i * 1000);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    auto summary = histogram.GetSummary();
+    ASSERT_EQ(1600u, summary.Count);
+    ASSERT_EQ(16000u, summary.Max);
+}
+
+#if PIX_ENABLE_LATENCY_HISTOGRAMS
+
+//
+// Records enough events to fill several blocks and checks that the
+// replacements were timed.
+//
+TEST(LatencyHistogramTests, ReplaceBlock_IsTimed)
+{
+    g_blocks.clear();
+    WinPixEventRuntime::Initialize();
+    g_threadData.emplace();
+    WinPixEventRuntime::EnableCapture();
+
+    PIXRuntimeLatency before;
+    ASSERT_TRUE(PIXGetRuntimeLatency(PIX_RUNTIME_LATENCY_REPLACE_BLOCK, &before));
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        PIXSetMarker(PIX_COLOR_INDEX(1), L"marker %d", i);
+    }
+
+    PIXRuntimeLatency after;
+    ASSERT_TRUE(PIXGetRuntimeLatency(PIX_RUNTIME_LATENCY_REPLACE_BLOCK, &after));
+    ASSERT_LT(before.Count, after.Count);
+    ASSERT_LE(after.P50, after.P99);
+    ASSERT_LE(after.P99, after.P999);
+    ASSERT_LE(after.P999, after.Max);
+
+    PIXRuntimeLatency handoff;
+    ASSERT_TRUE(PIXGetRuntimeLatency(PIX_RUNTIME_LATENCY_HANDOFF, &handoff));
+    ASSERT_LT(0u, handoff.Count);
+
+    PIXRuntimeLatency unknown;
+    ASSERT_FALSE(PIXGetRuntimeLatency(PIX_RUNTIME_LATENCY_WRITE + 1, &unknown));
+
+    g_threadData.reset();
+    WinPixEventRuntime::DisableCapture();
+    WinPixEventRuntime::Shutdown();
+}
+
+#endif // PIX_ENABLE_LATENCY_HISTOGRAMS
@@ -0,0 +1,232 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+
+#include "MockD3D12.h" // Include this before pix3.h to trick pix3.h into using the mocked D3D12 definitions
+#include <pix3.h>
+
+#pragma warning(disable:4464) // relative include path contains '..'
+#include "../runtime/lib/MappedFileSink.h"
+#include "../runtime/lib/ThreadData.h"
+
+#include <PixEventDecoder.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+extern std::optional<WinPixEventRuntime::ThreadData> g_threadData;
+extern std::vector<std::vector<uint8_t>> g_blocks;
+
+class MappedFileSinkTests : public ::testing::Test
+{
+public:
+    std::wstring m_fileName;
+
+    virtual void SetUp() override
+    {
+        wchar_t directory[MAX_PATH] = {};
+        wchar_t fileName[MAX_PATH] = {};
+        ASSERT_NE(0u, GetTempPathW(MAX_PATH, directory));
+        ASSERT_NE(0u, GetTempFileNameW(directory, L"pix", 0, fileName));
+        m_fileName = fileName;
+    }
+
+    virtual void TearDown() override
+    {
+        DeleteFileW(m_fileName.c_str());
+    }
+
+    std::vector<uint8_t> ReadFile() const
+    {
+        std::ifstream file(m_fileName, std::ios::binary);
+        return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    }
+
+    static std::vector<uint8_t> MakeWrite(uint8_t value, size_t size)
+    {
+        return std::vector<uint8_t>(size, value);
+    }
+};
+
+TEST_F(MappedFileSinkTests, CommittedWrites_AreReadBackInOrder)
+{
+    constexpr uint32_t kSlots = 4;
+    auto sink = WinPixEventRuntime::MappedFileSink::Create(m_fileName.c_str(), 64 * 1024 + WinPixEventRuntime::MappedFileSink::StringTableSize + kSlots * WinPixEventRuntime::MappedFileSink::SlotSize);
+    ASSERT_TRUE(sink);
+    ASSERT_GE(sink->GetSlotCount(), kSlots);
+
+    const uint32_t slotCount = sink->GetSlotCount();
+
+    // Go round the ring more than once, so the oldest writes are overwritten
+    const uint32_t writeCount = slotCount + 3;
+    for (uint32_t i = 0; i < writeCount; ++i)
+    {
+        auto data = MakeWrite(static_cast<uint8_t>(i), 100 + i);
+        ASSERT_TRUE(sink->Write(static_cast<uint32_t>(data.size()), data.data()));
+    }
+
+    // Too big for a slot
+    std::vector<uint8_t> tooBig(WinPixEventRuntime::MappedFileSink::SlotSize);
+    ASSERT_FALSE(sink->Write(static_cast<uint32_t>(tooBig.size()), tooBig.data()));
+
+    // What has been written can be read while the sink is still open, as it
+    // would be after a crash
+    auto file = ReadFile();
+    auto writes = PixEventDecoder::ReadCaptureFile(file.size(), file.data());
+
+    ASSERT_EQ(slotCount, writes.size());
+    for (uint32_t i = 0; i < slotCount; ++i)
+    {
+        const uint32_t expected = writeCount - slotCount + i;
+        ASSERT_EQ(MakeWrite(static_cast<uint8_t>(expected), 100 + expected), writes[i]);
+    }
+
+    sink.reset();
+
+    auto closedFile = ReadFile();
+    ASSERT_EQ(slotCount, PixEventDecoder::ReadCaptureFile(closedFile.size(), closedFile.data()).size());
+}
+
+TEST_F(MappedFileSinkTests, UncommittedWrites_AreSkipped)
+{
+    auto sink = WinPixEventRuntime::MappedFileSink::Create(m_fileName.c_str(), 1024 * 1024);
+    ASSERT_TRUE(sink);
+
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+        auto data = MakeWrite(i, 64);
+        ASSERT_TRUE(sink->Write(static_cast<uint32_t>(data.size()), data.data()));
+    }
+    sink.reset();
+
+    // Clear the second slot's commit sequence number, as if the process had
+    // died while writing to it
+    auto file = ReadFile();
+    auto commitSequences = reinterpret_cast<uint64_t*>(file.data() + sizeof(PEvtFileHdr));
+    ASSERT_EQ(2u, commitSequences[1]);
+    commitSequences[1] = 0;
+
+    auto writes = PixEventDecoder::ReadCaptureFile(file.size(), file.data());
+    ASSERT_EQ(2u, writes.size());
+    ASSERT_EQ(MakeWrite(0, 64), writes[0]);
+    ASSERT_EQ(MakeWrite(2, 64), writes[1]);
+
+    // Anything that isn't a capture file has nothing in it
+    reinterpret_cast<PEvtFileHdr*>(file.data())->Magic = 0;
+    ASSERT_TRUE(PixEventDecoder::ReadCaptureFile(file.size(), file.data()).empty());
+    ASSERT_TRUE(PixEventDecoder::ReadCaptureFile(file.size() / 2, file.data()).empty());
+}
+
+TEST_F(MappedFileSinkTests, Blocks_CanBeDecoded)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+
+    auto sink = WinPixEventRuntime::MappedFileSink::Create(m_fileName.c_str(), 1024 * 1024);
+    ASSERT_TRUE(sink);
+
+    {
+        auto block = WinPixEventRuntime::BlockAllocator::Allocate(1ull);
+        ASSERT_TRUE(block);
+        block->cpuHeader.threadId = 1234;
+        block->BlockSize = WinPixEventRuntime::BlockAllocator::GetUsedSize(block.get());
+        ASSERT_TRUE(sink->Write(block->BlockSize, block.get()));
+    }
+
+    auto file = ReadFile();
+    auto writes = PixEventDecoder::ReadCaptureFile(file.size(), file.data());
+    ASSERT_EQ(1u, writes.size());
+
+    auto blocks = PixEventDecoder::DecodeTimingBlocks(true, true, (uint32_t)writes[0].size(), writes[0].data(), [](uint64_t time) { return time; });
+    ASSERT_EQ(1u, blocks.size());
+    ASSERT_EQ(1234u, blocks[0].ThreadId);
+
+    sink.reset();
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
+
+TEST_F(MappedFileSinkTests, StringTable_IsReadBeforeTheRing)
+{
+    auto sink = WinPixEventRuntime::MappedFileSink::Create(m_fileName.c_str(), 1024 * 1024);
+    ASSERT_TRUE(sink);
+
+    const uint32_t slotCount = sink->GetSlotCount();
+    for (uint32_t i = 0; i < slotCount + 1; ++i)
+    {
+        auto data = MakeWrite(1, 64);
+        ASSERT_TRUE(sink->Write(static_cast<uint32_t>(data.size()), data.data()));
+    }
+
+    auto strings = MakeWrite(2, 32);
+    ASSERT_TRUE(sink->WriteStringTable(static_cast<uint32_t>(strings.size()), strings.data()));
+    ASSERT_TRUE(sink->WriteStringTable(static_cast<uint32_t>(strings.size()), strings.data()));
+
+    std::vector<uint8_t> tooBig(WinPixEventRuntime::MappedFileSink::StringTableSize);
+    ASSERT_FALSE(sink->WriteStringTable(static_cast<uint32_t>(tooBig.size()), tooBig.data()));
+
+    auto file = ReadFile();
+    auto writes = PixEventDecoder::ReadCaptureFile(file.size(), file.data());
+    ASSERT_EQ(slotCount + 1, writes.size());
+    ASSERT_EQ(MakeWrite(2, 64), writes[0]);
+    ASSERT_EQ(MakeWrite(1, 64), writes[1]);
+}
+
+TEST_F(MappedFileSinkTests, CaptureFile_KeepsInternedStringsAfterTheRingGoesRound)
+{
+    WinPixEventRuntime::Initialize();
+    g_threadData.emplace();
+    g_blocks.clear();
+
+    ASSERT_EQ(S_OK, PIXSetCaptureFile(m_fileName.c_str(), 1024 * 1024));
+
+    PIXSetMarker(1, PIX_INTERN(L"interned for the capture file"));
+    WinPixEventRuntime::FlushCapture();
+
+    // The events are sent through ETW as well as written to the file
+    ASSERT_FALSE(g_blocks.empty());
+
+    // Each flush is a write of its own, so this goes round the ring a few
+    // times and overwrites the write that had the interned string in it
+    for (int i = 0; i < 64; ++i)
+    {
+        PIXSetMarker(2, L"not interned");
+        WinPixEventRuntime::FlushCapture();
+    }
+
+    PIXSetMarker(3, PIX_INTERN(L"interned for the capture file"));
+    WinPixEventRuntime::FlushCapture();
+
+    auto file = ReadFile();
+    auto writes = PixEventDecoder::ReadCaptureFile(file.size(), file.data());
+
+    PixEventDecoder::DecodedInternedStrings internedStrings;
+    std::vector<std::pair<uint32_t, std::wstring>> markers;
+    for (auto& write : writes)
+    {
+        for (auto const& block : PixEventDecoder::DecodeTimingBlocks(true, true, (uint32_t)write.size(), write.data(), [](uint64_t time) { return time; }, &internedStrings))
+        {
+            for (auto const& event : block.Events)
+            {
+                markers.emplace_back(event.Color, event.Name ? event.Name : L"");
+            }
+        }
+    }
+
+    ASSERT_FALSE(markers.empty());
+    ASSERT_NE(1u, markers.front().first);
+    ASSERT_EQ(3u, markers.back().first);
+    ASSERT_EQ(L"interned for the capture file", markers.back().second);
+
+    ASSERT_EQ(S_OK, PIXSetCaptureFile(nullptr, 0));
+    g_threadData.reset();
+    WinPixEventRuntime::Shutdown();
+    g_blocks.clear();
+}
+
+TEST_F(MappedFileSinkTests, FilesTooSmallForTheRing_AreRejected)
+{
+    ASSERT_FALSE(WinPixEventRuntime::MappedFileSink::Create(m_fileName.c_str(), WinPixEventRuntime::MappedFileSink::SlotSize));
+    ASSERT_EQ(static_cast<DWORD>(ERROR_INVALID_PARAMETER), GetLastError());
+}
@@ -12,6 +12,7 @@
 
 extern std::optional<WinPixEventRuntime::ThreadData> g_threadData;
 extern std::vector<std::vector<uint8_t>> g_blocks;
+extern std::vector<std::vector<uint8_t>> g_statisticsBlocks;
 
 #include <PixEventDecoder.h>
 
@@ -32,6 +33,7 @@ public:
         g_threadData.reset();
         WinPixEventRuntime::DisableCapture();
         WinPixEventRuntime::Shutdown();
+        WinPixEventRuntime::SetEventBlockSize(WinPixEventRuntime::BlockAllocator::DefaultBlockSize);
     }
 };
 
@@ -557,6 +559,143 @@ TEST_F(PixEventTests, MismatchedFormatStrings)
     f.Validate();
 }
 
+namespace
+{
+    enum UnscopedEnum { UnscopedEnumValue = -7 };
+    enum class UnsignedScopedEnum : UINT16 { Value = 0xFFFE };
+    enum class SignedScopedEnum : INT8 { Value = -3 };
+}
+
+// Every scalar type is widened so that it decodes with its usual format specifier
+TEST_F(PixEventTests, ScalarArguments)
+{
+    Fixture f;
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"bool %d %d", true, false);
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"bool 1 0");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"char %d %c", static_cast<char>(-5), 'x');
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"char -5 x");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"int8 %d %u", static_cast<INT8>(-5), static_cast<UINT8>(250));
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"int8 -5 250");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"int16 %d %u", static_cast<INT16>(-300), static_cast<UINT16>(65000));
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"int16 -300 65000");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"int32 %d %u", -70000, 4000000000u);
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"int32 -70000 4000000000");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"long %ld %lu", -5l, 5ul);
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"long -5 5");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"int64 %lld %llu", -1ll, 0xFFFFFFFFFFFFFFFFull);
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"int64 -1 18446744073709551615");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"size %zu %td", static_cast<size_t>(7), static_cast<ptrdiff_t>(-9));
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"size 7 -9");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"floating %f %f", 1.5f, -2.25);
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"floating 1.500000 -2.250000");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"enum %d %u %d", UnscopedEnumValue, UnsignedScopedEnum::Value, SignedScopedEnum::Value);
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"enum -7 65534 -3");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"pointer %p", reinterpret_cast<void*>(0x1234));
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"pointer 0000000000001234");
+
+    f.Validate();
+}
+
+TEST_F(PixEventTests, SizedStringArguments)
+{
+    Fixture f;
+
+    // Only the first 5 characters are part of the view, so there is no terminator to find
+    std::string_view view = std::string_view("hello world").substr(0, 5);
+    PIXSetMarker(PIX_COLOR_DEFAULT, "view: %s!", view);
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"view: hello!");
+
+    PIXSetMarker(PIX_COLOR_DEFAULT, "string: %s %s", std::string("12345678"), std::string());
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"string: 12345678 ");
+
+    std::wstring wide = L"wide string";
+    PIXSetMarker(PIX_COLOR_DEFAULT, L"%s / %s", std::wstring_view(wide).substr(5), wide);
+    f.Expect(PixEventType::Marker, PIX_COLOR_DEFAULT, L"string / wide string");
+
+    f.Validate();
+}
+
+TEST_F(PixEventTests, EncodedLiterals)
+{
+    Fixture f;
+
+    PIXBeginEvent(PIX_COLOR(1, 2, 3), PIX_LITERAL("literal begin"));
+    f.Expect(PixEventType::Begin, PIX_COLOR(1, 2, 3), L"literal begin");
+
+    PIXSetMarker(PIX_COLOR_INDEX(5), PIX_LITERAL(L"literal marker"));
+    f.Expect(PixEventType::Marker, PIX_COLOR_INDEX(5), L"literal marker");
+
+    PIXSetMarker(PIX_COLOR_INDEX(6), PIX_LITERAL(""));
+    f.Expect(PixEventType::Marker, PIX_COLOR_INDEX(6), L"");
+
+    PIXEndEvent();
+    f.Expect(PixEventType::End, PIX_COLOR_DEFAULT, L"");
+
+    f.Validate();
+}
+
+// 2100 characters, so the event size would wrap around if it were narrowed before being
+// checked against the fast copy space
+#define LONG_LITERAL_100 "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789abcdefghijklmnopqrstuvwxyzAB"
+#define LONG_LITERAL \
+    LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 \
+    LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 \
+    LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100 LONG_LITERAL_100
+
+TEST_F(PixEventTests, EncodedLiterals_LongerThanTheFastCopySpace)
+{
+    static_assert(sizeof(LONG_LITERAL) / sizeof(UINT64) > PIXEventsSafeFastCopySpaceQwords);
+
+    // Long literals are written the same way as the plain string
+    PIXBeginEvent(PIX_COLOR(1, 2, 3), PIX_LITERAL(LONG_LITERAL));
+    PIXBeginEvent(PIX_COLOR(1, 2, 3), LONG_LITERAL);
+    PIXBeginEvent(PIX_COLOR_INDEX(4), PIX_LITERAL(L"" LONG_LITERAL));
+    PIXBeginEvent(PIX_COLOR_INDEX(4), L"" LONG_LITERAL);
+    PIXSetMarker(PIX_COLOR(5, 6, 7), PIX_LITERAL(LONG_LITERAL));
+    PIXSetMarker(PIX_COLOR(5, 6, 7), LONG_LITERAL);
+    PIXSetMarker(PIX_COLOR_INDEX(8), PIX_LITERAL(L"" LONG_LITERAL));
+    PIXSetMarker(PIX_COLOR_INDEX(8), L"" LONG_LITERAL);
+
+    // Nothing was written past the long events
+    PIXSetMarker(PIX_COLOR_INDEX(9), PIX_LITERAL("after"));
+
+    WinPixEventRuntime::FlushCapture();
+
+    ASSERT_EQ(1u, g_blocks.size());
+    auto data = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)g_blocks[0].size(), g_blocks[0].data(), [](uint64_t time) { return time; });
+
+    ASSERT_EQ(9u, data.Events.size());
+    for (auto i = 0u; i < 8; i += 2)
+    {
+        auto const& literal = data.Events[i];
+        auto const& string = data.Events[i + 1];
+
+        ASSERT_EQ((int)string.Type, (int)literal.Type);
+        ASSERT_EQ(string.Color, literal.Color);
+        ASSERT_NE(nullptr, literal.Name);
+        ASSERT_STREQ(string.Name, literal.Name);
+        ASSERT_EQ(0, wcsncmp(L"" LONG_LITERAL, literal.Name, wcslen(literal.Name)));
+    }
+
+    ASSERT_EQ((int)PixEventType::Marker, (int)data.Events[8].Type);
+    ASSERT_EQ(PIX_COLOR_INDEX(9), data.Events[8].Color);
+    ASSERT_STREQ(L"after", data.Events[8].Name);
+}
+
+#undef LONG_LITERAL
+#undef LONG_LITERAL_100
+
 // Check that if we pass a new op (which might be a future event etc) into the decoder then
 // the decoder will gracefully handle this.
 TEST_F(PixEventTests, InvalidOp_DecodeFailsGracefully)
@@ -578,3 +717,384 @@ TEST_F(PixEventTests, InvalidOp_DecodeFailsGracefully)
 
     EXPECT_FALSE(nameAndColor.has_value());
 }
+
+// Interned strings are only recorded once per capture, each event then just
+// carries the string's shortcut.
+TEST_F(PixEventTests, InternedStrings)
+{
+    PIXBeginEvent(PIX_COLOR(1, 2, 3), PIX_INTERN("interned begin"));
+    PIXSetMarker(PIX_COLOR_INDEX(4), PIX_INTERN(L"interned marker %s %d"), PIX_INTERN("world"), 42);
+    PIXEndEvent();
+
+    WinPixEventRuntime::FlushCapture();
+
+    // One block for the string table, one for the thread's events
+    ASSERT_EQ(2u, g_blocks.size());
+
+    struct Event
+    {
+        PixEventType Type;
+        uint32_t Color;
+        std::wstring Name;
+    };
+
+    // The blocks are decoded with the same table, in the order they were written
+    PixEventDecoder::DecodedInternedStrings internedStrings;
+    std::vector<Event> events;
+    for (auto& block : g_blocks)
+    {
+        auto data = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)block.size(), block.data(), [](uint64_t time) { return time; }, &internedStrings);
+        for (auto const& event : data.Events)
+        {
+            events.push_back({ event.Type, event.Color, event.Name ? event.Name : L"" });
+        }
+    }
+
+    ASSERT_EQ(3u, events.size());
+    ASSERT_EQ((int)PixEventType::Begin, (int)events[0].Type);
+    ASSERT_EQ(PIX_COLOR(1, 2, 3), events[0].Color);
+    ASSERT_EQ(L"interned begin", events[0].Name);
+    ASSERT_EQ((int)PixEventType::Marker, (int)events[1].Type);
+    ASSERT_EQ(4u, events[1].Color);
+    ASSERT_EQ(L"interned marker world 42", events[1].Name);
+    ASSERT_EQ((int)PixEventType::End, (int)events[2].Type);
+
+    // The begin event is the event info, the color and the shortcut
+    auto const* firstEvent = reinterpret_cast<UINT64 const*>(g_blocks[1].data() + sizeof(PEvtBlkHdr));
+    ASSERT_EQ(3u, (*firstEvent & PIXEventsSizeReadMask) >> PIXEventsSizeBitShift);
+
+    // A table that hasn't seen this capture's strings can't resolve them
+    PixEventDecoder::DecodedInternedStrings otherInternedStrings;
+    auto unresolved = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)g_blocks[1].size(), g_blocks[1].data(), [](uint64_t time) { return time; }, &otherInternedStrings);
+    ASSERT_EQ(3u, unresolved.Events.size());
+    ASSERT_EQ(L"<unknown interned string>", std::wstring(unresolved.Events[0].Name));
+
+    // A new capture gets its own copy of the string table
+    WinPixEventRuntime::DisableCapture();
+    g_blocks.clear();
+    WinPixEventRuntime::EnableCapture();
+
+    ASSERT_EQ(1u, g_blocks.size());
+}
+
+TEST_F(PixEventTests, ReplacedBlocks_StartWhenThePreviousBlockEnds)
+{
+    g_blocks.clear();
+
+    // Enough markers to fill several blocks, so that standby blocks get used
+    for (int i = 0; i < 4000; ++i)
+    {
+        PIXSetMarker(1, L"a marker that takes up some space %d", i);
+    }
+    WinPixEventRuntime::FlushCapture();
+
+    ASSERT_GT(g_blocks.size(), 3u);
+
+    for (size_t i = 1; i < g_blocks.size(); ++i)
+    {
+        auto const* previous = reinterpret_cast<PEvtBlkHdr const*>(g_blocks[i - 1].data());
+        auto const* block = reinterpret_cast<PEvtBlkHdr const*>(g_blocks[i].data());
+
+        ASSERT_LE(block->cpuHeader.beginTimestamp, block->cpuHeader.endTimestamp);
+        ASSERT_GE(block->cpuHeader.beginTimestamp, previous->cpuHeader.endTimestamp);
+    }
+}
+
+TEST_F(PixEventTests, EventBlockSize_IsConfigurable)
+{
+    g_blocks.clear();
+
+    PIXSetEventBlockSize(4096);
+    for (int i = 0; i < 1000; ++i)
+    {
+        PIXSetMarker(1, L"a marker that takes up some space %d", i);
+    }
+    WinPixEventRuntime::FlushCapture();
+
+    ASSERT_GT(g_blocks.size(), 1u);
+    for (auto const& block : g_blocks)
+    {
+        ASSERT_LE(block.size(), 4096u);
+    }
+
+    // Only the last block was flushed before it was full
+    for (size_t i = 0; i + 1 < g_blocks.size(); ++i)
+    {
+        ASSERT_GT(g_blocks[i].size(), 4096u - PIXEventsSizeMax * sizeof(UINT64));
+    }
+
+    // Sizes are clamped to what fits in an ETW event
+    PIXSetEventBlockSize(1024 * 1024);
+    for (int i = 0; i < 1000; ++i)
+    {
+        PIXSetMarker(1, L"a marker that takes up some space %d", i);
+    }
+
+    uint32_t blockSize = 0;
+    for (auto const& statistics : WinPixEventRuntime::GetThreadBlockStatistics())
+    {
+        if (statistics.ThreadId == GetCurrentThreadId())
+            blockSize = statistics.BlockSize;
+    }
+    ASSERT_EQ(WinPixEventRuntime::BlockAllocator::MaxBlockSize, blockSize);
+}
+
+TEST_F(PixEventTests, FlushedBlocks_OnlyWriteTheUsedPart)
+{
+    g_blocks.clear();
+
+    PIXSetMarker(1, L"marker");
+    WinPixEventRuntime::FlushCapture();
+
+    ASSERT_EQ(1u, g_blocks.size());
+    ASSERT_LT(g_blocks[0].size(), 256u);
+
+    auto const* header = reinterpret_cast<PEvtBlkHdr const*>(g_blocks[0].data());
+    ASSERT_EQ(g_blocks[0].size(), header->BlockSize);
+
+    auto data = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)g_blocks[0].size(), g_blocks[0].data(), [](uint64_t time) { return time; });
+    ASSERT_EQ(1u, data.Events.size());
+    ASSERT_EQ(std::wstring(L"marker"), data.Events[0].Name);
+}
+
+TEST_F(PixEventTests, AdaptiveEventBlockSize_FollowsReplacementRate)
+{
+    auto getStatistics = []
+    {
+        for (auto const& statistics : WinPixEventRuntime::GetThreadBlockStatistics())
+        {
+            if (statistics.ThreadId == GetCurrentThreadId())
+                return statistics;
+        }
+        return WinPixEventRuntime::ThreadBlockStatistics{};
+    };
+
+    PIXSetEventBlockSize(PIX_EVENT_BLOCK_SIZE_ADAPTIVE);
+
+    // The blocks are replaced at made up times, rather than by writing events
+    // and waiting, so that the rate doesn't depend on the machine
+    LARGE_INTEGER frequency = {};
+    QueryPerformanceFrequency(&frequency);
+
+    PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+    uint64_t time = PIXGetTimestampCounter();
+
+    // A thread that fills blocks quickly ends up with the largest blocks
+    for (int i = 0; i < 8; ++i)
+    {
+        time += frequency.QuadPart / 10000;
+        WinPixEventRuntime::ThreadData::ReplaceBlock(threadInfo, time);
+    }
+
+    auto busy = getStatistics();
+    ASSERT_EQ(WinPixEventRuntime::BlockAllocator::MaxBlockSize, busy.BlockSize);
+    ASSERT_EQ(8u, busy.Replacements);
+
+    // Taking a long time to fill the next block shrinks it again
+    time += frequency.QuadPart;
+    WinPixEventRuntime::ThreadData::ReplaceBlock(threadInfo, time);
+
+    ASSERT_EQ(WinPixEventRuntime::BlockAllocator::MaxBlockSize / 2, getStatistics().BlockSize);
+
+    // And a rate in between leaves it alone
+    time += frequency.QuadPart / 100;
+    WinPixEventRuntime::ThreadData::ReplaceBlock(threadInfo, time);
+
+    ASSERT_EQ(WinPixEventRuntime::BlockAllocator::MaxBlockSize / 2, getStatistics().BlockSize);
+}
+
+TEST_F(PixEventTests, HarvestedEvents_AreNotWrittenAgain)
+{
+    auto decodeColors = [](std::vector<uint8_t> const& buffer)
+    {
+        std::vector<uint64_t> colors;
+        auto data = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)buffer.size(), buffer.data(), [](uint64_t time) { return time; });
+        for (auto const& event : data.Events)
+        {
+            colors.push_back(event.Color);
+        }
+        return colors;
+    };
+
+    g_blocks.clear();
+
+    PIXSetMarker(PIX_COLOR_INDEX(1), L"harvested");
+    PIXSetMarker(PIX_COLOR_INDEX(2), L"harvested");
+
+    auto harvested = g_threadData->Harvest();
+    ASSERT_TRUE(harvested);
+    ASSERT_EQ(GetCurrentThreadId(), harvested->cpuHeader.threadId);
+
+    // Nothing has been written since
+    ASSERT_FALSE(g_threadData->Harvest());
+
+    // The thread carries on with the same block
+    PIXSetMarker(PIX_COLOR_INDEX(3), L"not harvested");
+
+    WinPixEventRuntime::BlockAllocator::WriteBlock(std::move(harvested));
+    ASSERT_EQ(1u, g_blocks.size());
+    ASSERT_EQ((std::vector<uint64_t>{ PIX_COLOR_INDEX(1), PIX_COLOR_INDEX(2) }), decodeColors(g_blocks[0]));
+
+    // Letting go of the block only writes out what wasn't harvested
+    g_threadData.reset();
+    ASSERT_EQ(2u, g_blocks.size());
+    ASSERT_EQ((std::vector<uint64_t>{ PIX_COLOR_INDEX(3) }), decodeColors(g_blocks[1]));
+}
+
+TEST_F(PixEventTests, MaxEventLatency_HarvestsStaleBlocks)
+{
+    g_blocks.clear();
+
+    // The test worker leaves harvesting to us, and we say what time it is.
+    // Events are stale once they're older than half of the latency.
+    PIXSetMaxEventLatency(20);
+
+    LARGE_INTEGER frequency = {};
+    QueryPerformanceFrequency(&frequency);
+    const uint64_t staleTicks = static_cast<uint64_t>(frequency.QuadPart) * 20 / 2000;
+
+    PIXSetMarker(PIX_COLOR_INDEX(1), L"first");
+    PIXSetMarker(PIX_COLOR_INDEX(2), L"second");
+
+    WinPixEventRuntime::HarvestStaleBlocksAt(PIXGetTimestampCounter() + staleTicks + 1);
+    ASSERT_EQ(1u, g_blocks.size());
+
+    // Not stale yet
+    const uint64_t beforeThird = PIXGetTimestampCounter();
+    PIXSetMarker(PIX_COLOR_INDEX(3), L"third");
+    WinPixEventRuntime::HarvestStaleBlocksAt(beforeThird + staleTicks);
+    ASSERT_EQ(1u, g_blocks.size());
+
+    WinPixEventRuntime::HarvestStaleBlocksAt(PIXGetTimestampCounter() + staleTicks + 1);
+    ASSERT_EQ(2u, g_blocks.size());
+
+    std::vector<DecodedPixEventBlock> decoded;
+    for (auto& buffer : g_blocks)
+    {
+        decoded.push_back(PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)buffer.size(), buffer.data(), [](uint64_t time) { return time; }));
+    }
+
+    ASSERT_EQ(2u, decoded[0].Events.size());
+    ASSERT_EQ(1u, decoded[1].Events.size());
+    ASSERT_EQ(PIX_COLOR_INDEX(3), decoded[1].Events[0].Color);
+
+    // Each chunk's timestamps bracket its events, and the second one starts
+    // where the first one's events finished
+    for (size_t i = 0; i < g_blocks.size(); ++i)
+    {
+        auto const* header = reinterpret_cast<PEvtBlkHdr const*>(g_blocks[i].data());
+        for (auto const& event : decoded[i].Events)
+        {
+            ASSERT_LE(header->cpuHeader.beginTimestamp, static_cast<uint64_t>(event.Timestamp));
+            ASSERT_GE(header->cpuHeader.endTimestamp, static_cast<uint64_t>(event.Timestamp));
+        }
+    }
+
+    auto const* second = reinterpret_cast<PEvtBlkHdr const*>(g_blocks[1].data());
+    ASSERT_EQ(static_cast<uint64_t>(decoded[0].Events[1].Timestamp), second->cpuHeader.beginTimestamp);
+
+    PIXSetMaxEventLatency(0);
+}
+
+TEST_F(PixEventTests, RuntimeStatistics_CountWrittenEvents)
+{
+    PIXRuntimeStatistics before;
+    PIXGetRuntimeStatistics(&before);
+
+    g_blocks.clear();
+    PIXSetMarker(PIX_COLOR_INDEX(1), L"first");
+    PIXSetMarker(PIX_COLOR_INDEX(2), L"second");
+    WinPixEventRuntime::FlushCapture();
+    ASSERT_EQ(1u, g_blocks.size());
+
+    PIXRuntimeStatistics after;
+    PIXGetRuntimeStatistics(&after);
+
+    ASSERT_LE(1u, after.Threads);
+    ASSERT_EQ(before.Events + 2, after.Events);
+    ASSERT_EQ(before.BlocksWritten + 1, after.BlocksWritten);
+    ASSERT_EQ(before.BytesWritten + g_blocks[0].size(), after.BytesWritten);
+    ASSERT_EQ(before.AllocationFailures, after.AllocationFailures);
+
+    // The same numbers are recorded in the stream, in a block that holds no
+    // events and is written apart from the timing blocks
+    g_statisticsBlocks.clear();
+    WinPixEventRuntime::WriteStatistics();
+    ASSERT_EQ(1u, g_blocks.size());
+    ASSERT_EQ(1u, g_statisticsBlocks.size());
+
+    auto& buffer = g_statisticsBlocks[0];
+    ASSERT_TRUE(PixEventDecoder::DecodeTimingBlocks(true, true, (uint32_t)buffer.size(), buffer.data(), [](uint64_t time) { return time; }).empty());
+
+    auto statistics = PixEventDecoder::DecodeRuntimeStatistics((uint32_t)buffer.size(), buffer.data(), [](uint64_t time) { return time; });
+    ASSERT_EQ(1u, statistics.size());
+    ASSERT_EQ(GetCurrentProcessId(), statistics[0].ProcessId);
+    ASSERT_EQ(after.Events, statistics[0].Events);
+    ASSERT_EQ(after.BlocksWritten, statistics[0].BlocksWritten);
+    ASSERT_EQ(after.BytesWritten, statistics[0].BytesWritten);
+}
+
+TEST_F(PixEventTests, NewThreads_AdoptBlocksFromExitedThreads)
+{
+    auto getStatistics = []
+    {
+        for (auto const& statistics : WinPixEventRuntime::GetThreadBlockStatistics())
+        {
+            if (statistics.ThreadId == GetCurrentThreadId())
+                return statistics;
+        }
+        return WinPixEventRuntime::ThreadBlockStatistics{};
+    };
+
+    PIXSetEventBlockSize(PIX_EVENT_BLOCK_SIZE_ADAPTIVE);
+
+    // Blocks replaced quickly, at made up times so that it doesn't depend on
+    // the machine, grow to the largest size
+    LARGE_INTEGER frequency = {};
+    QueryPerformanceFrequency(&frequency);
+
+    PIXEventsThreadInfo* threadInfo = PIXGetThreadInfo();
+    uint64_t time = PIXGetTimestampCounter();
+    for (int i = 0; i < 8; ++i)
+    {
+        time += frequency.QuadPart / 10000;
+        WinPixEventRuntime::ThreadData::ReplaceBlock(threadInfo, time);
+    }
+    ASSERT_EQ(WinPixEventRuntime::BlockAllocator::MaxBlockSize, getStatistics().BlockSize);
+
+    // The next thread starts with the block this one had ready, rather than
+    // growing its blocks from the smallest size again
+    g_threadData.reset();
+    g_threadData.emplace();
+
+    PIXSetMarker(1, L"first marker");
+    auto statistics = getStatistics();
+    ASSERT_EQ(1u, statistics.Replacements);
+    ASSERT_EQ(WinPixEventRuntime::BlockAllocator::MaxBlockSize, statistics.BlockSize);
+}
+
+TEST_F(PixEventTests, Threads_CanExitInAnyOrder)
+{
+    const size_t threads = WinPixEventRuntime::GetThreadBlockStatistics().size();
+
+    std::optional<WinPixEventRuntime::ThreadData> others[4];
+    for (auto& other : others)
+    {
+        other.emplace();
+    }
+    ASSERT_EQ(threads + 4, WinPixEventRuntime::GetThreadBlockStatistics().size());
+
+    others[1].reset();
+    others[0].reset();
+    ASSERT_EQ(threads + 2, WinPixEventRuntime::GetThreadBlockStatistics().size());
+
+    // This thread is still registered, and still writes events
+    g_blocks.clear();
+    PIXSetMarker(PIX_COLOR_INDEX(1), L"marker");
+    WinPixEventRuntime::FlushCapture();
+    ASSERT_EQ(1u, g_blocks.size());
+
+    others[3].reset();
+    others[2].reset();
+    ASSERT_EQ(threads, WinPixEventRuntime::GetThreadBlockStatistics().size());
+}
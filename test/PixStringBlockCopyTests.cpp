@@ -14,12 +14,12 @@ namespace
 
     struct GuardedBuffer
     {
-        GuardedBuffer()
+        GuardedBuffer(size_t numPages = 1)
         {
-            // Create a 4KB buffer that is known to be inaccessible both before and after it
-            basePtr = VirtualAlloc(NULL, 3 * kPageSize, MEM_RESERVE, PAGE_READWRITE);
+            // Create a buffer of numPages * 4KB that is known to be inaccessible both before and after it
+            basePtr = VirtualAlloc(NULL, (numPages + 2) * kPageSize, MEM_RESERVE, PAGE_READWRITE);
             dataPtr = (PVOID)((SIZE_T)basePtr + kPageSize);
-            VirtualAlloc(dataPtr, kPageSize, MEM_COMMIT, PAGE_READWRITE);
+            VirtualAlloc(dataPtr, numPages * kPageSize, MEM_COMMIT, PAGE_READWRITE);
         }
 
         ~GuardedBuffer()
@@ -267,3 +267,129 @@ TEST(PixStringBlockCopyTests, WcharBlockCopySafeChars)
         }
     }
 }
+
+TEST(PixStringBlockCopyTests, AnsiBlockCopyAcrossPageBoundary)
+{
+    //
+    // This test validates strings that start near the end of one page and
+    // continue into the next one.  The block copy must not issue a 16 byte
+    // read that straddles the two pages, so it falls back to copying a
+    // character at a time until it is clear of the page boundary.  Both
+    // pages are committed here so the string contents can be validated.
+    //
+
+    GuardedBuffer buffer(2);
+    char* testBuffer = (char*)buffer.GetDataPtr();
+    char* pageBoundary = testBuffer + kPageSize;
+
+    std::string testString;
+    for (int i = 0; i < 100; ++i)
+        testString.push_back('a' + (i % 26));
+
+    for (int offsetFromBoundary = 1; offsetFromBoundary < 4 * kMaxAlignmentOffset; ++offsetFromBoundary)
+    {
+        char scenario[100];
+        sprintf(scenario, "offsetFromBoundary: %d", offsetFromBoundary);
+        SCOPED_TRACE(scenario);
+
+        memset(testBuffer, 0xdc, 2 * kPageSize);
+
+        char* strPos = pageBoundary - offsetFromBoundary;
+        memcpy(strPos, testString.c_str(), testString.size() + 1);
+
+        UINT64 destination[32];
+        UINT64* dest = destination;
+        PIXCopyStringArgument(dest, destination + ARRAYSIZE(destination) - PIXEventsReservedTailSpaceQwords, strPos);
+
+        ASSERT_EQ(memcmp(destination, testString.c_str(), testString.size() + 1), 0);
+        ASSERT_EQ((size_t)(dest - destination), (testString.size() + sizeof(UINT64)) / sizeof(UINT64));
+    }
+}
+
+TEST(PixStringBlockCopyTests, WcharBlockCopyAcrossPageBoundary)
+{
+    //
+    // Same as AnsiBlockCopyAcrossPageBoundary, but for wide strings.  This
+    // includes strings that aren't 2-byte aligned.
+    //
+
+    GuardedBuffer buffer(2);
+    uint8_t* testBuffer = (uint8_t*)buffer.GetDataPtr();
+    uint8_t* pageBoundary = testBuffer + kPageSize;
+
+    // Use a leading character with a zero low byte so that a misaligned read would be noticed
+    wchar_t testStringW[101];
+    for (int i = 0; i < 100; ++i)
+        testStringW[i] = L'a' + (i % 26);
+    testStringW[0] = 0x0100;
+    testStringW[100] = L'\0';
+
+    const size_t testStringBytes = sizeof(testStringW);
+
+    for (int offsetFromBoundary = 1; offsetFromBoundary < 4 * kMaxAlignmentOffset; ++offsetFromBoundary)
+    {
+        char scenario[100];
+        sprintf(scenario, "offsetFromBoundary: %d", offsetFromBoundary);
+        SCOPED_TRACE(scenario);
+
+        memset(testBuffer, 0xdc, 2 * kPageSize);
+
+        uint8_t* strPos = pageBoundary - offsetFromBoundary;
+        memcpy(strPos, testStringW, testStringBytes);
+
+        UINT64 destination[64];
+        UINT64* dest = destination;
+        PIXCopyStringArgument(dest, destination + ARRAYSIZE(destination) - PIXEventsReservedTailSpaceQwords, (wchar_t*)strPos);
+
+        ASSERT_EQ(memcmp(destination, testStringW, testStringBytes), 0);
+        ASSERT_EQ((size_t)(dest - destination), (testStringBytes + sizeof(UINT64) - 1) / sizeof(UINT64));
+    }
+}
+
+TEST(PixStringBlockCopyTests, UnalignedEventArgumentHasStringInfo)
+{
+    //
+    // Unaligned strings used to always take the slow path.  They now take the
+    // block copy path, which must still emit the same string info qword ahead
+    // of the characters so that the decoder can read them back.
+    //
+
+    GuardedBuffer buffer;
+    char* testBuffer = (char*)buffer.GetDataPtr();
+
+    const char testString[] = "unaligned marker name";
+    const wchar_t testStringW[] = L"unaligned marker name";
+
+    for (int alignment = 0; alignment < kMaxAlignmentOffset; alignment++)
+    {
+        char scenario[100];
+        sprintf(scenario, "Alignment: 0x%02x", alignment);
+        SCOPED_TRACE(scenario);
+
+        char* strPos = testBuffer + kPageSize - sizeof(testStringW) - alignment;
+
+        UINT64 destination[16];
+        UINT64 const* limit = destination + ARRAYSIZE(destination) - PIXEventsReservedTailSpaceQwords;
+
+        memcpy(strPos, testString, sizeof(testString));
+        UINT64* dest = destination;
+        PIXCopyEventArgument(dest, limit, (PCSTR)strPos);
+
+        UINT64 expectedStringInfo;
+        UINT64* expectedDest = &expectedStringInfo;
+        PIXEncodeStringInfo(expectedDest, TRUE);
+        ASSERT_EQ(destination[0], expectedStringInfo);
+        ASSERT_EQ(memcmp(destination + 1, testString, sizeof(testString)), 0);
+        ASSERT_EQ((size_t)(dest - destination), 1 + (sizeof(testString) + sizeof(UINT64) - 1) / sizeof(UINT64));
+
+        memcpy(strPos, testStringW, sizeof(testStringW));
+        dest = destination;
+        PIXCopyEventArgument(dest, limit, (PCWSTR)strPos);
+
+        expectedDest = &expectedStringInfo;
+        PIXEncodeStringInfo(expectedDest, FALSE);
+        ASSERT_EQ(destination[0], expectedStringInfo);
+        ASSERT_EQ(memcmp(destination + 1, testStringW, sizeof(testStringW)), 0);
+        ASSERT_EQ((size_t)(dest - destination), 1 + (sizeof(testStringW) + sizeof(UINT64) - 1) / sizeof(UINT64));
+    }
+}
@@ -0,0 +1,140 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+//
+// Tests for the thread info cache used by the pix3.h entry points (see
+// PIXGetCachedThreadInfo in PIXEventsCommon.h), and a microbenchmark comparing
+// it against calling PIXGetThreadInfo for every event.
+//
+
+#include "pch.h"
+
+#include "MockD3D12.h" // Include this before pix3.h to trick pix3.h into using the mocked D3D12 definitions
+#include <pix3.h>
+
+#pragma warning(disable:4464)
+#include "../runtime/lib/WinPixEventRuntime.h"
+#include "../runtime/lib/ThreadData.h"
+
+#include <PixEventDecoder.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+extern std::optional<WinPixEventRuntime::ThreadData> g_threadData;
+extern std::vector<std::vector<uint8_t>> g_blocks;
+
+#if PIX_ENABLE_THREAD_INFO_CACHE
+
+class ThreadInfoCacheTests : public ::testing::Test
+{
+public:
+    virtual void SetUp() override
+    {
+        g_blocks.clear();
+        WinPixEventRuntime::Initialize();
+        g_threadData.emplace();
+        WinPixEventRuntime::EnableCapture();
+    }
+
+    virtual void TearDown() override
+    {
+        g_threadData.reset();
+        WinPixEventRuntime::DisableCapture();
+        WinPixEventRuntime::Shutdown();
+    }
+};
+
+TEST_F(ThreadInfoCacheTests, CachedThreadInfo_IsTheThreadInfo)
+{
+    ASSERT_EQ(PIXGetThreadInfo(), PIXGetCachedThreadInfo());
+    ASSERT_EQ(PIXGetThreadInfo(), PIXGetCachedThreadInfo());
+
+    // Exiting doesn't invalidate other threads' caches, but this thread no
+    // longer uses its cached pointer and its events are dropped
+    g_threadData.reset();
+    ASSERT_EQ(&PIXEventsThreadInfoCache::exitedThreadInfo, PIXGetCachedThreadInfo());
+    ASSERT_EQ(nullptr, PIXGetCachedThreadInfo()->biasedLimit);
+    PIXSetMarker(1, L"after exit");
+
+    // A new ThreadData for this thread must not be hidden by the cache
+    g_threadData.emplace();
+    WinPixEventRuntime::EnableCapture();
+
+    ASSERT_EQ(&*g_threadData, WinPixEventRuntime::ThreadData::GetFromThreadInfo(PIXGetCachedThreadInfo()));
+}
+
+TEST_F(ThreadInfoCacheTests, EnableAndDisable_AreSeenByCachedThreadInfo)
+{
+    PIXSetMarker(1, L"enabled");
+
+    WinPixEventRuntime::DisableCapture();
+    g_blocks.clear();
+
+    // Written while disabled, so these must be dropped
+    PIXSetMarker(2, L"disabled");
+    PIXSetMarker(3, L"disabled");
+    ASSERT_EQ(nullptr, PIXGetCachedThreadInfo()->biasedLimit);
+
+    WinPixEventRuntime::EnableCapture();
+    PIXSetMarker(4, L"enabled again");
+    WinPixEventRuntime::FlushCapture();
+
+    // After a flush only the events since are written
+    PIXSetMarker(5, L"after flush");
+    WinPixEventRuntime::FlushCapture();
+
+    std::vector<uint64_t> colors;
+    for (auto& block : g_blocks)
+    {
+        auto data = PixEventDecoder::DecodeTimingBlock(true, true, (uint32_t)block.size(), block.data(), [](uint64_t time) { return time; });
+        for (auto const& event : data.Events)
+        {
+            colors.push_back(event.Color);
+        }
+    }
+
+    ASSERT_EQ(2u, colors.size());
+    ASSERT_EQ(PIX_COLOR_INDEX(4), colors[0]);
+    ASSERT_EQ(PIX_COLOR_INDEX(5), colors[1]);
+}
+
+//
+// Compares looking up the thread info with a call per event, as pix3.h used to,
+// against the cached lookup. In the tests PIXGetThreadInfo lives in the same
+// module, so it is called through a function pointer to stand in for the call
+// through the import table that applications make. The numbers are printed
+// rather than checked, since they depend on the machine, so it only runs with
+// --gtest_also_run_disabled_tests.
+//
+TEST_F(ThreadInfoCacheTests, DISABLED_Benchmark_CachedThreadInfo)
+{
+    constexpr int kIterations = 10000000;
+
+    PIXEventsThreadInfo* (WINAPI * volatile getThreadInfo)() noexcept = PIXGetThreadInfo;
+
+    auto measure = [](auto&& lookup)
+    {
+        PIXEventsThreadInfo* threadInfo = nullptr;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; ++i)
+        {
+            threadInfo = lookup();
+            // Keep the lookups from being merged
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::make_pair(threadInfo, std::chrono::duration<double, std::nano>(end - start).count() / kIterations);
+    };
+
+    auto uncached = measure([&] { return getThreadInfo(); });
+    auto cached = measure([] { return PIXGetCachedThreadInfo(); });
+
+    ASSERT_EQ(uncached.first, cached.first);
+
+    std::printf("PIXGetThreadInfo:       %.2f ns/event\n", uncached.second);
+    std::printf("PIXGetCachedThreadInfo: %.2f ns/event\n", cached.second);
+}
+
+#endif // PIX_ENABLE_THREAD_INFO_CACHE
@@ -24,9 +24,13 @@
 #include "../runtime/lib/ThreadedWorker.h"
 #include "../runtime/lib/BlockAllocator.h"
 
+#include <PixEventDecoder.h>
+
 #include <thread>
 #include <atomic>
 
+extern std::vector<std::vector<uint8_t>> g_blocks;
+
 //
 // Stress test: hammer Start() and Add() from two threads simultaneously.
 //
@@ -118,3 +122,131 @@ TEST(ThreadedWorkerRaceTest, ConcurrentStopStartAndAdd_DoesNotCrash)
 
     WinPixEventRuntime::BlockAllocator::Shutdown();
 }
+
+
+//
+// Many threads hand blocks to the worker at the same time, while another
+// thread keeps stopping and starting it. Every block must be written exactly
+// once.
+//
+TEST(ThreadedWorkerRaceTest, ManyProducers_AllBlocksWritten)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+    g_blocks.clear();
+
+    constexpr int kProducers = 8;
+    constexpr int kBlocksPerProducer = 512;
+    constexpr int kRestarts = 100;
+
+    WinPixEventRuntime::ThreadedWorker worker;
+    worker.Start();
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        producers.emplace_back([&] {
+            for (int i = 0; i < kBlocksPerProducer; ++i)
+            {
+                worker.Add(WinPixEventRuntime::BlockAllocator::Allocate(std::nullopt));
+            }
+            WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+        });
+    }
+
+    std::thread controlThread([&] {
+        for (int i = 0; i < kRestarts; ++i)
+        {
+            worker.Stop();
+            worker.Start();
+        }
+    });
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    controlThread.join();
+
+    worker.Stop();
+
+    // The blocks are empty, so the worker packs several of them into each write
+    size_t blocksWritten = 0;
+    for (auto& buffer : g_blocks)
+    {
+        blocksWritten += PixEventDecoder::DecodeTimingBlocks(true, true, (uint32_t)buffer.size(), buffer.data(), [](uint64_t time) { return time; }).size();
+    }
+    ASSERT_EQ(static_cast<size_t>(kProducers * kBlocksPerProducer), blocksWritten);
+
+    g_blocks.clear();
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
+
+//
+// A fence completes once the blocks added before it have been written, without
+// the worker having to be stopped. There are enough blocks for the worker to
+// fall behind and get help writing them, and each producer's blocks still come
+// out in the order they were added.
+//
+TEST(ThreadedWorkerRaceTest, Fence_WaitsForAddedBlocks)
+{
+    WinPixEventRuntime::BlockAllocator::Initialize();
+    g_blocks.clear();
+
+    constexpr int kProducers = 8;
+    constexpr int kBlocksPerProducer = 1024;
+
+    WinPixEventRuntime::ThreadedWorker worker;
+    worker.Start();
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        producers.emplace_back([&worker, p] {
+            for (int i = 0; i < kBlocksPerProducer; ++i)
+            {
+                auto block = WinPixEventRuntime::BlockAllocator::Allocate(static_cast<uint64_t>(i));
+                block->cpuHeader.threadId = static_cast<uint32_t>(p * 4);
+                worker.Add(std::move(block));
+            }
+            WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+        });
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    worker.WaitForFence(worker.AddFence());
+
+    // The blocks were given a thread id made from their producer's index, like
+    // a real one, and their position as the time
+    std::vector<uint64_t> nextTime(kProducers, 0);
+    size_t blocksWritten = 0;
+    for (auto& buffer : g_blocks)
+    {
+        size_t offset = 0;
+        while (offset + sizeof(PEvtBlkHdr) <= buffer.size())
+        {
+            auto block = reinterpret_cast<PEvtBlkHdr const*>(buffer.data() + offset);
+            ASSERT_GE(block->BlockSize, sizeof(PEvtBlkHdr));
+            const uint32_t producer = block->cpuHeader.threadId / 4;
+            ASSERT_LT(producer, static_cast<uint32_t>(kProducers));
+            ASSERT_EQ(nextTime[producer]++, block->cpuHeader.beginTimestamp);
+
+            offset += block->BlockSize;
+            ++blocksWritten;
+        }
+    }
+    ASSERT_EQ(static_cast<size_t>(kProducers * kBlocksPerProducer), blocksWritten);
+
+    // A fence with nothing added since the last one completes too
+    worker.WaitForFence(worker.AddFence());
+
+    worker.Stop();
+
+    g_blocks.clear();
+    WinPixEventRuntime::BlockAllocator::ReleaseThreadCache();
+    WinPixEventRuntime::BlockAllocator::Shutdown();
+}
@@ -15,8 +15,12 @@
 //
 
 #pragma warning(disable:4464)
+#include "../runtime/lib/FlightRecorder.h"
 #include "../runtime/lib/Worker.h"
 
+#include <functional>
+#include <mutex>
+
 /*static*/ std::optional<WinPixEventRuntime::ThreadData> g_threadData; // Global so that it can be used in other files
 
 PIXEventsThreadInfo* WINAPI PIXGetThreadInfo() noexcept
@@ -26,6 +30,13 @@ PIXEventsThreadInfo* WINAPI PIXGetThreadInfo() noexcept
 
 /*static*/ std::vector<std::vector<uint8_t>> g_blocks; // Global so that it can be used in other files
 
+// The threaded worker can have thread pool threads writing at the same time
+static std::mutex g_blocksMutex;
+
+// Called by the test worker for every block it's given. Global so that tests
+// can hold a handoff up part way through.
+/*static*/ std::function<void()> g_onWorkerAdd;
+
 class TestWorker final : public WinPixEventRuntime::Worker
 {
 public:
@@ -41,9 +52,81 @@ public:
 
     virtual void Add(WinPixEventRuntime::BlockAllocator::Block block) override
     {
-        WinPixEventRuntime::WriteBlock(static_cast<uint32_t>(block->pPIXLimit - (BYTE*)block.get()), block.get());
+        if (g_onWorkerAdd)
+        {
+            g_onWorkerAdd();
+        }
+
+        if (m_flightRecorder.IsEnabled())
+        {
+            if (m_isLiveCapture)
+            {
+                WinPixEventRuntime::BlockAllocator::WriteBlock(block.get());
+            }
+            m_flightRecorder.Add(std::move(block));
+        }
+        else
+        {
+            WinPixEventRuntime::BlockAllocator::WriteBlock(std::move(block));
+        }
+    }
+
+    virtual uint64_t AddFence() override
+    {
+        // Blocks are written as soon as they're added
+        return 0;
+    }
+
+    virtual void WaitForFence(uint64_t) override
+    {
+    }
+
+    virtual void SetHarvestInterval(uint32_t) override
+    {
+        // Tests harvest by calling HarvestStaleBlocks themselves
     }
 
+    virtual void SetStatisticsInterval(uint32_t) override
+    {
+        // Tests call WriteStatistics themselves
+    }
+
+    virtual void GetStatistics(PEvtStatsBlk& statistics) override
+    {
+        // Nothing is ever queued
+        statistics.DroppedBlocks = m_flightRecorder.GetDroppedBlockCount();
+    }
+
+    virtual void SetNumaNode(uint32_t) override
+    {
+        // There's no worker thread to move
+    }
+
+    virtual void SetFlightRecorderSize(size_t maxBytes) override
+    {
+        m_flightRecorder.SetSize(maxBytes);
+    }
+
+    virtual void SetLiveCapture(bool isLive) override
+    {
+        m_isLiveCapture = isLive;
+    }
+
+    virtual void TriggerFlightRecorder(std::vector<WinPixEventRuntime::BlockAllocator::Block> headerBlocks) override
+    {
+        for (auto& block : headerBlocks)
+        {
+            WinPixEventRuntime::BlockAllocator::WriteBlock(std::move(block));
+        }
+
+        for (auto& block : m_flightRecorder.TakeBlocks())
+        {
+            WinPixEventRuntime::BlockAllocator::WriteBlock(std::move(block));
+        }
+    }
+
+    WinPixEventRuntime::FlightRecorder m_flightRecorder;
+    bool m_isLiveCapture = false;
 };
 
 std::unique_ptr<WinPixEventRuntime::Worker> WinPixEventRuntime::CreateWorker() noexcept
@@ -53,7 +136,45 @@ std::unique_ptr<WinPixEventRuntime::Worker> WinPixEventRuntime::CreateWorker() n
 
 void WinPixEventRuntime::WriteBlock(uint32_t numBytes, void* block) noexcept
 {
+    // Like the runtime, the capture file gets the block too
+    WinPixEventRuntime::WriteBlockToCaptureFile(numBytes, block);
+
     auto bytes = static_cast<uint8_t*>(block);
 
+    std::lock_guard<std::mutex> lock(g_blocksMutex);
     g_blocks.push_back({ bytes, bytes + numBytes });
 }
+
+/*static*/ std::vector<std::vector<uint8_t>> g_statisticsBlocks; // Global so that it can be used in other files
+
+void WinPixEventRuntime::WriteStatisticsBlock(uint32_t numBytes, void* block) noexcept
+{
+    WinPixEventRuntime::WriteBlockToCaptureFile(numBytes, block);
+
+    auto bytes = static_cast<uint8_t*>(block);
+
+    std::lock_guard<std::mutex> lock(g_blocksMutex);
+    g_statisticsBlocks.push_back({ bytes, bytes + numBytes });
+}
+
+/*static*/ bool g_areBlockBatchesEnabled = true; // Global so that it can be used in other files
+
+bool WinPixEventRuntime::AreBlockBatchesEnabled() noexcept
+{
+    return g_areBlockBatchesEnabled;
+}
+
+void WinPixEventRuntime::WriteBlocks(uint32_t count, BlockSpan const* spans) noexcept
+{
+    WinPixEventRuntime::WriteBlocksToCaptureFile(count, spans);
+
+    std::vector<uint8_t> write;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto bytes = static_cast<uint8_t*>(spans[i].Data);
+        write.insert(write.end(), bytes, bytes + spans[i].NumBytes);
+    }
+
+    std::lock_guard<std::mutex> lock(g_blocksMutex);
+    g_blocks.push_back(std::move(write));
+}